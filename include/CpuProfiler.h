@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Zones are compiled in unless the build turns SKIP_PROFILING off (cmake -DSKIP_PROFILING=OFF)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SKIP_PROFILER_RDTSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace Skip {
+
+    // Scoped CPU zones for the frame loop, command buffer recording and asset loading, exported as a
+    // Chrome trace (chrome://tracing, ui.perfetto.dev):
+    //     CpuProfiler::setEnabled(true);
+    //     { SKIP_PROFILE_ZONE("stageFrame"); ... }
+    //     CpuProfiler::writeChromeTrace("trace.json");
+    // Every thread writes its zones into its own ring buffer, no locks or atomics shared with other
+    // threads on the way. The rings keep the last EVENTS_PER_THREAD zones of each thread, so a long
+    // session can keep capturing and still write out the frames around a hitch. Zone names must be
+    // string literals, only the pointer is stored
+    class CpuProfiler {
+
+    public:
+        static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+        struct Event {
+            const char* name;
+            uint64_t start; // ticks, see now()
+            uint64_t end;
+        };
+
+        // zones are only recorded while enabled, a disabled zone costs one relaxed load
+        static void setEnabled(bool enabled);
+        static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+        // name of the calling thread in the trace
+        static void setThreadName(const std::string& name);
+
+        // rdtsc where available, steady_clock ticks otherwise. Ticks are converted to microseconds
+        // against steady_clock when the trace is written, which assumes an invariant TSC
+        static uint64_t now() {
+#ifdef SKIP_PROFILER_RDTSC
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        static void record(const char* name, uint64_t start, uint64_t end);
+
+        // Writes every thread's events. Threads must not be inside a zone while it runs (call it
+        // between frames or at exit), a ring that wraps during the export gives torn events.
+        // False if the file could not be written
+        static bool writeChromeTrace(const std::string& path);
+
+    private:
+        static std::atomic<bool> _enabled;
+    };
+
+    class ProfileZone {
+
+    public:
+        explicit ProfileZone(const char* name)
+            : _name(CpuProfiler::isEnabled() ? name : nullptr), _start(_name != nullptr ? CpuProfiler::now() : 0) {}
+        ~ProfileZone() {
+            if (_name != nullptr) {
+                CpuProfiler::record(_name, _start, CpuProfiler::now());
+            }
+        }
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+
+    private:
+        const char* _name;
+        uint64_t _start;
+    };
+
+}
+
+#ifdef SKIP_PROFILING
+#define SKIP_PROFILE_CONCAT_INNER(a, b) a##b
+#define SKIP_PROFILE_CONCAT(a, b) SKIP_PROFILE_CONCAT_INNER(a, b)
+#define SKIP_PROFILE_ZONE(name) Skip::ProfileZone SKIP_PROFILE_CONCAT(_profileZone, __LINE__)(name)
+#define SKIP_PROFILE_THREAD(name) Skip::CpuProfiler::setThreadName(name)
+#else
+#define SKIP_PROFILE_ZONE(name) ((void)0)
+#define SKIP_PROFILE_THREAD(name) ((void)sizeof(name))
+#endif
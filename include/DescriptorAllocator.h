@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Skip {
+
+    struct DescriptorAllocatorStats {
+        uint32_t poolCount = 0;
+        uint32_t setCount = 0;          // persistent sets handed out
+        uint32_t freeSetCount = 0;      // persistent sets handed back, waiting to be reused
+        uint32_t transientSetCount = 0; // allocated from the frame pools since their last reset
+    };
+
+    // Descriptor sets from pools that are added as they fill up, each new pool holding twice the sets
+    // of the one before (up to MAX_SETS_PER_POOL), so nothing has to be sized for the scene up front.
+    // Persistent sets are handed back with free and reused by the next allocate with the same layout,
+    // pools are never freed or rebuilt while sets come and go. Transient sets come from pools owned
+    // by a frame in flight slot and are all released at once by resetFrame.
+    // Pools are sized from the descriptors of one set (sizesPerSet), every layout allocated from the
+    // allocator has to fit in that
+    class DescriptorAllocator {
+
+    public:
+        DescriptorAllocator(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t frameCount);
+        ~DescriptorAllocator();
+        DescriptorAllocator(const DescriptorAllocator&) = delete;
+        DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+        // The set keeps its descriptors until it is handed out again, the caller makes sure no
+        // frame in flight still uses it
+        void free(VkDescriptorSetLayout layout, VkDescriptorSet set);
+
+        // valid until the slot is reset
+        VkDescriptorSet allocateTransient(uint32_t frameIndex, VkDescriptorSetLayout layout);
+        // the GPU has to be done with the slot's last frame
+        void resetFrame(uint32_t frameIndex);
+        // drops the frame pools, the device has to be idle
+        void setFrameCount(uint32_t frameCount);
+
+        // Returns every set to its pool, persistent and transient, for when the layouts are replaced.
+        // The device has to be idle
+        void reset();
+
+        DescriptorAllocatorStats getStats() const;
+
+        static constexpr uint32_t MIN_SETS_PER_POOL = 64;
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    private:
+        // pools before current are full, allocations start at current
+        struct PoolChain {
+            std::vector<VkDescriptorPool> pools;
+            size_t current = 0;
+            uint32_t nextSetCount = MIN_SETS_PER_POOL;
+            uint32_t setCount = 0;
+        };
+
+        VkDescriptorSet allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout);
+        VkDescriptorPool createPool(uint32_t setCount);
+        void resetChain(PoolChain& chain);
+        void destroyChain(PoolChain& chain);
+
+        VkDevice _device;
+        std::vector<VkDescriptorPoolSize> _sizesPerSet;
+        PoolChain _persistent;
+        std::vector<PoolChain> _frames;
+        std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> _freeSets;
+        uint32_t _freeSetCount = 0;
+    };
+
+}
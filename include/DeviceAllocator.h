@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <vector>
+
+namespace Skip {
+
+    // Long lived resources (meshes, textures, render targets) are sub-allocated with a buddy
+    // allocator. Transient resources (staging buffers) are bumped linearly through their
+    // blocks, which rewind once everything in them has been freed.
+    enum class MemoryPool {
+        LongLived,
+        Transient
+    };
+
+    // A sub-range of a device memory block. Host visible blocks stay mapped for their whole
+    // lifetime so mapped already points at offset
+    struct MemoryAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+        uint32_t blockIndex = UINT32_MAX;
+        uint32_t order = 0; // buddy order, unused by linear and dedicated blocks
+
+        bool isValid() const { return memory != VK_NULL_HANDLE; };
+    };
+
+    struct MemoryPoolStats {
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+        VkDeviceSize bytesReserved = 0; // sum of vkAllocateMemory sizes
+        VkDeviceSize bytesUsed = 0;     // sum of handed out ranges, including buddy rounding
+    };
+
+    struct AllocatorStats {
+        MemoryPoolStats longLived;
+        MemoryPoolStats transient;
+        MemoryPoolStats dedicated;
+        uint32_t deviceMemoryCount = 0; // live vkAllocateMemory objects
+        uint32_t peakDeviceMemoryCount = 0;
+        uint64_t totalAllocations = 0;
+    };
+
+    class DeviceAllocator {
+
+    public:
+        DeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+        ~DeviceAllocator();
+
+        MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+            MemoryPool pool = MemoryPool::LongLived);
+        void free(MemoryAllocation& allocation);
+
+        // allocate and bind in one go
+        MemoryAllocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryPool pool = MemoryPool::LongLived);
+        MemoryAllocation allocateImage(VkImage image, VkMemoryPropertyFlags properties, MemoryPool pool = MemoryPool::LongLived);
+
+        // offset and size are relative to the allocation, ranges are widened to nonCoherentAtomSize
+        VkResult flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+        VkResult invalidate(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+        AllocatorStats getStats() const;
+        void printStats(std::ostream& out) const;
+
+        VkDevice getDevice() const { return _device; };
+        VkPhysicalDevice getPhysicalDevice() const { return _physicalDevice; };
+
+        // Default block sizes, shrunk for small heaps
+        static constexpr VkDeviceSize LONG_LIVED_BLOCK_SIZE = 64ull * 1024 * 1024;
+        static constexpr VkDeviceSize TRANSIENT_BLOCK_SIZE = 32ull * 1024 * 1024;
+        static constexpr VkDeviceSize MIN_BUDDY_SIZE = 256;
+
+    private:
+        struct MemoryBlock {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            uint32_t memoryType = 0;
+            MemoryPool pool = MemoryPool::LongLived;
+            bool dedicated = false;
+            void* mapped = nullptr;
+            uint32_t allocationCount = 0;
+            VkDeviceSize bytesUsed = 0;
+
+            // linear
+            VkDeviceSize head = 0;
+
+            // buddy, free node offsets per order (node size = MIN_BUDDY_SIZE << order)
+            uint32_t maxOrder = 0;
+            std::vector<std::set<VkDeviceSize>> freeLists;
+        };
+
+        VkDevice _device;
+        VkPhysicalDevice _physicalDevice;
+        VkPhysicalDeviceMemoryProperties _memoryProperties;
+        VkDeviceSize _bufferImageGranularity;
+        VkDeviceSize _nonCoherentAtomSize;
+        VkDeviceSize _minBuddySize;
+
+        std::vector<std::unique_ptr<MemoryBlock>> _blocks; // freed slots are reused
+        uint32_t _deviceMemoryCount = 0;
+        uint32_t _peakDeviceMemoryCount = 0;
+        uint64_t _totalAllocations = 0;
+
+        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+        VkDeviceSize blockSizeFor(uint32_t memoryType, MemoryPool pool) const;
+        uint32_t createBlock(uint32_t memoryType, MemoryPool pool, VkDeviceSize size, bool dedicated);
+        void destroyBlock(uint32_t blockIndex);
+
+        bool allocateLinear(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+        bool allocateBuddy(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+        void freeBuddy(MemoryBlock& block, VkDeviceSize offset, uint32_t order);
+        VkResult mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const;
+    };
+
+}
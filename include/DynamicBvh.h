@@ -0,0 +1,96 @@
+#pragma once
+#include <Frustum.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Skip {
+
+    struct Aabb {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; };
+        float getSurfaceArea() const;
+        bool contains(const Aabb& other) const;
+        bool overlaps(const Aabb& other) const;
+        // distance along the ray where it enters the box, negative if it misses within maxDistance
+        float intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) const;
+
+        static Aabb merge(const Aabb& a, const Aabb& b);
+    };
+
+    // Dynamic AABB tree. Leaves store fattened boxes so small movements do not touch the tree,
+    // inserts pick the sibling with the lowest surface area cost and the tree is kept balanced
+    // with AVL style rotations. When moves have made it too loose it is rebuilt top down.
+    // Proxy ids stay valid until removed, rebuilds included.
+    class DynamicBvh {
+
+    public:
+        static constexpr int32_t NULL_NODE = -1;
+
+        DynamicBvh(float margin = 0.1f);
+
+        int32_t insert(const Aabb& box, void* userData);
+        void remove(int32_t proxy);
+        // returns true if the box left the fat box and the proxy had to be reinserted
+        bool move(int32_t proxy, const Aabb& box);
+
+        void* getUserData(int32_t proxy) const { return _nodes[proxy].userData; };
+        const Aabb& getFatAabb(int32_t proxy) const { return _nodes[proxy].box; };
+
+        // visit(proxy) for every proxy whose fat box overlaps box
+        void queryAabb(const Aabb& box, const std::function<void(int32_t)>& visit) const;
+        // visit(proxy, fullyInside), subtrees inside the frustum are reported without further tests
+        void queryFrustum(const Frustum& frustum, const std::function<void(int32_t, bool)>& visit) const;
+        // Closest hit within maxDistance, NULL_NODE if none. hitTest(proxy) refines a fat box hit
+        // and returns the exact distance or a negative value for a miss
+        int32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+            const std::function<float(int32_t)>& hitTest, float& hitDistance) const;
+
+        // A tree whose internal nodes cover much more area than after the last rebuild answers
+        // queries slowly
+        bool isDegraded() const;
+        void rebuild();
+
+        uint32_t getProxyCount() const { return _proxyCount; };
+        int32_t getHeight() const { return _root == NULL_NODE ? 0 : _nodes[_root].height; };
+        // summed surface area of the internal nodes, kept up to date as nodes change
+        float getInternalArea() const { return static_cast<float>(_internalArea); };
+
+    private:
+        struct Node {
+            Aabb box;
+            void* userData = nullptr;
+            int32_t parent = NULL_NODE;
+            int32_t left = NULL_NODE;
+            int32_t right = NULL_NODE;
+            int32_t next = NULL_NODE; // free list
+            int32_t height = -1; // 0 for leaves, -1 while free
+
+            bool isLeaf() const { return left == NULL_NODE; };
+        };
+
+        std::vector<Node> _nodes;
+        int32_t _root = NULL_NODE;
+        int32_t _freeList = NULL_NODE;
+        uint32_t _proxyCount = 0;
+        float _margin;
+        float _rebuiltArea = 0.0f; // getInternalArea() after the last rebuild
+        double _internalArea = 0.0;
+        static constexpr float DEGRADED_AREA_RATIO = 2.0f;
+
+        int32_t allocateNode();
+        void freeNode(int32_t index);
+        // sets an internal node's box and keeps _internalArea in step
+        void setInternalBox(int32_t index, const Aabb& box);
+        double sumInternalArea() const;
+        void insertLeaf(int32_t leaf);
+        void removeLeaf(int32_t leaf);
+        int32_t balance(int32_t index);
+        void refitUpwards(int32_t index);
+        int32_t buildTopDown(std::vector<int32_t>& leaves, size_t begin, size_t end);
+    };
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+
+// Batched sphere tests use SSE when the target has it, plain C++ otherwise
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKIP_FRUSTUM_SSE 1
+#endif
+
+namespace Skip {
+
+    enum class FrustumTest {
+        Outside,
+        Intersects,
+        Inside
+    };
+
+    // The six planes of a view projection, normals pointing inwards and normalized so plane
+    // distances are in world units. Expects Vulkan clip space (depth 0..1)
+    struct Frustum {
+        std::array<glm::vec4, 6> planes;
+
+        void update(const glm::mat4& viewProjection);
+
+        bool intersectsSphere(const glm::vec3& center, float radius) const;
+        bool intersectsAabb(const glm::vec3& min, const glm::vec3& max) const;
+        // also tells whether the box is completely inside, used to skip tests on whole subtrees
+        FrustumTest classifyAabb(const glm::vec3& min, const glm::vec3& max) const;
+    };
+
+    // Tests count spheres stored as separate x/y/z/radius arrays, writes 1 (visible) or
+    // 0 (culled) per sphere and returns how many are visible
+    uint32_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+        uint32_t count, uint8_t* visible);
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+
+#include <DeviceAllocator.h>
+#include <UploadManager.h>
+
+namespace Skip {
+
+    // Where a mesh lives inside the shared buffers, in vertices and indices rather than bytes
+    struct GeometryRange {
+        int32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+    };
+
+    // Scene wide geometry arena. All meshes share one vertex buffer and one index buffer so a
+    // command buffer binds them once and draws every object through its GeometryRange.
+    // Ranges are sub-allocated best fit from a free list indexed by size, when an arena runs out it
+    // is reallocated with twice the capacity and the old contents are copied over in the current
+    // upload batch. Data goes through the UploadManager, so add returns before the copy has run and
+    // the next frame waits for it
+    class GeometryBuffer {
+
+    public:
+        GeometryBuffer(DeviceAllocator* allocator, UploadManager* uploads, VkDeviceSize vertexStride,
+            uint32_t vertexCapacity = 65536, uint32_t indexCapacity = 262144);
+        ~GeometryBuffer();
+
+        // records the copies into the current upload batch, does not wait for them
+        GeometryRange add(const void* vertices, uint32_t vertexCount, const uint32_t* indices = nullptr, uint32_t indexCount = 0);
+        void remove(GeometryRange& range);
+
+        // grows the arenas up front, avoids reallocating while loading a known set of meshes
+        void reserve(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+        void bind(VkCommandBuffer commandBuffer) const;
+
+        // bumped every time the buffers are reallocated, recorded binds are stale after that
+        uint64_t _version = 0;
+        // Takes an outgrown buffer that frames in flight and the pending copy may still read, and
+        // destroys it once they are done. Without it grow waits for the copy and destroys it right away
+        std::function<void(VkBuffer, const MemoryAllocation&)> _retireBuffer;
+
+        uint32_t _vertexCount = 0; // live vertices and indices
+        uint32_t _indexCount = 0;
+
+    private:
+        struct Arena {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            MemoryAllocation memory;
+            VkBufferUsageFlags usage = 0;
+            VkDeviceSize stride = 0;
+            uint32_t capacity = 0;
+            std::map<uint32_t, uint32_t> freeRanges; // offset -> count, coalesced on free
+            std::set<std::pair<uint32_t, uint32_t>> freeBySize; // the same ranges as (count, offset)
+        };
+
+        DeviceAllocator* _allocator;
+        VkDevice _device;
+        UploadManager* _uploads;
+        Arena _vertices;
+        Arena _indices;
+
+        void createArena(Arena& arena, uint32_t capacity);
+        void grow(Arena& arena, uint32_t capacity);
+        uint32_t allocateRange(Arena& arena, uint32_t count);
+        void freeRange(Arena& arena, uint32_t offset, uint32_t count);
+        void insertFree(Arena& arena, uint32_t offset, uint32_t count);
+        void eraseFree(Arena& arena, std::map<uint32_t, uint32_t>::iterator range);
+    };
+
+}
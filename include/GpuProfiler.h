@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Skip {
+
+    // Timestamp queries around named scopes of a frame. Scopes are registered once and keep their id, so
+    // command buffers that are recorded once and reused (the scene secondaries) can write them too:
+    //     uint32_t scene = profiler->addScope("scene");
+    //     profiler->beginFrame(primary, frameIndex);  // outside a render pass, before any scope
+    //     profiler->begin(commandBuffer, frameIndex, scene);  ...  profiler->end(commandBuffer, frameIndex, scene);
+    // Every frame in flight slot has its own queries. They are read in collect once the slot's fence has
+    // signaled, framesInFlight frames later, so reading them never waits for the GPU
+    class GpuProfiler {
+
+    public:
+        static constexpr uint32_t MAX_SCOPES = 16;
+        static constexpr uint32_t HISTORY_SIZE = 120;
+
+        struct Scope {
+            std::string name;
+            std::array<float, HISTORY_SIZE> history{}; // milliseconds, ring buffer
+            uint32_t head = 0; // next sample goes here
+            uint32_t samples = 0;
+            float last = 0.0f;
+        };
+
+        // timestampValidBits of the queue family the frames are submitted to, 0 if it has no timestamps
+        GpuProfiler(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount);
+        ~GpuProfiler();
+        GpuProfiler(const GpuProfiler&) = delete;
+        GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+        // false when the graphics queue can not write timestamps, every call is a no-op then
+        bool isSupported() const { return _queryPool != VK_NULL_HANDLE; }
+
+        uint32_t addScope(const std::string& name);
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t scope);
+        void end(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t scope);
+        // Adds the slot's last results to the scope histories. Scopes that were not written in that frame
+        // are skipped
+        void collect(uint32_t frameIndex);
+
+        const std::vector<Scope>& getScopes() const { return _scopes; }
+        // p in [0, 1] over the scope's history, 0 without samples
+        float getPercentile(uint32_t scope, float p) const;
+
+    private:
+        uint32_t getQuery(uint32_t frameIndex, uint32_t scope) const { return (frameIndex * MAX_SCOPES + scope) * 2; }
+
+        VkDevice _device;
+        VkQueryPool _queryPool = VK_NULL_HANDLE;
+        double _timestampPeriod; // nanoseconds per tick
+        uint64_t _timestampMask; // only timestampValidBits of a timestamp are meaningful
+        std::vector<bool> _pending; // per slot, submitted and not collected yet
+        std::vector<Scope> _scopes;
+    };
+
+}
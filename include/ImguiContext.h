@@ -13,6 +13,8 @@
 #include <fstream>
 #include <vector>
 #include <Camera.h>
+#include <DeviceAllocator.h>
+#include <GpuProfiler.h>
 namespace Skip {
 
     // Options and values to display/toggle from the UI
@@ -23,15 +25,16 @@ namespace Skip {
         bool animateLight = false;
         float lightSpeed = 0.25f;
         std::array<float, 50> frameTimes{};
-        float frameTimeMin = 9999.0f, frameTimeMax = 0.0f;
+        float frameTimeMin = 9999.0f, frameTimeMax = 0.0f; // milliseconds
         float lightTimer = 0.0f;
     };
 
     // TODO add to initializer class
     struct Buffer {
         VkDevice device;
+        DeviceAllocator* allocator = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        MemoryAllocation memory;
         VkDescriptorBufferInfo descriptor;
         VkDeviceSize size = 0;
         VkDeviceSize alignment = 0;
@@ -63,10 +66,14 @@ namespace Skip {
         ~ImguiContext();
         void DestroyImguiContext(VkDevice device);
         void init(float width, float height);
-        void initResources(VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass, VkQueue copyQueue, VkCommandPool commandPool, const std::string& shadersPath, VkSampleCountFlagBits msaaSamples);
-        void newFrame(std::string title, std::string gpuDeviceName, float frameTimer, bool updateFrameGraph, Camera* camera);
-        void updateBuffers(VkDevice device, VkPhysicalDevice physicalDevice);
-        void drawFrame(VkCommandBuffer commandBuffer);
+        void initResources(VkDevice device, DeviceAllocator* allocator, VkRenderPass renderPass, VkQueue copyQueue, VkCommandPool commandPool, const std::string& shadersPath, VkSampleCountFlagBits msaaSamples,
+            const std::vector<uint8_t>& pipelineCacheData);
+        // frameTimer in seconds, the profiler's scopes are drawn as graphs when it is given
+        void newFrame(std::string title, std::string gpuDeviceName, float frameTimer, bool updateFrameGraph, Camera* camera,
+            const GpuProfiler* profiler = nullptr);
+        void setFrameCount(uint32_t frameCount);
+        void updateBuffers(uint32_t frameIndex);
+        void drawFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
 
         VkPipelineLayout pipelineLayout;
         VkPipeline pipeline;
@@ -74,12 +81,27 @@ namespace Skip {
         VkPipelineCache pipelineCache;
     private:
         // Vulkan resources for rendering the UI
+        DeviceAllocator* allocator = nullptr;
         VkSampler sampler;
-        Buffer vertexBuffer;
-        Buffer indexBuffer;
-        int32_t vertexCount = 0;
-        int32_t indexCount = 0;
-        VkDeviceMemory fontMemory = VK_NULL_HANDLE;
+        // Geometry is rewritten every frame, so each frame in flight gets its own region of one
+        // persistently mapped buffer, vertices first and the indices after them. The buffer only
+        // grows, a UI that stays the same size costs no allocations
+        struct FrameData {
+            VkDeviceSize vertexOffset = 0;
+            VkDeviceSize indexOffset = 0;
+        };
+        std::vector<FrameData> frames;
+        Buffer geometryBuffer;
+        VkDeviceSize frameCapacity = 0; // bytes per frame region
+        // Replaced by a larger buffer while other frames still draw from it, destroyed once each
+        // of those frames has come around again
+        struct RetiredBuffer {
+            Buffer buffer;
+            std::vector<bool> inUse; // per frame slot
+        };
+        std::vector<RetiredBuffer> retiredBuffers;
+        void destroyGeometryBuffers();
+        MemoryAllocation fontMemory;
         VkImage fontImage = VK_NULL_HANDLE;
         VkImageView fontView = VK_NULL_HANDLE;
         
@@ -122,9 +144,10 @@ namespace Skip {
         VkPipelineStageFlags dstStageMask);
 
 
-    void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+    // Memory comes from the device allocator, staging buffers should ask for the transient pool
+    void createBuffer(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, MemoryAllocation& bufferMemory, MemoryPool pool = MemoryPool::LongLived);
 
-    VkResult createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
-        Skip::Buffer* buffer, VkDeviceSize size, void* data = nullptr);
+    VkResult createBuffer(DeviceAllocator* allocator, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
+        Skip::Buffer* buffer, VkDeviceSize size, void* data = nullptr, MemoryPool pool = MemoryPool::LongLived);
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Skip {
+
+    // Startup timings. Assets are added from the loading threads, phases are the wall clock
+    // time of each loading stage so they can be compared against the summed asset times
+    class LoadReport {
+
+    public:
+        struct Entry {
+            std::string asset;
+            std::string stage;
+            float milliseconds;
+            uint64_t bytes;
+            std::string note;
+        };
+
+        void add(const std::string& asset, const std::string& stage, float milliseconds, uint64_t bytes = 0,
+            const std::string& note = "");
+        void addPhase(const std::string& phase, float milliseconds);
+        void clear();
+
+        void print(std::ostream& out) const;
+
+    private:
+        mutable std::mutex _mutex;
+        std::vector<Entry> _entries;
+        std::vector<std::pair<std::string, float>> _phases;
+    };
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <objects/SkipObject.h>
+#include <MappedFile.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Skip {
+
+    const std::string MESH_CACHE_DIRECTORY = "cache/meshes";
+
+    // A cache entry mapped in place, see SkipObject::_mappedMesh
+    struct MappedMesh {
+        MappedFile file;
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const uint32_t* indices = nullptr;
+        size_t indexCount = 0;
+    };
+
+    // Binary copy of a mesh after loading, deduplication and optimization, stored under MESH_CACHE_DIRECTORY
+    //     [MeshCacheHeader | source path | pad][vertices, 16 byte aligned][indices]
+    // An entry belongs to one source path, index buffer, weld tolerance and optimization setting. It is used as long as the
+    // source keeps its size and modification time, or its content hash when only the time changed
+    struct MeshCacheHeader {
+        static constexpr uint32_t MAGIC = 0x434d4b53; // "SKMC"
+        static constexpr uint32_t VERSION = 4; // 2: welded with VertexWelder, 3: optimized meshes, 4: weld tolerance
+        static constexpr uint32_t INDEXED = 1;
+        static constexpr uint32_t OPTIMIZED = 2;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexStride;
+        uint32_t flags;
+        float weldTolerance; // of an indexed mesh
+        uint32_t padding;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        uint64_t pathLength;
+        uint64_t vertexCount;
+        uint64_t vertexOffset;
+        uint64_t indexCount;
+        uint64_t indexOffset;
+        VertexCacheStats vertexCacheBefore; // of an optimized mesh
+        VertexCacheStats vertexCacheAfter;
+    };
+
+    std::string getMeshCachePath(const std::string& sourcePath, uint32_t flags);
+
+    // points the object's _mappedMesh at the cache entry, false if there is no valid entry for the
+    // source and the object's _useIndexBuffer, _weldTolerance and _optimizeMesh
+    bool loadMeshCache(const std::string& sourcePath, SkipObject* object);
+    // writes the object's mesh as the entry for the source, false if it could not be written
+    // (loading still works without it)
+    bool storeMeshCache(const std::string& sourcePath, const SkipObject* object);
+
+}
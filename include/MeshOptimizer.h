@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Skip {
+
+    // Post transform cache efficiency of an index buffer, simulated with a FIFO cache.
+    // acmr: vertex shader runs per triangle (0.5 is ideal on big regular meshes, 3 is worst)
+    // atvr: vertex shader runs per referenced vertex (1 is ideal)
+    struct VertexCacheStats {
+        float acmr = 0.0f;
+        float atvr = 0.0f;
+    };
+
+    const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+    // how much worse than the Tipsify order the overdraw order may make the ACMR
+    const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+    VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    // Reorders triangles for the post transform cache (Tipsify, Sander et al. 2007). clusters
+    // gets the first triangle of every run that had to restart from a dead end
+    void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    // Splits the clusters from optimizeVertexCache further where the cache allows it and sorts
+    // them outside in, so the front facing outer surface tends to be drawn before what it hides.
+    // positions points at the first vertex's x, y, z with positionStride bytes between vertices
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const float* positions, size_t positionStride, size_t vertexCount,
+        const std::vector<uint32_t>& clusters, float threshold = DEFAULT_OVERDRAW_THRESHOLD,
+        uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+    const uint32_t UNUSED_VERTEX = 0xffffffffu;
+    // Renumbers vertices in the order the indices first use them so vertex fetches walk memory
+    // forward. Returns the new index of every old vertex, UNUSED_VERTEX for unreferenced ones
+    std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount);
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Skip {
+
+    const std::string PIPELINE_CACHE_PATH = "cache/pipelines.bin";
+
+    // Header every VkPipelineCache data blob starts with (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    struct PipelineCacheHeader {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    // Contents of the cache file if it was written by this device and driver, empty otherwise. Drivers
+    // are not all robust against data from another GPU or version, so nothing else reaches them
+    std::vector<uint8_t> readPipelineCache(const VkPhysicalDeviceProperties& properties,
+        const std::string& path = PIPELINE_CACHE_PATH);
+
+    // cache seeded with data from readPipelineCache, empty data gives an empty cache
+    VkPipelineCache createPipelineCache(VkDevice device, const std::vector<uint8_t>& data);
+
+    // Merges the other caches into cache and writes the result under a temporary name that is then
+    // renamed over path, so an interrupted run never leaves half a file. False if it could not be written
+    bool writePipelineCache(VkDevice device, VkPipelineCache cache, const std::vector<VkPipelineCache>& others,
+        const std::string& path = PIPELINE_CACHE_PATH);
+
+}
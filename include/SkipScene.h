@@ -1,6 +1,10 @@
 #pragma once
 #include <objects/SkipObject.h>
 #include <Camera.h>
+#include <DynamicBvh.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
 #include <vector>
 namespace Skip {
     class SkipScene
@@ -12,15 +16,54 @@ namespace Skip {
         ~SkipScene();
 
         std::vector<SkipObject*> _objects;
+        // bumped whenever objects are added or removed so recorded draws can be invalidated
+        uint64_t _version = 0;
+        // Set by the swap chain so objects added or removed after loading get their GPU resources,
+        // the removed object is still alive when _objectRemoved is called
+        std::function<void(SkipObject*)> _objectAdded;
+        std::function<void(SkipObject*)> _objectRemoved;
 
         void loadScene(float aspect);
+        // loadScene in two steps for the parallel loader: loadObject may run on several threads
+        // at once for different objects, finishLoading runs once all of them are done
+        void loadObject(size_t index, float aspect);
+        void finishLoading(float aspect);
+
+        // same projection the objects are loaded with, used for culling
+        glm::mat4 _projection = glm::mat4(1.0f);
 
         // Used to dynamically change objects for events
         void addObject(SkipObject* skipObject, SkipObject* parent = nullptr, bool inheritLighting = true);
-        void removeObject(std::string name); 
+        // Removes every object with the name. The last object takes the removed one's place in
+        // _objects, so the order of the rest is not kept
+        void removeObject(std::string name);
+        void removeObject(SkipObject* object);
+
+        // Bounding volume hierarchy over the objects' world bounds. Instanced objects are not in
+        // it, their instances are spread out independently of the mesh
+        DynamicBvh _bvh;
+
+        // Moves the objects passed to updateObject since the last call and rebuilds the tree if
+        // it got too loose, returns how many objects left their fat boxes
+        uint32_t refit();
+        // Call after changing an object's _mvpUBO.model. Objects not in the tree yet are inserted
+        // right away, the others are moved by the next refit
+        void updateObject(SkipObject* object);
+
+        // objects drawn without culling, see _bvh
+        std::vector<SkipObject*> _instancedObjects;
+
+        // visit(object, fullyInside) for objects whose (fat) bounds touch the frustum
+        void queryFrustum(const Frustum& frustum, const std::function<void(SkipObject*, bool)>& visit) const;
+        // objects whose world bounds overlap box
+        void queryAabb(const Aabb& box, const std::function<void(SkipObject*)>& visit) const;
+        // closest object whose world bounds the ray hits, nullptr if none
+        SkipObject* raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = 1000.0f,
+            float* hitDistance = nullptr) const;
 
         Camera* _camera;
     private:
-
+        std::unordered_multimap<std::string, SkipObject*> _objectsByName;
+        std::vector<SkipObject*> _dirtyObjects; // waiting for refit
     };
 }
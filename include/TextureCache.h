@@ -0,0 +1,89 @@
+#pragma once
+#include <DeviceAllocator.h>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace Skip {
+
+    // What a texture is loaded as, two objects asking for the same key share one image
+    struct TextureKey {
+        std::string path;
+        bool srgb = true;    // ignored for .ktx2 files, their format says it
+        bool mipmaps = true; // false keeps only the first level
+
+        bool operator==(const TextureKey& other) const {
+            return path == other.path && srgb == other.srgb && mipmaps == other.mipmaps;
+        }
+    };
+
+    struct TextureKeyHash {
+        size_t operator()(const TextureKey& key) const;
+    };
+
+    // Sampler state, samplers are independent of the image so one serves every texture with the same settings
+    struct SamplerKey {
+        VkFilter filter = VK_FILTER_LINEAR;
+        VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        float maxAnisotropy = 16.0f; // 0 turns anisotropic filtering off
+
+        bool operator==(const SamplerKey& other) const {
+            return filter == other.filter && mipmapMode == other.mipmapMode && addressMode == other.addressMode
+                && maxAnisotropy == other.maxAnisotropy;
+        }
+    };
+
+    struct SamplerKeyHash {
+        size_t operator()(const SamplerKey& key) const;
+    };
+
+    // GPU side of a loaded texture, owned by the cache
+    struct CachedTexture {
+        VkImage image = VK_NULL_HANDLE;
+        MemoryAllocation memory;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        uint32_t mipLevels = 1;
+        uint32_t references = 0;
+    };
+
+    // Reference counted textures keyed by path and load parameters, plus samplers keyed by their state.
+    // The cache only hands out entries, loading and uploading them is up to the caller
+    class TextureCache {
+
+    public:
+        TextureCache(VkDevice device, DeviceAllocator* allocator, float maxAnisotropy);
+        ~TextureCache();
+        TextureCache(const TextureCache&) = delete;
+        TextureCache& operator=(const TextureCache&) = delete;
+
+        // adds a reference to the key's texture, created is true when the entry is new and still has to be loaded
+        CachedTexture* acquire(const TextureKey& key, bool& created);
+        // drops a reference, the image is destroyed with the last one. The caller makes sure no frame
+        // in flight still samples it
+        void release(const TextureKey& key);
+
+        // created on first use, samplers live as long as the cache
+        VkSampler getSampler(const SamplerKey& key);
+
+        size_t getTextureCount() const { return _textures.size(); }
+        size_t getSamplerCount() const { return _samplers.size(); }
+        // acquire calls that found an existing texture
+        uint32_t _hits = 0;
+
+    private:
+        void destroyTexture(CachedTexture& texture);
+
+        VkDevice _device;
+        DeviceAllocator* _allocator;
+        float _maxAnisotropy; // device limit
+
+        // node based, so entries keep their address while others are added
+        std::unordered_map<TextureKey, CachedTexture, TextureKeyHash> _textures;
+        std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> _samplers;
+    };
+
+}
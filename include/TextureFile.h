@@ -0,0 +1,52 @@
+#pragma once
+#include <MappedFile.h>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Skip {
+
+    // One mip level of a texture file, a range of the mapped file
+    struct TextureLevel {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // Texture stored in the GPU's own format with every mip level built offline, so it can be
+    // copied to the image as is. Levels are ordered from the largest one down
+    struct CompressedTexture {
+        std::unique_ptr<MappedFile> file;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<TextureLevel> levels;
+
+        const uint8_t* levelData(uint32_t level) const { return file->data() + levels[level].offset; }
+        uint64_t dataSize() const;
+    };
+
+    // Bytes per block and block edge in texels, 0 bytes for formats the loader does not take
+    //     BC1/BC4 8 bytes, BC2/BC3/BC5/BC7 16 bytes per 4x4 block, RGBA8 4 bytes per texel
+    struct TextureFormatInfo {
+        uint32_t blockBytes;
+        uint32_t blockSize;
+    };
+    TextureFormatInfo getTextureFormatInfo(VkFormat format);
+    // short name for the load report, e.g. "BC7 srgb"
+    std::string getTextureFormatName(VkFormat format);
+
+    // the .ktx2 to use for a texture: the path itself, or one next to a .png/.jpg with the same
+    // name, empty if there is none
+    std::string findCompressedTexture(const std::string& texturePath);
+
+    // Maps a KTX2 file (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) without
+    // supercompression, a single face and layer, in one of the formats above. Throws if the file
+    // can not be used
+    void loadKtx2(const std::string& path, CompressedTexture& texture);
+
+}
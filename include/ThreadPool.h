@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Skip {
+
+    // Fixed set of worker threads for fork/join style jobs (command buffer recording, asset
+    // loading). The caller blocks in parallelFor until every index has been processed.
+    class ThreadPool {
+
+    public:
+        // workers show up as "<name> <index>" in CPU profiler traces
+        explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency(), const std::string& name = "worker");
+        ~ThreadPool();
+
+        // Runs job(index) for every index in [0, count). The calling thread takes part, so a
+        // pool of N workers runs up to N + 1 jobs at once. Each index runs exactly once and on
+        // a single thread, which makes per index resources (command pools) safe to use inside
+        void parallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(_workers.size()); };
+
+    private:
+        std::vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _done;
+
+        // current parallelFor, guarded by _mutex
+        const std::function<void(uint32_t)>* _job = nullptr;
+        uint32_t _count = 0;
+        uint32_t _next = 0;
+        uint32_t _remaining = 0;
+        uint64_t _generation = 0;
+        bool _stopping = false;
+        std::exception_ptr _error; // first exception thrown by a job, rethrown by parallelFor
+
+        void workerLoop(std::string name);
+        // takes indices off the current job until none are left, called with the lock held
+        void runJobs(std::unique_lock<std::mutex>& lock);
+    };
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <DeviceAllocator.h>
+#include <VulkanDevice.h>
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace Skip {
+
+    // Uploads are staged in a persistently mapped ring buffer and recorded into batches that go to
+    // the transfer queue without waiting for them. Every batch signals the next value of a timeline
+    // semaphore when it finishes:
+    //     uint64_t value = uploads->flush();  ...  uploads->wait(value);
+    // When the transfer queue is a separate family, a batch releases whatever it wrote to the graphics
+    // family and the next graphics submission acquires it (see acquire). That submission also waits on
+    // the batch's value, so the CPU never blocks on an upload and the GPU only does once the data is used
+    class UploadManager {
+
+    public:
+        static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+
+        UploadManager(VulkanDevice* device, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+        ~UploadManager();
+        UploadManager(const UploadManager&) = delete;
+        UploadManager& operator=(const UploadManager&) = delete;
+
+        // Staging memory for the current batch, written by the caller and read by commands recorded into
+        // getCommandBuffer(). Waits for older batches when the ring is full, uploads larger than half the
+        // ring get a staging buffer of their own. May submit the current batch, so fetch the command buffer after
+        void* allocate(VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset, VkDeviceSize alignment = 16);
+        VkCommandBuffer getCommandBuffer();
+
+        // stages data and copies it into the buffer, which graphics then reads at dstStage with dstAccess
+        void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+            VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+        // Hands a buffer range or an image written by the current batch over to graphics. Images change
+        // to newLayout on the way
+        void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess,
+            VkPipelineStageFlags dstStage);
+        void releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+        // submits the current batch and returns its value, the last submitted one if nothing was recorded
+        uint64_t flush();
+        // every batch up to the returned value has finished, their ring space is free again
+        uint64_t getCompletedValue();
+        void wait(uint64_t value);
+
+        // Graphics side: records the acquire barriers of every submitted batch into commandBuffer, outside
+        // a render pass. Returns the value the submission of commandBuffer has to wait on at waitStage
+        // (on getSemaphore()), 0 if there is nothing to wait for
+        uint64_t acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags& waitStage);
+        VkSemaphore getSemaphore() const { return _timeline; }
+        // flushes and acquires everything uploaded so far in a graphics submission, records the optional
+        // commands after the acquire into it and waits for that submission's fence, frames already on the
+        // graphics queue are not waited for. For loading, and for code that works on uploaded resources
+        // outside a frame
+        void synchronize(VkCommandPool graphicsCommandPool, const std::function<void(VkCommandBuffer)>& record = nullptr);
+
+        bool hasDedicatedQueue() const { return _transferFamily != _graphicsFamily; }
+
+        // totals since creation
+        uint64_t _uploadedBytes = 0;
+        uint32_t _batchCount = 0;
+
+    private:
+        struct Batch {
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            uint64_t value = 0;
+            VkDeviceSize ringBytes = 0; // ring space used, alignment and wrap padding included
+            std::vector<VkBufferMemoryBarrier> bufferReleases;
+            std::vector<VkImageMemoryBarrier> imageReleases;
+            std::vector<std::pair<VkBuffer, MemoryAllocation>> dedicatedStaging;
+        };
+
+        void beginBatch();
+        void retire(Batch& batch);
+
+        VkDevice _device;
+        DeviceAllocator* _allocator;
+        VkQueue _queue;
+        VkQueue _graphicsQueue;
+        uint32_t _transferFamily;
+        uint32_t _graphicsFamily;
+        VkCommandPool _commandPool;
+        VkSemaphore _timeline;
+        VkFence _synchronizeFence; // signalled by the last synchronize submission
+
+        VkBuffer _ringBuffer;
+        MemoryAllocation _ringMemory;
+        VkDeviceSize _ringSize;
+        VkDeviceSize _ringHead = 0;
+        VkDeviceSize _ringUsed = 0;
+
+        Batch _current; // recording while its command buffer is set
+        std::deque<Batch> _submitted; // in submission order, until they finish
+        std::vector<VkCommandBuffer> _freeCommandBuffers;
+        uint64_t _submittedValue = 0;
+        uint64_t _completedValue = 0;
+
+        // graphics side of the submitted batches, until a graphics submission picks it up
+        std::vector<VkBufferMemoryBarrier> _bufferAcquires;
+        std::vector<VkImageMemoryBarrier> _imageAcquires;
+        VkPipelineStageFlags _acquireStages = 0;
+        uint64_t _acquiredValue = 0;
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Skip {
+
+    struct Vertex;
+
+    // How a mesh's vertices are stored on the GPU. Each format has its own geometry arena and
+    // pipeline, meshes pick theirs through SkipObject::_vertexFormat
+    enum class VertexFormat : uint32_t {
+        Full = 0,         // Vertex as is, 32 bit floats everywhere
+        Compact = 1,      // CompactVertex without color, drawn white
+        CompactColor = 2, // CompactVertex
+    };
+    const uint32_t VERTEX_FORMAT_COUNT = 3;
+
+    // Quantized vertex, 20 bytes (24 with color) instead of 56
+    struct CompactVertex {
+        uint16_t position[4]; // unorm16 within the mesh bounds, w is padding
+        uint32_t normal;      // octahedral snorm16x2
+        uint32_t tangent;     // octahedral snorm16x2
+        uint32_t texCoord;    // half float x2
+        uint32_t color;       // rgba8 unorm, past the end of the stride in VertexFormat::Compact
+    };
+
+    // Compact positions are decoded in the vertex shader as offset + position * scale
+    struct VertexDecodePushConstants {
+        glm::vec4 positionOffset = glm::vec4(0.0f);
+        glm::vec4 positionScale = glm::vec4(1.0f);
+    };
+
+    const char* getVertexFormatName(VertexFormat format);
+    uint32_t getVertexStride(VertexFormat format);
+    VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format);
+    std::vector<VkVertexInputAttributeDescription> getVertexAttributeDescriptions(VertexFormat format);
+
+    // Converts vertices to format, packed gets getVertexStride(format) bytes per vertex. The
+    // position decode for the shader is computed from the vertices' own bounds
+    void packVertices(VertexFormat format, const Vertex* vertices, size_t vertexCount, std::vector<uint8_t>& packed,
+        VertexDecodePushConstants& decode);
+
+    // unit vector to the [-1, 1] square and back
+    glm::vec2 encodeOctahedral(const glm::vec3& vector);
+    glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <objects/SkipObject.h>
+#include <ThreadPool.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Skip {
+
+    // Merges duplicate vertices of an unindexed vertex stream. Without a tolerance two vertices
+    // are the same when every attribute (tangent included) matches exactly. With one, a vertex
+    // is merged into the earliest welded vertex whose attributes are all within the tolerance.
+    // Positions are hashed by tolerance sized cells, so only the 27 cells around a vertex are searched
+    class VertexWelder {
+
+    public:
+        explicit VertexWelder(size_t expectedVertices = 0, float tolerance = 0.0f);
+
+        // index of vertex in vertices, appended first if it was not seen yet
+        uint32_t add(const Vertex& vertex, std::vector<Vertex>& vertices);
+        void clear();
+
+        // comparable form of a vertex, every attribute as 32 bits
+        typedef std::array<uint32_t, 14> Key;
+        static Key makeKey(const Vertex& vertex);
+        static uint64_t hashKey(const Key& key);
+
+    private:
+        static constexpr uint32_t EMPTY = 0xffffffffu;
+
+        // open addressing with linear probing, power of two sized and at most half full.
+        // Slots hold an index into the caller's vertices, the tags (low hash bits) skip most key compares
+        std::vector<uint32_t> _slots;
+        std::vector<uint32_t> _tags;
+        std::vector<uint64_t> _hashes; // per welded vertex, to rehash on growth
+        float _tolerance = 0.0f;
+        float _inverseTolerance = 0.0f;
+
+        void grow();
+        void insert(uint64_t hash, uint32_t index);
+        // tolerance mode, the table holds position cells instead of keys
+        uint32_t addNearby(const Vertex& vertex, std::vector<Vertex>& vertices);
+        static uint64_t hashCell(int32_t x, int32_t y, int32_t z);
+        static bool isNearby(const Vertex& a, const Vertex& b, float tolerance);
+    };
+
+    // exact welds of streams above this use the parallel sort instead of the hash table
+    const size_t PARALLEL_WELD_THRESHOLD = 1 << 20;
+
+    // Replaces vertices and indices with the welded form of stream, the unique vertices keep the
+    // order they first appear in. Exact welds of large streams go to weldVerticesSorted when threads
+    // are given, everything else to weldVerticesHashed. Callers already running on a pool (the
+    // loaders) leave threads out and weld on their own thread
+    void weldVertices(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        float tolerance = 0.0f, ThreadPool* threads = nullptr);
+    void weldVerticesHashed(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        float tolerance = 0.0f);
+    // Exact weld only. Sorts the vertex hashes with a radix sort, spread over threads when given,
+    // and gives the same result as weldVerticesHashed without a tolerance
+    void weldVerticesSorted(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        ThreadPool* threads = nullptr);
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <DeviceAllocator.h>
 #include <optional>
 #include <map>
 #include <vector>
@@ -12,6 +13,12 @@ namespace Skip {
         VkPhysicalDevice device;
         VkPhysicalDeviceProperties properties;
         VkPhysicalDeviceFeatures features;
+        // what the bindless mode needs from descriptor indexing (core in 1.2), and how many
+        // textures fit into its array
+        bool descriptorIndexing = false;
+        uint32_t maxBindlessTextures = 0;
+        // Vulkan 1.2 with timeline semaphores, the UploadManager needs them so devices without are not used
+        bool timelineSemaphore = false;
         VkSampleCountFlagBits msaaSamples;
         int score;
     };
@@ -19,6 +26,9 @@ namespace Skip {
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // a transfer only family when the device has one, then any other non graphics family that
+        // can copy, the graphics family otherwise
+        std::optional<uint32_t> transferFamily;
         bool isComplete();
         static QueueFamilyIndices findQueueFamilies(GPUInfo* gpuInfo, VkSurfaceKHR& surface);
     };
@@ -40,7 +50,10 @@ namespace Skip {
 
         GPUInfo* _gpuInfo;
         Queues _queues;
+        QueueFamilyIndices _queueFamilies;
         VkDevice _logicalDevice = VK_NULL_HANDLE;
+        // every buffer and image memory is sub-allocated from here, created with the logical device
+        DeviceAllocator* _allocator = nullptr;
 
         VkPhysicalDevice getPhysicalDevice() {
             return _gpuInfo->device;
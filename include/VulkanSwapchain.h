@@ -13,15 +13,47 @@
 #include <fstream>
 #include <chrono>
 #include <unordered_map>
+#include <map>
+#include <limits>
 
 #include <ImguiContext.h>
+#include <GeometryBuffer.h>
+#include <VertexFormat.h>
+#include <ThreadPool.h>
+#include <LoadReport.h>
+#include <TextureFile.h>
+#include <TextureCache.h>
+#include <PipelineCache.h>
+#include <DescriptorAllocator.h>
+#include <GpuProfiler.h>
+#include <UploadManager.h>
+#include <Frustum.h>
 #include <VulkanDevice.h>
 #include <VulkanWindow.h>
 #include <objects/SkipObject.h>
+#include <objects/InstancedObject.h>
 #include <imgui.h>
 
 namespace Skip {
 
+    // upper bound of the bindless texture array, lowered to what the device supports
+    const uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+
+    // One object in the bindless object buffer, laid out like ObjectData in resources/shaders/bindless.glsl (std430)
+    struct BindlessObjectData {
+        MvpBufferObject mvp;
+        LightBufferObject light;
+        VertexDecodePushConstants decode;
+        alignas(16) uint32_t textureIndex = 0;
+    };
+
+    // What _descriptorUpdateTemplate reads to write one per texture set, in binding order
+    struct TextureDescriptorData {
+        VkDescriptorBufferInfo mvp;
+        VkDescriptorImageInfo texture;
+        VkDescriptorBufferInfo light;
+    };
+
     struct SwapchainDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
@@ -40,11 +72,11 @@ namespace Skip {
 
         ImguiContext* _imguiContext = nullptr;
 
-        float _frameTimer = 0.0f;
+        float _frameTimer = 0.0f; // seconds, CPU time since the last frame
 
         VkInstance* _instance;
 
-        VkSwapchainKHR _swapChain;
+        VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
         std::vector<VkImage> _swapChainImages;
         VkFormat _swapChainImageFormat;
         VkExtent2D _swapChainExtent;
@@ -54,22 +86,86 @@ namespace Skip {
         VkDescriptorSetLayout _descriptorSetLayout;
         VkPipelineLayout _pipelineLayout;
         VkPipelineCache _pipelineCache;
-        VkPipeline _graphicsPipeline;
+        std::vector<uint8_t> _pipelineCacheData; // file contents, until the UI cache is created from them
+        std::array<VkPipeline, VERTEX_FORMAT_COUNT> _graphicsPipelines; // one per VertexFormat
+        VkPipeline _instancedPipeline; // same layout, adds the per instance vertex binding
         VkCommandPool _commandPool;
         VkImage _colorImage;
-        VkDeviceMemory _colorImageMemory;
+        MemoryAllocation _colorImageMemory;
         VkImageView _colorImageView;
         VkImage _depthImage;
-        VkDeviceMemory _depthImageMemory;
+        MemoryAllocation _depthImageMemory;
         VkImageView _depthImageView;
         std::vector<VkFramebuffer> _swapChainFramebuffers;
         SkipScene* _scene;
         SwapchainDetails querySwapchain();
 
-        VkDescriptorPool _descriptorPool;
+        // Objects with the same texture view and sampler share a set, acquired when the first of them
+        // is added and handed back to _descriptorAllocator after the last one is removed. The allocator
+        // adds pools as the scene grows and reuses handed back sets, which are written through
+        // _descriptorUpdateTemplate. _descriptorPool only holds the bindless set
+        struct TextureDescriptorSet {
+            VkDescriptorSet set = VK_NULL_HANDLE;
+            uint32_t references = 0;
+        };
+        DescriptorAllocator* _descriptorAllocator = nullptr;
+        VkDescriptorUpdateTemplate _descriptorUpdateTemplate = VK_NULL_HANDLE;
+        VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+        std::map<std::pair<VkImageView, VkSampler>, TextureDescriptorSet> _textureDescriptorSets;
 
-        std::vector<VkDescriptorSet> _descriptorSets;
+        // Everything the CPU writes while building a frame is owned by a frame in flight slot,
+        // so the next frame can be built while the GPU is still busy with the previous ones
         std::vector<VkCommandBuffer> _commandBuffers;
+        std::vector<VkCommandBuffer> _sceneCommandBuffers;
+        std::vector<VkCommandBuffer> _uiCommandBuffers;
+        std::vector<bool> _sceneCommandBuffersDirty;
+
+        // Scene draws are recorded in parallel, one slice of _scene->_objects per thread
+        uint32_t _recordThreadCount = 1;
+        ThreadPool* _recordThreads = nullptr;
+        std::vector<VkCommandPool> _recordCommandPools; // one per recording thread
+
+        // Objects outside the camera frustum are left out of the scene draws. A slot is
+        // re-recorded when the visible set differs from the one it was recorded with
+        bool _frustumCulling = true;
+        Frustum _frustum;
+        std::vector<uint8_t> _visibility; // per object, current frame
+        std::vector<uint32_t> _visibleObjects; // indices set in _visibility, cleared by the next cull
+        std::vector<std::vector<uint8_t>> _recordedVisibility; // per frame slot
+        uint32_t _culledObjectCount = 0; // last frame
+        uint64_t _recordedSceneVersion = 0;
+
+        // vertices and indices of every object, one set of buffers per VertexFormat in use
+        std::array<GeometryBuffer*, VERTEX_FORMAT_COUNT> _geometryBuffers = {};
+        uint64_t _recordedGeometryVersion = 0;
+        // changes whenever any of the geometry buffers is reallocated
+        uint64_t getGeometryVersion() const;
+
+        // Uniform data of every object lives in one persistently mapped ring. Each frame slot
+        // owns a region of it and descriptors pick their object through dynamic offsets
+        //     [frame 0: obj0 mvp | obj0 light | obj1 mvp | ...][frame 1: ...]
+        // Regions have room for _uniformObjectCapacity objects, the ring is replaced by one twice
+        // as large once the scene outgrows it, see growUniformBuffer
+        Buffer _uniformBuffer;
+        VkDeviceSize _uniformLightOffset = 0; // light block offset inside an object
+        VkDeviceSize _uniformObjectStride = 0;
+        VkDeviceSize _uniformFrameStride = 0;
+        uint32_t _uniformObjectCapacity = 0;
+
+        // Bindless mode: one descriptor set for the whole scene. _uniformBuffer holds a BindlessObjectData
+        // per object and frame and is bound as a storage buffer, next to an array of every texture.
+        // Draws pick their entry with a push constant, see setBindless
+        bool _bindless = false;
+        VkDescriptorSet _bindlessDescriptorSet = VK_NULL_HANDLE;
+        uint32_t _bindlessTextureCapacity = 0;
+        // array index per view and sampler, indices of released textures are reused once no frame samples them
+        struct BindlessTexture {
+            uint32_t index = 0;
+            uint32_t references = 0;
+        };
+        std::map<std::pair<VkImageView, VkSampler>, BindlessTexture> _bindlessTextures;
+        std::vector<uint32_t> _bindlessFreeIndices;
+        uint32_t _bindlessTextureCount = 0; // array elements written so far
 
         //semaphores
         std::vector<VkSemaphore> _imageAvailableSemaphores;
@@ -78,42 +174,161 @@ namespace Skip {
         std::vector<VkFence> _imagesInFlight;
         size_t _currentFrame = 0;
 
-        //defines how many frames to be processed concurrently
+        //defines how many frames to be processed concurrently, see setFramesInFlight
         //note: each frame should have its own set of semaphores
-        const int MAX_FRAMES_IN_FLIGHT = 2;
+        uint32_t _framesInFlight = 2;
+
+        // objects the BVH found on the frustum border and their world space bounding spheres,
+        // rebuilt every frame for the batched sphere test
+        std::vector<SkipObject*> _cullCandidates;
+        std::vector<float> _cullX, _cullY, _cullZ, _cullRadius;
+        std::vector<uint8_t> _cullVisible;
 
         //handle resizing
         bool _framebufferResized = false;
+        float _resizeTime = 0.0f; // milliseconds the last recreateSwapChain took
+
+        // Size dependent resources replaced by a resize. Frames in flight may still render into them,
+        // so they are destroyed once the first frame submitted after the resize has completed
+        struct RetiredSwapchain {
+            uint64_t frame = 0;
+            VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+            std::vector<VkImageView> imageViews;
+            std::vector<VkFramebuffer> framebuffers;
+            std::vector<VkImage> offscreenImages;
+            std::vector<MemoryAllocation> offscreenImagesMemory;
+            VkImage colorImage = VK_NULL_HANDLE;
+            MemoryAllocation colorImageMemory;
+            VkImageView colorImageView = VK_NULL_HANDLE;
+            VkImage depthImage = VK_NULL_HANDLE;
+            MemoryAllocation depthImageMemory;
+            VkImageView depthImageView = VK_NULL_HANDLE;
+        };
+        std::vector<RetiredSwapchain> _retiredSwapchains;
+
+        // Buffers, descriptor sets and geometry ranges replaced or released between frames, destroyed
+        // (or handed back) once the frames in flight that could still read them have completed
+        struct RetiredResources {
+            uint64_t frame = 0;
+            std::vector<Buffer> buffers;
+            std::vector<VkBuffer> instanceBuffers;
+            std::vector<MemoryAllocation> instanceBuffersMemory;
+            std::vector<std::pair<VkBuffer, MemoryAllocation>> geometryBuffers; // outgrown arenas
+            std::vector<std::pair<VertexFormat, GeometryRange>> geometry;
+            std::vector<VkDescriptorSet> descriptorSets; // from _descriptorAllocator
+            std::vector<VkDescriptorSet> bindlessDescriptorSets; // from _descriptorPool
+            std::vector<std::pair<VkDescriptorSet, uint32_t>> bindlessTextures; // array element of a bindless set
+            std::vector<TextureKey> textures; // references in _textureCache
+        };
+        std::vector<RetiredResources> _retiredResources;
+        // frames submitted so far, and how many of them the GPU has finished
+        uint64_t _submittedFrames = 0;
+        uint64_t _completedFrames = 0;
+        std::vector<uint64_t> _slotFrames; // last frame submitted from each frame in flight slot
+
+        // headless mode renders into offscreen images instead of a presentable swap chain
+        bool _headless = false;
+        const uint32_t HEADLESS_IMAGE_COUNT = 3;
+        std::vector<MemoryAllocation> _offscreenImagesMemory;
+        uint32_t _offscreenImageIndex = 0;
+
+        // per asset load times, filled while the constructor loads the scene
+        LoadReport _loadReport;
+
+        // every object's texture image, view and sampler, shared between objects loading the same one
+        TextureCache* _textureCache = nullptr;
+
+        // staging ring and transfer queue batches for textures and geometry
+        UploadManager* _uploads = nullptr;
+        // what the frame being recorded waits on, set by buildCommandBuffers
+        uint64_t _uploadWaitValue = 0;
+        VkPipelineStageFlags _uploadWaitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+        // GPU timings of the frame and its passes, shown in the UI
+        GpuProfiler* _gpuProfiler = nullptr;
+        uint32_t _frameScope = 0;
+        uint32_t _sceneScope = 0;
+        uint32_t _uiScope = 0;
+        bool _timestampsSupported = false;
+        float _gpuFrameTime = 0.0f; // milliseconds, last completed frame
+        float _cpuWaitTime = 0.0f; // milliseconds spent waiting on fences in stageFrame
 
         uint32_t stageFrame();
-        void updateUniformBuffers(uint32_t currentImage);
+        void updateUniformBuffers();
         void drawFrame(uint32_t currentImage, float deltaTime);
+        // Rebuilds the swap chain and what depends on its size (image views, framebuffers, color and depth
+        // attachments) without waiting for the device. The render pass and pipelines only when the format changed
         void recreateSwapChain();
+        // headless counterpart of a window resize
+        void resize(uint32_t width, uint32_t height);
         void cleanupSwapChain();
 
+        // changes how many frames the CPU may run ahead of the GPU, waits for the device to go idle
+        void setFramesInFlight(uint32_t framesInFlight);
+
+        // changes how many threads record the scene, waits for the device to go idle
+        void setRecordThreadCount(uint32_t threadCount);
+        // average milliseconds to record the whole scene once, used to benchmark recording
+        float measureSceneRecording(uint32_t iterations);
+
+        // switches between per texture descriptor sets and the bindless mode, waits for the device to go idle
+        bool isBindlessSupported() const;
+        void setBindless(bool bindless);
+        // Array index of a texture in bindless mode. A new one is written into the bound set right away,
+        // frames in flight do not read it so nothing waits and no set is reallocated
+        uint32_t addBindlessTexture(VkImageView view, VkSampler sampler);
+        void releaseBindlessTexture(VkImageView view, VkSampler sampler);
+
+        // the object's descriptor set, or its bindless texture index, shared with every object using the same texture
+        void acquireDescriptorSet(SkipObject* object);
+        void releaseDescriptorSet(SkipObject* object);
+
+        // forces the static scene draws to be recorded again on the next frame
+        void invalidateCommandBuffers();
+
+        // moves an object's mesh into the shared geometry buffer, or back out of it
+        void uploadGeometry(SkipObject* object);
+        void releaseGeometry(SkipObject* object);
+
+        // SkipScene::addObject and removeObject call these once the swap chain exists, so objects
+        // added at runtime are loaded and uploaded and removed ones give back what they held
+        void addSceneObject(SkipObject* object);
+        void removeSceneObject(SkipObject* object);
+
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     private:
        
         VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 
         void createSwapChain();
+        void createOffscreenImages();
+        void retireSwapChain();
+        // destroys the retired resources of every resize up to completedFrame
+        void destroyRetiredSwapchains(uint64_t completedFrame);
+        // what is retired now waits for every frame submitted so far
+        RetiredResources& retireResources();
+        void destroyRetiredResources(uint64_t completedFrame);
         void createImageViews();
         VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
             uint32_t mipLevels);
 
         void createRenderPass();
-        void createPipelineCache();
+        // seeded from PIPELINE_CACHE_PATH, written back with the UI cache merged in on exit
+        void loadPipelineCache();
+        void savePipelineCache();
         VkFormat findDepthFormat();
         VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, 
             VkFormatFeatureFlags features);
 
         void createDescriptorSetLayout();
+        void createBindlessDescriptorSetLayout();
+        void createDescriptorUpdateTemplate();
         void createGraphicsPipeline();
         void createCommandPool();
 
         void createColorResources();
         void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format,
-            VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+            VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory);
         //bool hasStencilComponent(VkFormat format);
 
         void createDepthResources();
@@ -122,26 +337,59 @@ namespace Skip {
 
         void createFramebuffers();
 
-        // We are managing multiple textures using ModelObject struct
-        void createTextureImages();
-        
-        void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-        void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+        // decoded texture waiting for its upload, or a mapped .ktx2 with all its mips
+        struct TextureData {
+            TextureKey key;
+            CachedTexture* texture = nullptr; // filled by the upload
+            unsigned char* pixels = nullptr;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            CompressedTexture compressed;
+        };
+
+        // Meshes and textures of every object are loaded on worker threads, textures are then
+        // uploaded through the UploadManager
+        void loadAssets();
+        // the mapped .ktx2 or the decoded image, safe to run on several threads at once
+        void decodeTexture(TextureData& texture);
+        // maps the texture's .ktx2 if there is one the device can sample, false to decode the image instead
+        bool loadCompressedTexture(TextureData& texture, std::string& note);
+        bool isTextureFormatSupported(VkFormat format);
+        void uploadTextures(std::vector<TextureData>& textures);
+
+        void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image,
+            uint32_t width, uint32_t height);
+        // one copy with a region per stored mip level, the image stays in TRANSFER_DST_OPTIMAL
+        void copyCompressedTexture(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image,
+            const CompressedTexture& texture);
+        void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
         
-        void createTextureImageViews();
         void createTextureSamplers();
-        void loadObjects();
 
-        void createVertexBuffers();
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        void createIndexBuffers();
+        void createGeometryBuffer();
+        GeometryBuffer* getGeometryBuffer(VertexFormat format);
+        GeometryBuffer* newGeometryBuffer(VertexFormat format, uint32_t vertexCapacity = 65536, uint32_t indexCapacity = 262144);
 
+        void createFrameResources();
+        void destroyFrameResources();
         void createUniformBuffers();
+        // replaces the ring and the descriptors pointing into it, frames in flight keep the old ones
+        void growUniformBuffer(size_t objectCount);
+        void createInstanceBuffer(InstancedObject* object);
+        void destroyInstanceBuffer(InstancedObject* object);
+        void updateInstanceBuffer(InstancedObject* object);
         void createDescriptorPool();
         void createDescriptorSets();
+        void createBindlessDescriptorSet();
         void allocateCommandBuffers();
-        void buildCommandBuffers();
+        void recordSceneCommandBuffer(uint32_t frameIndex);
+        void recordSceneSlice(uint32_t frameIndex, uint32_t slice, size_t begin, size_t end);
+        void cullScene();
+        void setAllVisible();
+        void recordUiCommandBuffer(uint32_t frameIndex);
+        void buildCommandBuffers(uint32_t imageIndex);
         void createSyncObjects();
+        void createGpuProfiler();
         
         void initImgui();
     };
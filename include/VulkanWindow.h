@@ -31,6 +31,8 @@ namespace Skip {
         
         bool _cameraActive = false;
         bool _framebufferResized = false;
+        // headless windows never touch glfw; the swapchain renders into offscreen images instead
+        bool _headless = false;
         GLFWwindow* _glfw = nullptr;
         VkSurfaceKHR _surface = VK_NULL_HANDLE;
         SkipScene* _scene = nullptr;
@@ -0,0 +1,58 @@
+#pragma once
+#include <objects/SkipObject.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+const std::string DEFAULT_INSTANCED_NAME = "InstancedSkipObject";
+namespace Skip {
+
+    // Per instance data, streamed to instanced.vert with VK_VERTEX_INPUT_RATE_INSTANCE
+    struct InstanceData {
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::vec4 color = glm::vec4(1.0f); // multiplied with the vertex color
+
+        static VkVertexInputBindingDescription getBindingDescription();
+        static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions();
+    };
+
+    // Draws one mesh many times with a single draw call. The mesh is any other object (Sphere,
+    // Cube, Model) that is only used to build the geometry, it should not be added to the scene.
+    // The instanced object owns the mesh and deletes it with itself.
+    // Geometry, texture and descriptors exist once, the view/projection comes from _mvpUBO
+    // and every instance brings its own model matrix and color.
+    class InstancedObject : public SkipObject
+    {
+    public:
+        InstancedObject(std::string name, SkipObject* mesh, uint32_t capacity = 64);
+        InstancedObject(SkipObject* mesh, uint32_t capacity = 64);
+        ~InstancedObject();
+        InstancedObject(const InstancedObject&) = delete;
+        InstancedObject& operator=(const InstancedObject&) = delete;
+
+        void loadObject(float aspect);
+
+        // Instances can be changed every frame, only the modified ranges are written to the GPU
+        uint32_t addInstance(const InstanceData& instance);
+        void setInstance(uint32_t index, const InstanceData& instance);
+        // moves the last instance into the freed index
+        void removeInstance(uint32_t index);
+        void clearInstances();
+        uint32_t getInstanceCount() const { return static_cast<uint32_t>(_instances.size()); };
+
+        SkipObject* _mesh;
+        std::vector<InstanceData> _instances;
+
+        // Managed by the swap chain: a mapped buffer with one region of _instanceCapacity
+        // instances per frame in flight, and the range each region still has to catch up on
+        VkBuffer _instanceBuffer = VK_NULL_HANDLE;
+        MemoryAllocation _instanceBufferMemory;
+        uint32_t _instanceCapacity;
+        std::vector<std::pair<uint32_t, uint32_t>> _dirtyRanges;
+        uint32_t _recordedInstanceCount = 0;
+
+        void markDirty(uint32_t begin, uint32_t end);
+    private:
+
+    };
+}
@@ -21,6 +21,9 @@ namespace Skip {
         std::string _modelPath;
 
         void loadObject(float aspect);
+
+        // every face corner of an obj file as its own vertex, not welded yet
+        static void readObj(const std::string& path, std::vector<Vertex>& corners);
     private:
 
     };
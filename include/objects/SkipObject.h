@@ -8,12 +8,21 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <array>
+#include <memory>
 #include <vulkan/vulkan.h>
+#include <DeviceAllocator.h>
+#include <GeometryBuffer.h>
+#include <DynamicBvh.h>
+#include <MeshOptimizer.h>
+#include <VertexFormat.h>
+#include <TextureCache.h>
 
 const std::string DEFAULT_TEXTURE = "resources/defaults/blue_texture.png";
 const std::string DEFAULT_NAME = "SkipObject";
 namespace Skip {
 
+    struct MappedMesh;
+
     struct Vertex {
         glm::vec3 position;
         glm::vec3 color;
@@ -32,16 +41,6 @@ namespace Skip {
 
 }
 
-namespace std {
-    template<> struct hash<Skip::Vertex> {
-        size_t operator()(Skip::Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.position) ^
-                (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
-}
-
 namespace Skip {
     
     const glm::vec4 DEFAULT_GLOBAL_AMBIENT = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
@@ -95,30 +94,72 @@ namespace Skip {
         glm::vec3 _position;
 
         std::string _texturePath;
+        // how the texture is loaded and sampled, objects with the same settings share the image and sampler
+        bool _textureSrgb = true;
+        bool _textureMipmaps = true;
+        SamplerKey _samplerState;
+        TextureKey getTextureKey() const { return TextureKey{ _texturePath, _textureSrgb, _textureMipmaps }; }
+        // owned by the swap chain's TextureCache
         VkImage _textureImage;
-        VkDeviceMemory _textureImageMemory;
         VkImageView _textureImageView;
         VkSampler _textureSampler;
+        VkDescriptorSet _descriptorSet = VK_NULL_HANDLE; // shared by the objects with the same view and sampler
+        uint32_t _bindlessTextureIndex = 0; // in the swap chain's bindless texture array
         uint32_t _mipLevels;
+        VkFormat _textureFormat = VK_FORMAT_R8G8B8A8_SRGB; // block compressed when loaded from a .ktx2
         std::vector<Vertex> _vertices;
-        std::unordered_map<Vertex, uint32_t> _uniqueVertices;
         std::vector<uint32_t> _indices;
-
-        VkBuffer _vertexBuffer;
-        VkDeviceMemory _vertexBufferMemory;
+        // Set instead of _vertices and _indices when the mesh came from the mesh cache. The entry stays
+        // mapped for as long as an object uses it and geometry uploads read straight out of it, so
+        // read the mesh through these getters, they pick whichever is set
+        std::shared_ptr<const MappedMesh> _mappedMesh;
+        const Vertex* getVertexData() const;
+        size_t getVertexCount() const;
+        const uint32_t* getIndexData() const;
+        size_t getIndexCount() const;
+
+        // where the vertices/indices live in the swap chain's shared GeometryBuffer
+        GeometryRange _geometry;
+
+        // GPU layout of the vertices, set before the object is uploaded. Instanced objects
+        // always use VertexFormat::Full
+        VertexFormat _vertexFormat = VertexFormat::Full;
+        VertexFormat _geometryFormat = VertexFormat::Full; // the format _geometry was uploaded in
+        VertexDecodePushConstants _vertexDecode; // position bounds of the compact formats
 
         bool _useIndexBuffer;
-        VkBuffer _indexBuffer;
-        VkDeviceMemory _indexBufferMemory;
+        // indexed meshes merge vertices whose attributes are all this close when loaded, 0 merges
+        // exact duplicates only. Set before loading
+        float _weldTolerance = 0.0f;
+        // set by InstancedObject, drawn with the instanced pipeline
+        bool _instanced = false;
+
+        // Indexed meshes get their triangles and vertices reordered for the GPU caches when
+        // loaded, turn off before loading to keep the order loadObject produced
+        bool _optimizeMesh = true;
+        bool _meshOptimized = false;
+        VertexCacheStats _vertexCacheBefore;
+        VertexCacheStats _vertexCacheAfter;
+        void optimizeMesh();
 
         MvpBufferObject _mvpUBO{};
         LightBufferObject _lightUBO{};
 
-        std::vector<VkBuffer> _mvpUboBuffers;
-        std::vector<VkDeviceMemory> _mvpUboBuffersMemory;
-
-        std::vector<VkBuffer> _lightUboBuffers;
-        std::vector<VkDeviceMemory> _lightUboBuffersMemory;
+        // Local bounds of _vertices, filled by computeBounds once the object is loaded
+        glm::vec3 _boundsMin = glm::vec3(0.0f);
+        glm::vec3 _boundsMax = glm::vec3(0.0f);
+        glm::vec3 _boundsCenter = glm::vec3(0.0f);
+        float _boundsRadius = 0.0f;
+        void computeBounds();
+
+        // Local box moved by _mvpUBO.model, kept up to date by SkipScene::updateObject and refit
+        Aabb _worldBounds;
+        void updateWorldBounds();
+
+        // scene bookkeeping
+        uint32_t _sceneIndex = 0; // position in SkipScene::_objects
+        int32_t _bvhProxy = DynamicBvh::NULL_NODE;
+        bool _bvhDirty = false; // in SkipScene's list for the next refit
 
         std::vector<SkipObject*> _children;
         bool _inheritLighting = false;
@@ -0,0 +1,49 @@
+// Set layout of the bindless mode (VulkanSwapchain::setBindless), included by the shaders when they
+// are compiled with -DBINDLESS. Every object's data lives in one storage buffer and its texture in one
+// array, the draw picks both through its object index.
+// Including shaders enable GL_EXT_nonuniform_qualifier for the unsized array. The index is the same
+// for the whole draw, so it needs no nonuniformEXT
+
+struct LightData {
+    vec4 globalAmbient;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+
+    vec4 matAmbient;
+    vec4 matDiffuse;
+    vec4 matSpecular;
+    float matShininess;
+
+    vec3 position;
+};
+
+// BindlessObjectData
+struct ObjectData {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 norm;
+    LightData light;
+    vec4 positionOffset; // compact vertex formats only
+    vec4 positionScale;
+    uint textureIndex;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+layout(set = 0, binding = 1) uniform sampler2D textures[];
+
+// frame slot * object count + object index
+layout(push_constant) uniform DrawIndex {
+    uint objectIndex;
+} draw;
+
+// the names the bound uniform blocks have in the shaders
+#define mvp objects[draw.objectIndex]
+#define light objects[draw.objectIndex].light
+#define decode objects[draw.objectIndex]
+#define texSampler textures[objects[draw.objectIndex].textureIndex]
@@ -0,0 +1,89 @@
+#version 450
+#extension GL_ARB_seperate_shader_objects : enable
+#ifdef BINDLESS
+#extension GL_GOOGLE_include_directive : require
+// the unsized texture array in bindless.glsl
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+// shader.vert for the compact vertex formats (see VertexFormat.h): positions are unorm16 within
+// the mesh bounds, normals and tangents octahedral snorm16, uvs half floats. Compiled once as is
+// for VertexFormat::Compact and once with -DVERTEX_COLOR for VertexFormat::CompactColor
+
+#ifdef BINDLESS
+#include "bindless.glsl"
+#else
+layout(set = 0, binding = 0) uniform MvpBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 norm;
+} mvp;
+
+layout(set = 0, binding = 2) uniform LightBufferObject {
+    vec4 globalAmbient;
+
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+
+    vec4 matAmbient;
+    vec4 matDiffuse;
+    vec4 matSpecular;
+    float matShininess;
+
+    vec3 position;
+} light;
+
+// the mesh bounds the positions were quantized to
+layout(push_constant) uniform VertexDecode {
+    vec4 positionOffset;
+    vec4 positionScale;
+} decode;
+#endif
+
+layout(location = 0) in vec4 vertPosition;
+#ifdef VERTEX_COLOR
+layout(location = 1) in vec4 vertColor;
+#endif
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec2 vertNormal;
+layout(location = 4) in vec2 vertTangent;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 varyingLightDir;  // vector pointing to the light
+layout(location = 3) out vec3 varyingVertPos;   // vertex position in eye space
+layout(location = 4) out vec3 varyingHalfVector;
+layout(location = 5) out vec3 varyingNormal;
+layout(location = 6) out vec3 lightPos;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 vector = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (vector.z < 0.0) {
+        vector.xy = (1.0 - abs(vector.yx)) * vec2(vector.x >= 0.0 ? 1.0 : -1.0, vector.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(vector);
+}
+
+void main() {
+    vec3 position = decode.positionOffset.xyz + vertPosition.xyz * decode.positionScale.xyz;
+    vec3 normal = decodeOctahedral(vertNormal);
+
+    mat4 mvMatrix = mvp.view * mvp.model;
+#ifdef VERTEX_COLOR
+    fragColor = vertColor.rgb;
+#else
+    fragColor = vec3(1.0);
+#endif
+    fragTexCoord = texCoord;
+    varyingVertPos = (mvMatrix * vec4(position, 1.0)).xyz;
+    
+    varyingLightDir = (mvMatrix * vec4(light.position, 1.0)).xyz - varyingVertPos;
+    varyingHalfVector = (varyingLightDir + (-varyingVertPos)).xyz;
+    varyingNormal = (mvp.norm * vec4(normal, 1.0)).xyz;
+    lightPos = light.position;
+
+    gl_Position = mvp.proj * mvMatrix * vec4(position, 1.0);
+
+}
@@ -1,6 +1,14 @@
 #version 450
 #extension GL_ARB_seperate_shader_objects : enable
-
+#ifdef BINDLESS
+#extension GL_GOOGLE_include_directive : require
+// the unsized texture array in bindless.glsl
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+#ifdef BINDLESS
+#include "bindless.glsl"
+#else
 layout(binding = 1) uniform sampler2D texSampler;
 layout(set = 0, binding = 2) uniform LightBufferObject {
     vec4 globalAmbient;
@@ -16,6 +24,7 @@ layout(set = 0, binding = 2) uniform LightBufferObject {
 
     vec3 position;
 } light;
+#endif
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -44,5 +53,6 @@ void main() {
     vec3 diffuse = (light.diffuse.xyz * light.matDiffuse.xyz * max(cosTheta, 0.0)) / lightToVertDistance;
     vec3 specular = light.specular.xyz * light.matSpecular.xyz * pow(max(cosPhi, 0.0), light.matShininess) / lightToVertDistance;
 
-    outColor =  vec4((ambient + diffuse + specular), 1.0) * texel;
+    // vertex colors are white unless tinted (see instanced.vert)
+    outColor =  vec4((ambient + diffuse + specular), 1.0) * texel * vec4(fragColor, 1.0);
 }
@@ -1,6 +1,14 @@
 #version 450
 #extension GL_ARB_seperate_shader_objects : enable
-
+#ifdef BINDLESS
+#extension GL_GOOGLE_include_directive : require
+// the unsized texture array in bindless.glsl
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+#ifdef BINDLESS
+#include "bindless.glsl"
+#else
 layout(set = 0, binding = 0) uniform MvpBufferObject {
     mat4 model;
     mat4 view;
@@ -22,6 +30,7 @@ layout(set = 0, binding = 2) uniform LightBufferObject {
 
     vec3 position;
 } light;
+#endif
 
 layout(location = 0) in vec3 vertPosition;
 layout(location = 1) in vec3 vertColor;
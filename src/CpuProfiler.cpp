@@ -0,0 +1,127 @@
+#include <CpuProfiler.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Skip {
+
+    namespace {
+
+        // written by its thread only, read by writeChromeTrace
+        struct ThreadBuffer {
+            uint32_t id;
+            std::string name;
+            std::unique_ptr<CpuProfiler::Event[]> events; // allocated on the first zone
+            std::atomic<uint64_t> written{ 0 };
+        };
+
+        // buffers outlive their threads so the zones of finished loading threads still get exported
+        std::mutex registryMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> registry;
+        thread_local ThreadBuffer* threadBuffer = nullptr;
+
+        // tick / steady_clock pair taken when capturing starts, to convert ticks to microseconds
+        uint64_t calibrationTicks = 0;
+        std::chrono::steady_clock::time_point calibrationTime;
+
+        ThreadBuffer* getThreadBuffer() {
+            if (threadBuffer == nullptr) {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                registry.push_back(std::make_unique<ThreadBuffer>());
+                threadBuffer = registry.back().get();
+                threadBuffer->id = static_cast<uint32_t>(registry.size());
+                threadBuffer->name = "thread " + std::to_string(threadBuffer->id);
+            }
+            return threadBuffer;
+        }
+
+        void writeJsonString(std::ostream& out, const std::string& text) {
+            out << '"';
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out << '\\' << c;
+                } else if (static_cast<unsigned char>(c) >= 0x20) {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+
+    }
+
+    std::atomic<bool> CpuProfiler::_enabled{ false };
+
+    void CpuProfiler::setEnabled(bool enabled) {
+        if (enabled && calibrationTicks == 0) {
+            calibrationTime = std::chrono::steady_clock::now();
+            calibrationTicks = now();
+        }
+        _enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void CpuProfiler::setThreadName(const std::string& name) {
+        ThreadBuffer* buffer = getThreadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->name = name;
+    }
+
+    void CpuProfiler::record(const char* name, uint64_t start, uint64_t end) {
+        ThreadBuffer* buffer = getThreadBuffer();
+        if (!buffer->events) {
+            buffer->events.reset(new Event[EVENTS_PER_THREAD]);
+        }
+        uint64_t index = buffer->written.load(std::memory_order_relaxed);
+        buffer->events[index % EVENTS_PER_THREAD] = Event{ name, start, end };
+        buffer->written.store(index + 1, std::memory_order_release);
+    }
+
+    bool CpuProfiler::writeChromeTrace(const std::string& path) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+
+        double ticksPerMicrosecond = 1.0;
+#ifdef SKIP_PROFILER_RDTSC
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - calibrationTime).count();
+        if (elapsed > 0.0) {
+            ticksPerMicrosecond = static_cast<double>(now() - calibrationTicks) / elapsed;
+        }
+#else
+        ticksPerMicrosecond = std::chrono::steady_clock::period::den / (1000000.0 * std::chrono::steady_clock::period::num);
+#endif
+        auto toMicroseconds = [ticksPerMicrosecond](uint64_t ticks) {
+            return static_cast<double>(static_cast<int64_t>(ticks - calibrationTicks)) / ticksPerMicrosecond;
+        };
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        file.setf(std::ios::fixed);
+        file.precision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"args\":{\"name\":";
+            writeJsonString(file, buffer->name);
+            file << "}}";
+            first = false;
+
+            uint64_t written = buffer->written.load(std::memory_order_acquire);
+            uint64_t oldest = written - std::min<uint64_t>(written, EVENTS_PER_THREAD);
+            for (uint64_t i = oldest; i < written; i++) {
+                const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+                file << ",\n{\"name\":";
+                writeJsonString(file, event.name);
+                file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                    << ",\"ts\":" << toMicroseconds(event.start)
+                    << ",\"dur\":" << std::max(0.0, toMicroseconds(event.end) - toMicroseconds(event.start)) << "}";
+            }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+
+}
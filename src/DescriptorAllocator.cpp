@@ -0,0 +1,149 @@
+#include <DescriptorAllocator.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Skip {
+
+    DescriptorAllocator::DescriptorAllocator(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizesPerSet,
+        uint32_t frameCount) {
+        _device = device;
+        _sizesPerSet = sizesPerSet;
+        _frames.resize(frameCount);
+    }
+
+    DescriptorAllocator::~DescriptorAllocator() {
+        this->destroyChain(_persistent);
+        for (PoolChain& chain : _frames) {
+            this->destroyChain(chain);
+        }
+    }
+
+    VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+        auto found = _freeSets.find(layout);
+        if (found != _freeSets.end() && !found->second.empty()) {
+            VkDescriptorSet set = found->second.back();
+            found->second.pop_back();
+            _freeSetCount--;
+            _persistent.setCount++;
+            return set;
+        }
+        return this->allocateFrom(_persistent, layout);
+    }
+
+    void DescriptorAllocator::free(VkDescriptorSetLayout layout, VkDescriptorSet set) {
+        if (set == VK_NULL_HANDLE) {
+            return;
+        }
+        _freeSets[layout].push_back(set);
+        _freeSetCount++;
+        _persistent.setCount--;
+    }
+
+    VkDescriptorSet DescriptorAllocator::allocateTransient(uint32_t frameIndex, VkDescriptorSetLayout layout) {
+        return this->allocateFrom(_frames.at(frameIndex), layout);
+    }
+
+    void DescriptorAllocator::resetFrame(uint32_t frameIndex) {
+        this->resetChain(_frames.at(frameIndex));
+    }
+
+    void DescriptorAllocator::setFrameCount(uint32_t frameCount) {
+        if (frameCount == _frames.size()) {
+            return;
+        }
+        for (PoolChain& chain : _frames) {
+            this->destroyChain(chain);
+        }
+        _frames.assign(frameCount, PoolChain());
+    }
+
+    void DescriptorAllocator::reset() {
+        this->resetChain(_persistent);
+        for (PoolChain& chain : _frames) {
+            this->resetChain(chain);
+        }
+        _freeSets.clear();
+        _freeSetCount = 0;
+    }
+
+    DescriptorAllocatorStats DescriptorAllocator::getStats() const {
+        DescriptorAllocatorStats stats;
+        stats.poolCount = static_cast<uint32_t>(_persistent.pools.size());
+        stats.setCount = _persistent.setCount;
+        stats.freeSetCount = _freeSetCount;
+        for (const PoolChain& chain : _frames) {
+            stats.poolCount += static_cast<uint32_t>(chain.pools.size());
+            stats.transientSetCount += chain.setCount;
+        }
+        return stats;
+    }
+
+    VkDescriptorSet DescriptorAllocator::allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout) {
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        for (; chain.current < chain.pools.size(); chain.current++) {
+            allocInfo.descriptorPool = chain.pools[chain.current];
+            VkResult result = vkAllocateDescriptorSets(_device, &allocInfo, &set);
+            if (result == VK_SUCCESS) {
+                chain.setCount++;
+                return set;
+            }
+            // anything but a full pool is a real error
+            if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+                throw std::runtime_error("Failed to allocate descriptor set!");
+            }
+        }
+
+        // every pool is full, chain.current now points at the new one
+        chain.pools.push_back(this->createPool(chain.nextSetCount));
+        chain.nextSetCount = std::min(chain.nextSetCount * 2, MAX_SETS_PER_POOL);
+        allocInfo.descriptorPool = chain.pools.back();
+        if (vkAllocateDescriptorSets(_device, &allocInfo, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate descriptor set from a new pool!");
+        }
+        chain.setCount++;
+        return set;
+    }
+
+    VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+        std::vector<VkDescriptorPoolSize> poolSizes = _sizesPerSet;
+        for (VkDescriptorPoolSize& poolSize : poolSizes) {
+            poolSize.descriptorCount *= setCount;
+        }
+
+        // sets are recycled or reset with the whole pool, never freed one by one
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = setCount;
+        poolInfo.flags = 0;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor pool!");
+        }
+        return pool;
+    }
+
+    void DescriptorAllocator::resetChain(PoolChain& chain) {
+        for (VkDescriptorPool pool : chain.pools) {
+            vkResetDescriptorPool(_device, pool, 0);
+        }
+        chain.current = 0;
+        chain.setCount = 0;
+    }
+
+    void DescriptorAllocator::destroyChain(PoolChain& chain) {
+        for (VkDescriptorPool pool : chain.pools) {
+            vkDestroyDescriptorPool(_device, pool, nullptr);
+        }
+        chain = PoolChain();
+    }
+
+}
@@ -0,0 +1,355 @@
+#include <DeviceAllocator.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Skip {
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    static VkDeviceSize nextPowerOfTwo(VkDeviceSize value) {
+        VkDeviceSize result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    static uint32_t exponentOf(VkDeviceSize powerOfTwo) {
+        uint32_t result = 0;
+        while (powerOfTwo > 1) {
+            powerOfTwo >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    DeviceAllocator::DeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice) {
+        _device = device;
+        _physicalDevice = physicalDevice;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        _bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+        _nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+        // buddy nodes are aligned to their size, so as long as the smallest node covers a whole
+        // granularity page buffers and images can never end up sharing one
+        _minBuddySize = nextPowerOfTwo(std::max(MIN_BUDDY_SIZE, _bufferImageGranularity));
+    }
+
+    DeviceAllocator::~DeviceAllocator() {
+        for (uint32_t i = 0; i < _blocks.size(); i++) {
+            if (_blocks[i]) {
+                this->destroyBlock(i);
+            }
+        }
+    }
+
+    MemoryAllocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+        MemoryPool pool) {
+
+        uint32_t memoryType = this->findMemoryType(requirements.memoryTypeBits, properties);
+        VkDeviceSize blockSize = this->blockSizeFor(memoryType, pool);
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        MemoryAllocation allocation{};
+        _totalAllocations++;
+
+        // Anything larger than half a block would waste most of it, give it its own memory
+        if (requirements.size > blockSize / 2) {
+            uint32_t blockIndex = this->createBlock(memoryType, pool, requirements.size, true);
+            MemoryBlock& block = *_blocks[blockIndex];
+            block.allocationCount = 1;
+            block.bytesUsed = requirements.size;
+
+            allocation.memory = block.memory;
+            allocation.offset = 0;
+            allocation.size = requirements.size;
+            allocation.mapped = block.mapped;
+            allocation.memoryType = memoryType;
+            allocation.blockIndex = blockIndex;
+            return allocation;
+        }
+
+        for (uint32_t i = 0; i < _blocks.size(); i++) {
+            if (!_blocks[i] || _blocks[i]->dedicated || _blocks[i]->memoryType != memoryType || _blocks[i]->pool != pool) {
+                continue;
+            }
+            bool allocated = pool == MemoryPool::Transient ?
+                this->allocateLinear(*_blocks[i], requirements.size, alignment, allocation) :
+                this->allocateBuddy(*_blocks[i], requirements.size, alignment, allocation);
+            if (allocated) {
+                allocation.blockIndex = i;
+                return allocation;
+            }
+        }
+
+        // every block of this kind is full
+        uint32_t blockIndex = this->createBlock(memoryType, pool, blockSize, false);
+        bool allocated = pool == MemoryPool::Transient ?
+            this->allocateLinear(*_blocks[blockIndex], requirements.size, alignment, allocation) :
+            this->allocateBuddy(*_blocks[blockIndex], requirements.size, alignment, allocation);
+        if (!allocated) {
+            throw std::runtime_error("Failed to sub-allocate from a fresh memory block!");
+        }
+        allocation.blockIndex = blockIndex;
+        return allocation;
+    }
+
+    void DeviceAllocator::free(MemoryAllocation& allocation) {
+        if (!allocation.isValid()) {
+            return;
+        }
+        MemoryBlock& block = *_blocks[allocation.blockIndex];
+        block.allocationCount--;
+        block.bytesUsed -= allocation.size;
+
+        if (block.dedicated) {
+            this->destroyBlock(allocation.blockIndex);
+        } else if (block.pool == MemoryPool::Transient) {
+            // linear blocks can only be reused once everything in them is gone
+            if (block.allocationCount == 0) {
+                block.head = 0;
+            }
+        } else {
+            this->freeBuddy(block, allocation.offset, allocation.order);
+        }
+        allocation = MemoryAllocation{};
+    }
+
+    MemoryAllocation DeviceAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryPool pool) {
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
+        MemoryAllocation allocation = this->allocate(memRequirements, properties, pool);
+        if (vkBindBufferMemory(_device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to bind buffer memory!");
+        }
+        return allocation;
+    }
+
+    MemoryAllocation DeviceAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags properties, MemoryPool pool) {
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(_device, image, &memRequirements);
+        MemoryAllocation allocation = this->allocate(memRequirements, properties, pool);
+        if (vkBindImageMemory(_device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to bind image memory!");
+        }
+        return allocation;
+    }
+
+    VkResult DeviceAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+        VkMappedMemoryRange range{};
+        VkResult result = this->mappedRange(allocation, offset, size, range);
+        if (result != VK_SUCCESS || range.memory == VK_NULL_HANDLE) {
+            return result;
+        }
+        return vkFlushMappedMemoryRanges(_device, 1, &range);
+    }
+
+    VkResult DeviceAllocator::invalidate(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+        VkMappedMemoryRange range{};
+        VkResult result = this->mappedRange(allocation, offset, size, range);
+        if (result != VK_SUCCESS || range.memory == VK_NULL_HANDLE) {
+            return result;
+        }
+        return vkInvalidateMappedMemoryRanges(_device, 1, &range);
+    }
+
+    VkResult DeviceAllocator::mappedRange(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size,
+        VkMappedMemoryRange& range) const {
+        // Leaves range.memory null when there is nothing to do (coherent memory)
+        if (!allocation.isValid() || allocation.mapped == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+        if (_memoryProperties.memoryTypes[allocation.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+            return VK_SUCCESS;
+        }
+        if (size == VK_WHOLE_SIZE) {
+            size = allocation.size - offset;
+        }
+        // ranges have to start and end on nonCoherentAtomSize, or end at the end of the memory
+        const MemoryBlock& block = *_blocks[allocation.blockIndex];
+        VkDeviceSize start = (allocation.offset + offset) / _nonCoherentAtomSize * _nonCoherentAtomSize;
+        VkDeviceSize end = std::min(alignUp(allocation.offset + offset + size, _nonCoherentAtomSize), block.size);
+
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = start;
+        range.size = end == block.size ? VK_WHOLE_SIZE : end - start;
+        return VK_SUCCESS;
+    }
+
+    AllocatorStats DeviceAllocator::getStats() const {
+        AllocatorStats stats{};
+        for (const auto& block : _blocks) {
+            if (!block) {
+                continue;
+            }
+            MemoryPoolStats& poolStats = block->dedicated ? stats.dedicated :
+                block->pool == MemoryPool::Transient ? stats.transient : stats.longLived;
+            poolStats.blockCount++;
+            poolStats.allocationCount += block->allocationCount;
+            poolStats.bytesReserved += block->size;
+            poolStats.bytesUsed += block->bytesUsed;
+        }
+        stats.deviceMemoryCount = _deviceMemoryCount;
+        stats.peakDeviceMemoryCount = _peakDeviceMemoryCount;
+        stats.totalAllocations = _totalAllocations;
+        return stats;
+    }
+
+    void DeviceAllocator::printStats(std::ostream& out) const {
+        AllocatorStats stats = this->getStats();
+        auto printPool = [&out](const char* name, const MemoryPoolStats& pool) {
+            out << "    " << name << ": " << pool.allocationCount << " allocations in " << pool.blockCount << " blocks, "
+                << pool.bytesUsed / 1024 << " / " << pool.bytesReserved / 1024 << " KiB used" << std::endl;
+        };
+        out << "Device memory: " << stats.deviceMemoryCount << " vkDeviceMemory objects (peak " << stats.peakDeviceMemoryCount
+            << ") for " << stats.totalAllocations << " allocations made" << std::endl;
+        printPool("long lived", stats.longLived);
+        printPool("transient", stats.transient);
+        printPool("dedicated", stats.dedicated);
+    }
+
+    uint32_t DeviceAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+        for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+        throw std::runtime_error("Failed to find suitable memory type!");
+    }
+
+    VkDeviceSize DeviceAllocator::blockSizeFor(uint32_t memoryType, MemoryPool pool) const {
+        // Small heaps (e.g. the 256MB host visible device local window) get smaller blocks
+        VkDeviceSize heapSize = _memoryProperties.memoryHeaps[_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        VkDeviceSize blockSize = pool == MemoryPool::Transient ? TRANSIENT_BLOCK_SIZE : LONG_LIVED_BLOCK_SIZE;
+        while (blockSize > heapSize / 8 && blockSize > _minBuddySize * 16) {
+            blockSize >>= 1;
+        }
+        return blockSize;
+    }
+
+    uint32_t DeviceAllocator::createBlock(uint32_t memoryType, MemoryPool pool, VkDeviceSize size, bool dedicated) {
+        auto block = std::make_unique<MemoryBlock>();
+        block->size = size;
+        block->memoryType = memoryType;
+        block->pool = pool;
+        block->dedicated = dedicated;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+        if (vkAllocateMemory(_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate device memory block!");
+        }
+        _deviceMemoryCount++;
+        _peakDeviceMemoryCount = std::max(_peakDeviceMemoryCount, _deviceMemoryCount);
+
+        // host visible memory is mapped once and stays mapped
+        if (_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to map device memory block!");
+            }
+        }
+
+        if (!dedicated && pool == MemoryPool::LongLived) {
+            // block sizes are powers of two so the whole block is one node of the highest order
+            block->maxOrder = exponentOf(size / _minBuddySize);
+            block->freeLists.resize(block->maxOrder + 1);
+            block->freeLists[block->maxOrder].insert(0);
+        }
+
+        for (uint32_t i = 0; i < _blocks.size(); i++) {
+            if (!_blocks[i]) {
+                _blocks[i] = std::move(block);
+                return i;
+            }
+        }
+        _blocks.push_back(std::move(block));
+        return static_cast<uint32_t>(_blocks.size() - 1);
+    }
+
+    void DeviceAllocator::destroyBlock(uint32_t blockIndex) {
+        MemoryBlock& block = *_blocks[blockIndex];
+        if (block.mapped != nullptr) {
+            vkUnmapMemory(_device, block.memory);
+        }
+        vkFreeMemory(_device, block.memory, nullptr);
+        _deviceMemoryCount--;
+        _blocks[blockIndex].reset();
+    }
+
+    bool DeviceAllocator::allocateLinear(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+        // Every allocation starts on its own granularity page, so no buffer/image aliasing concerns
+        VkDeviceSize offset = alignUp(alignUp(block.head, alignment), _bufferImageGranularity);
+        if (offset + size > block.size) {
+            return false;
+        }
+        block.head = offset + size;
+        block.allocationCount++;
+        block.bytesUsed += size;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + offset : nullptr;
+        allocation.memoryType = block.memoryType;
+        return true;
+    }
+
+    bool DeviceAllocator::allocateBuddy(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+        // Nodes are aligned to their own size, a node at least as large as the alignment satisfies it
+        VkDeviceSize nodeSize = nextPowerOfTwo(std::max({ size, alignment, _minBuddySize }));
+        uint32_t order = exponentOf(nodeSize / _minBuddySize);
+        if (order > block.maxOrder) {
+            return false;
+        }
+
+        uint32_t freeOrder = order;
+        while (freeOrder <= block.maxOrder && block.freeLists[freeOrder].empty()) {
+            freeOrder++;
+        }
+        if (freeOrder > block.maxOrder) {
+            return false;
+        }
+
+        // take the lowest free node and split it down, keeping the upper halves free
+        VkDeviceSize offset = *block.freeLists[freeOrder].begin();
+        block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+        while (freeOrder > order) {
+            freeOrder--;
+            block.freeLists[freeOrder].insert(offset + (_minBuddySize << freeOrder));
+        }
+
+        block.allocationCount++;
+        block.bytesUsed += nodeSize;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = nodeSize;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + offset : nullptr;
+        allocation.memoryType = block.memoryType;
+        allocation.order = order;
+        return true;
+    }
+
+    void DeviceAllocator::freeBuddy(MemoryBlock& block, VkDeviceSize offset, uint32_t order) {
+        // merge with the buddy for as long as it is free as well
+        while (order < block.maxOrder) {
+            VkDeviceSize buddy = offset ^ (_minBuddySize << order);
+            auto it = block.freeLists[order].find(buddy);
+            if (it == block.freeLists[order].end()) {
+                break;
+            }
+            block.freeLists[order].erase(it);
+            offset = std::min(offset, buddy);
+            order++;
+        }
+        block.freeLists[order].insert(offset);
+    }
+
+}
@@ -0,0 +1,453 @@
+#include <DynamicBvh.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace Skip {
+
+    float Aabb::getSurfaceArea() const {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    bool Aabb::contains(const Aabb& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+            && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    bool Aabb::overlaps(const Aabb& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x
+            && min.y <= other.max.y && max.y >= other.min.y
+            && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    float Aabb::intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) const {
+        // slab test, a zero direction component gives infinities which compare correctly
+        glm::vec3 t1 = (min - origin) * inverseDirection;
+        glm::vec3 t2 = (max - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t1, t2);
+        glm::vec3 tFar = glm::max(t1, t2);
+        float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return entry <= exit ? entry : -1.0f;
+    }
+
+    Aabb Aabb::merge(const Aabb& a, const Aabb& b) {
+        return Aabb{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+
+    DynamicBvh::DynamicBvh(float margin) {
+        _margin = margin;
+    }
+
+    int32_t DynamicBvh::insert(const Aabb& box, void* userData) {
+        int32_t proxy = this->allocateNode();
+        _nodes[proxy].box = Aabb{ box.min - glm::vec3(_margin), box.max + glm::vec3(_margin) };
+        _nodes[proxy].userData = userData;
+        _nodes[proxy].height = 0;
+        this->insertLeaf(proxy);
+        _proxyCount++;
+        return proxy;
+    }
+
+    void DynamicBvh::remove(int32_t proxy) {
+        this->removeLeaf(proxy);
+        this->freeNode(proxy);
+        _proxyCount--;
+    }
+
+    bool DynamicBvh::move(int32_t proxy, const Aabb& box) {
+        if (_nodes[proxy].box.contains(box)) {
+            return false;
+        }
+        this->removeLeaf(proxy);
+        _nodes[proxy].box = Aabb{ box.min - glm::vec3(_margin), box.max + glm::vec3(_margin) };
+        this->insertLeaf(proxy);
+        return true;
+    }
+
+    void DynamicBvh::queryAabb(const Aabb& box, const std::function<void(int32_t)>& visit) const {
+        std::vector<int32_t> stack;
+        if (_root != NULL_NODE) {
+            stack.push_back(_root);
+        }
+        while (!stack.empty()) {
+            const Node& node = _nodes[stack.back()];
+            int32_t index = stack.back();
+            stack.pop_back();
+            if (!node.box.overlaps(box)) {
+                continue;
+            }
+            if (node.isLeaf()) {
+                visit(index);
+            } else {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+
+    void DynamicBvh::queryFrustum(const Frustum& frustum, const std::function<void(int32_t, bool)>& visit) const {
+        std::vector<int32_t> stack;
+        std::vector<int32_t> insideStack;
+        if (_root != NULL_NODE) {
+            stack.push_back(_root);
+        }
+        while (!stack.empty()) {
+            int32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = _nodes[index];
+
+            FrustumTest test = frustum.classifyAabb(node.box.min, node.box.max);
+            if (test == FrustumTest::Outside) {
+                continue;
+            }
+            if (test == FrustumTest::Intersects) {
+                if (node.isLeaf()) {
+                    visit(index, false);
+                } else {
+                    stack.push_back(node.left);
+                    stack.push_back(node.right);
+                }
+                continue;
+            }
+
+            // everything below is visible, just collect the leaves
+            insideStack.push_back(index);
+            while (!insideStack.empty()) {
+                const Node& inside = _nodes[insideStack.back()];
+                int32_t insideIndex = insideStack.back();
+                insideStack.pop_back();
+                if (inside.isLeaf()) {
+                    visit(insideIndex, true);
+                } else {
+                    insideStack.push_back(inside.left);
+                    insideStack.push_back(inside.right);
+                }
+            }
+        }
+    }
+
+    int32_t DynamicBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        const std::function<float(int32_t)>& hitTest, float& hitDistance) const {
+        glm::vec3 inverseDirection = 1.0f / direction;
+        int32_t closest = NULL_NODE;
+        hitDistance = maxDistance;
+
+        std::vector<int32_t> stack;
+        if (_root != NULL_NODE) {
+            stack.push_back(_root);
+        }
+        while (!stack.empty()) {
+            int32_t index = stack.back();
+            stack.pop_back();
+            const Node& node = _nodes[index];
+            // anything entered beyond the closest hit so far cannot win
+            float entry = node.box.intersectRay(origin, inverseDirection, hitDistance);
+            if (entry < 0.0f) {
+                continue;
+            }
+            if (node.isLeaf()) {
+                float distance = hitTest ? hitTest(index) : entry;
+                if (distance >= 0.0f && distance <= hitDistance) {
+                    hitDistance = distance;
+                    closest = index;
+                }
+            } else {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+        return closest;
+    }
+
+    double DynamicBvh::sumInternalArea() const {
+        double area = 0.0;
+        for (const Node& node : _nodes) {
+            if (node.height > 0) {
+                area += node.box.getSurfaceArea();
+            }
+        }
+        return area;
+    }
+
+    bool DynamicBvh::isDegraded() const {
+        if (_proxyCount < 3) {
+            return false;
+        }
+        return this->getInternalArea() > _rebuiltArea * DEGRADED_AREA_RATIO;
+    }
+
+    void DynamicBvh::rebuild() {
+        // keep the leaves (their indices are the proxy ids), drop every internal node
+        std::vector<int32_t> leaves;
+        leaves.reserve(_proxyCount);
+        for (int32_t i = 0; i < static_cast<int32_t>(_nodes.size()); i++) {
+            if (_nodes[i].height < 0) {
+                continue;
+            }
+            if (_nodes[i].isLeaf()) {
+                leaves.push_back(i);
+            } else {
+                this->freeNode(i);
+            }
+        }
+
+        _root = leaves.empty() ? NULL_NODE : this->buildTopDown(leaves, 0, leaves.size());
+        if (_root != NULL_NODE) {
+            _nodes[_root].parent = NULL_NODE;
+        }
+        // the running sum drifts a little with every update, a rebuild starts it over
+        _internalArea = this->sumInternalArea();
+        _rebuiltArea = this->getInternalArea();
+    }
+
+    int32_t DynamicBvh::buildTopDown(std::vector<int32_t>& leaves, size_t begin, size_t end) {
+        if (end - begin == 1) {
+            return leaves[begin];
+        }
+
+        // median split along the widest spread of the box centers
+        Aabb centers{ _nodes[leaves[begin]].box.getCenter(), _nodes[leaves[begin]].box.getCenter() };
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 center = _nodes[leaves[i]].box.getCenter();
+            centers.min = glm::min(centers.min, center);
+            centers.max = glm::max(centers.max, center);
+        }
+        glm::vec3 extent = centers.max - centers.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(leaves.begin() + begin, leaves.begin() + middle, leaves.begin() + end,
+            [this, axis](int32_t a, int32_t b) {
+                return _nodes[a].box.getCenter()[axis] < _nodes[b].box.getCenter()[axis];
+            });
+
+        int32_t left = this->buildTopDown(leaves, begin, middle);
+        int32_t right = this->buildTopDown(leaves, middle, end);
+
+        int32_t parent = this->allocateNode();
+        _nodes[parent].left = left;
+        _nodes[parent].right = right;
+        _nodes[parent].height = 1 + std::max(_nodes[left].height, _nodes[right].height);
+        this->setInternalBox(parent, Aabb::merge(_nodes[left].box, _nodes[right].box));
+        _nodes[left].parent = parent;
+        _nodes[right].parent = parent;
+        return parent;
+    }
+
+    int32_t DynamicBvh::allocateNode() {
+        if (_freeList == NULL_NODE) {
+            _nodes.emplace_back();
+            return static_cast<int32_t>(_nodes.size() - 1);
+        }
+        int32_t index = _freeList;
+        _freeList = _nodes[index].next;
+        _nodes[index] = Node{};
+        return index;
+    }
+
+    void DynamicBvh::freeNode(int32_t index) {
+        if (_nodes[index].height > 0) {
+            _internalArea -= _nodes[index].box.getSurfaceArea();
+        }
+        _nodes[index] = Node{};
+        _nodes[index].next = _freeList;
+        _freeList = index;
+    }
+
+    void DynamicBvh::setInternalBox(int32_t index, const Aabb& box) {
+        _internalArea += box.getSurfaceArea() - _nodes[index].box.getSurfaceArea();
+        _nodes[index].box = box;
+    }
+
+    void DynamicBvh::insertLeaf(int32_t leaf) {
+        if (_root == NULL_NODE) {
+            _root = leaf;
+            _nodes[leaf].parent = NULL_NODE;
+            _rebuiltArea = 0.0f;
+            return;
+        }
+
+        // Walk down towards the sibling where adding the leaf grows the tree's area the least
+        Aabb leafBox = _nodes[leaf].box;
+        int32_t index = _root;
+        while (!_nodes[index].isLeaf()) {
+            const Node& node = _nodes[index];
+            float area = node.box.getSurfaceArea();
+            float combinedArea = Aabb::merge(node.box, leafBox).getSurfaceArea();
+
+            // pairing with this node creates a parent of combinedArea, going further down
+            // grows every ancestor on the way by the same amount
+            float cost = 2.0f * combinedArea;
+            float inheritedCost = 2.0f * (combinedArea - area);
+
+            auto childCost = [this, &leafBox, inheritedCost](int32_t child) {
+                float merged = Aabb::merge(_nodes[child].box, leafBox).getSurfaceArea();
+                if (_nodes[child].isLeaf()) {
+                    return merged + inheritedCost;
+                }
+                return merged - _nodes[child].box.getSurfaceArea() + inheritedCost;
+            };
+            float leftCost = childCost(node.left);
+            float rightCost = childCost(node.right);
+
+            if (cost < leftCost && cost < rightCost) {
+                break;
+            }
+            index = leftCost < rightCost ? node.left : node.right;
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = _nodes[sibling].parent;
+        int32_t newParent = this->allocateNode();
+        _nodes[newParent].parent = oldParent;
+        _nodes[newParent].height = _nodes[sibling].height + 1;
+        this->setInternalBox(newParent, Aabb::merge(leafBox, _nodes[sibling].box));
+        _nodes[newParent].left = sibling;
+        _nodes[newParent].right = leaf;
+        _nodes[sibling].parent = newParent;
+        _nodes[leaf].parent = newParent;
+
+        if (oldParent == NULL_NODE) {
+            _root = newParent;
+        } else if (_nodes[oldParent].left == sibling) {
+            _nodes[oldParent].left = newParent;
+        } else {
+            _nodes[oldParent].right = newParent;
+        }
+
+        this->refitUpwards(newParent);
+    }
+
+    void DynamicBvh::removeLeaf(int32_t leaf) {
+        if (leaf == _root) {
+            _root = NULL_NODE;
+            return;
+        }
+
+        int32_t parent = _nodes[leaf].parent;
+        int32_t grandParent = _nodes[parent].parent;
+        int32_t sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+
+        // the sibling takes the parent's place
+        _nodes[sibling].parent = grandParent;
+        this->freeNode(parent);
+        if (grandParent == NULL_NODE) {
+            _root = sibling;
+            return;
+        }
+        if (_nodes[grandParent].left == parent) {
+            _nodes[grandParent].left = sibling;
+        } else {
+            _nodes[grandParent].right = sibling;
+        }
+        this->refitUpwards(grandParent);
+    }
+
+    void DynamicBvh::refitUpwards(int32_t index) {
+        while (index != NULL_NODE) {
+            index = this->balance(index);
+
+            Node& node = _nodes[index];
+            node.height = 1 + std::max(_nodes[node.left].height, _nodes[node.right].height);
+            this->setInternalBox(index, Aabb::merge(_nodes[node.left].box, _nodes[node.right].box));
+            index = node.parent;
+        }
+    }
+
+    int32_t DynamicBvh::balance(int32_t indexA) {
+        // Rotates the taller child up when the subtrees of A differ in height by more
+        // than one. A has children B and C, C has children F and G (mirrored for B).
+        // Returns the index of the node now at A's position
+        Node& a = _nodes[indexA];
+        if (a.isLeaf() || a.height < 2) {
+            return indexA;
+        }
+        int32_t indexB = a.left;
+        int32_t indexC = a.right;
+        Node& b = _nodes[indexB];
+        Node& c = _nodes[indexC];
+        int32_t heightDifference = c.height - b.height;
+
+        if (heightDifference > 1) {
+            // C goes up
+            int32_t indexF = c.left;
+            int32_t indexG = c.right;
+            Node& f = _nodes[indexF];
+            Node& g = _nodes[indexG];
+
+            c.left = indexA;
+            c.parent = a.parent;
+            a.parent = indexC;
+            if (c.parent == NULL_NODE) {
+                _root = indexC;
+            } else if (_nodes[c.parent].left == indexA) {
+                _nodes[c.parent].left = indexC;
+            } else {
+                _nodes[c.parent].right = indexC;
+            }
+
+            // the taller of F and G stays with C
+            if (f.height > g.height) {
+                c.right = indexF;
+                a.right = indexG;
+                g.parent = indexA;
+                this->setInternalBox(indexA, Aabb::merge(b.box, g.box));
+                this->setInternalBox(indexC, Aabb::merge(a.box, f.box));
+                a.height = 1 + std::max(b.height, g.height);
+                c.height = 1 + std::max(a.height, f.height);
+            } else {
+                c.right = indexG;
+                a.right = indexF;
+                f.parent = indexA;
+                this->setInternalBox(indexA, Aabb::merge(b.box, f.box));
+                this->setInternalBox(indexC, Aabb::merge(a.box, g.box));
+                a.height = 1 + std::max(b.height, f.height);
+                c.height = 1 + std::max(a.height, g.height);
+            }
+            return indexC;
+        }
+
+        if (heightDifference < -1) {
+            // B goes up, mirrored
+            int32_t indexD = b.left;
+            int32_t indexE = b.right;
+            Node& d = _nodes[indexD];
+            Node& e = _nodes[indexE];
+
+            b.left = indexA;
+            b.parent = a.parent;
+            a.parent = indexB;
+            if (b.parent == NULL_NODE) {
+                _root = indexB;
+            } else if (_nodes[b.parent].left == indexA) {
+                _nodes[b.parent].left = indexB;
+            } else {
+                _nodes[b.parent].right = indexB;
+            }
+
+            if (d.height > e.height) {
+                b.right = indexD;
+                a.left = indexE;
+                e.parent = indexA;
+                this->setInternalBox(indexA, Aabb::merge(c.box, e.box));
+                this->setInternalBox(indexB, Aabb::merge(a.box, d.box));
+                a.height = 1 + std::max(c.height, e.height);
+                b.height = 1 + std::max(a.height, d.height);
+            } else {
+                b.right = indexE;
+                a.left = indexD;
+                d.parent = indexA;
+                this->setInternalBox(indexA, Aabb::merge(c.box, d.box));
+                this->setInternalBox(indexB, Aabb::merge(a.box, e.box));
+                a.height = 1 + std::max(c.height, d.height);
+                b.height = 1 + std::max(a.height, e.height);
+            }
+            return indexB;
+        }
+
+        return indexA;
+    }
+
+}
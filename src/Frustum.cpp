@@ -0,0 +1,104 @@
+#include <Frustum.h>
+
+#ifdef SKIP_FRUSTUM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Skip {
+
+    void Frustum::update(const glm::mat4& viewProjection) {
+        // Gribb/Hartmann, planes are sums of the matrix rows (glm is column major)
+        glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        planes[0] = row3 + row0; // left
+        planes[1] = row3 - row0; // right
+        planes[2] = row3 + row1; // bottom (top with a flipped y, the pair is the same)
+        planes[3] = row3 - row1;
+        planes[4] = row2;        // near, depth starts at 0 rather than -w
+        planes[5] = row3 - row2; // far
+
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Frustum::intersectsAabb(const glm::vec3& min, const glm::vec3& max) const {
+        // only the corner furthest along the plane normal has to be checked
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 corner(
+                plane.x >= 0.0f ? max.x : min.x,
+                plane.y >= 0.0f ? max.y : min.y,
+                plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FrustumTest Frustum::classifyAabb(const glm::vec3& min, const glm::vec3& max) const {
+        FrustumTest result = FrustumTest::Inside;
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 normal = glm::vec3(plane);
+            glm::vec3 furthest(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+            glm::vec3 nearest(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z);
+            if (glm::dot(normal, furthest) + plane.w < 0.0f) {
+                return FrustumTest::Outside;
+            }
+            if (glm::dot(normal, nearest) + plane.w < 0.0f) {
+                result = FrustumTest::Intersects;
+            }
+        }
+        return result;
+    }
+
+    uint32_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+        uint32_t count, uint8_t* visible) {
+        uint32_t visibleCount = 0;
+        uint32_t i = 0;
+
+#ifdef SKIP_FRUSTUM_SSE
+        // four spheres against one plane per step
+        for (; i + 4 <= count; i += 4) {
+            __m128 sx = _mm_loadu_ps(x + i);
+            __m128 sy = _mm_loadu_ps(y + i);
+            __m128 sz = _mm_loadu_ps(z + i);
+            __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const glm::vec4& plane : frustum.planes) {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(sx, _mm_set1_ps(plane.x)), _mm_mul_ps(sy, _mm_set1_ps(plane.y))),
+                    _mm_add_ps(_mm_mul_ps(sz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                uint8_t laneVisible = (mask >> lane) & 1;
+                visible[i + lane] = laneVisible;
+                visibleCount += laneVisible;
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            visible[i] = frustum.intersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+            visibleCount += visible[i];
+        }
+        return visibleCount;
+    }
+
+}
@@ -0,0 +1,181 @@
+#include <GeometryBuffer.h>
+#include <ImguiContext.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Skip {
+
+    GeometryBuffer::GeometryBuffer(DeviceAllocator* allocator, UploadManager* uploads, VkDeviceSize vertexStride,
+        uint32_t vertexCapacity, uint32_t indexCapacity) {
+        _allocator = allocator;
+        _device = allocator->getDevice();
+        _uploads = uploads;
+
+        // TRANSFER_SRC so the contents can be carried over when an arena grows
+        _vertices.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        _vertices.stride = vertexStride;
+        this->createArena(_vertices, std::max<uint32_t>(vertexCapacity, 1));
+        this->freeRange(_vertices, 0, _vertices.capacity);
+
+        _indices.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        _indices.stride = sizeof(uint32_t);
+        this->createArena(_indices, std::max<uint32_t>(indexCapacity, 1));
+        this->freeRange(_indices, 0, _indices.capacity);
+    }
+
+    GeometryBuffer::~GeometryBuffer() {
+        vkDestroyBuffer(_device, _vertices.buffer, nullptr);
+        _allocator->free(_vertices.memory);
+        vkDestroyBuffer(_device, _indices.buffer, nullptr);
+        _allocator->free(_indices.memory);
+    }
+
+    GeometryRange GeometryBuffer::add(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+        GeometryRange range{};
+        if (vertexCount == 0) {
+            return range;
+        }
+        range.vertexCount = vertexCount;
+        range.vertexOffset = static_cast<int32_t>(this->allocateRange(_vertices, vertexCount));
+        if (indices != nullptr && indexCount > 0) {
+            range.indexCount = indexCount;
+            range.firstIndex = this->allocateRange(_indices, indexCount);
+        }
+
+        _uploads->uploadBuffer(_vertices.buffer, range.vertexOffset * _vertices.stride, vertices, vertexCount * _vertices.stride,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        if (range.indexCount > 0) {
+            _uploads->uploadBuffer(_indices.buffer, range.firstIndex * _indices.stride, indices, range.indexCount * _indices.stride,
+                VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        }
+
+        _vertexCount += range.vertexCount;
+        _indexCount += range.indexCount;
+        return range;
+    }
+
+    void GeometryBuffer::remove(GeometryRange& range) {
+        // The caller makes sure no frame in flight still draws the range
+        this->freeRange(_vertices, static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+        this->freeRange(_indices, range.firstIndex, range.indexCount);
+        _vertexCount -= range.vertexCount;
+        _indexCount -= range.indexCount;
+        range = GeometryRange{};
+    }
+
+    void GeometryBuffer::reserve(uint32_t vertexCapacity, uint32_t indexCapacity) {
+        if (vertexCapacity > _vertices.capacity) {
+            this->grow(_vertices, vertexCapacity);
+        }
+        if (indexCapacity > _indices.capacity) {
+            this->grow(_indices, indexCapacity);
+        }
+    }
+
+    void GeometryBuffer::bind(VkCommandBuffer commandBuffer) const {
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_vertices.buffer, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, _indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    void GeometryBuffer::createArena(Arena& arena, uint32_t capacity) {
+        createBuffer(_allocator, capacity * arena.stride, arena.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            arena.buffer, arena.memory);
+        arena.capacity = capacity;
+    }
+
+    void GeometryBuffer::grow(Arena& arena, uint32_t capacity) {
+        VkBuffer oldBuffer = arena.buffer;
+        MemoryAllocation oldMemory = arena.memory;
+        uint32_t oldCapacity = arena.capacity;
+
+        this->createArena(arena, capacity);
+
+        // The copy goes into the current upload batch on the transfer queue, behind every upload into
+        // the old buffer. Graphics only read the old buffer since it was released, which leaves its
+        // contents as the transfer queue wrote them
+        VkCommandBuffer commandBuffer = _uploads->getCommandBuffer();
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = oldCapacity * arena.stride;
+        vkCmdCopyBuffer(commandBuffer, oldBuffer, arena.buffer, 1, &copyRegion);
+
+        // later uploads may land in the free gaps the copy just wrote
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+        bool vertices = (arena.usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) != 0;
+        _uploads->releaseBuffer(arena.buffer, 0, copyRegion.size,
+            vertices ? VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT : VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+        if (_retireBuffer) {
+            _retireBuffer(oldBuffer, oldMemory);
+        } else {
+            _uploads->wait(_uploads->flush());
+            vkDestroyBuffer(_device, oldBuffer, nullptr);
+            _allocator->free(oldMemory);
+        }
+
+        this->freeRange(arena, oldCapacity, capacity - oldCapacity);
+        _version++;
+    }
+
+    uint32_t GeometryBuffer::allocateRange(Arena& arena, uint32_t count) {
+        // smallest free range that fits, the rest of it stays free
+        auto fit = arena.freeBySize.lower_bound(std::make_pair(count, 0u));
+        if (fit == arena.freeBySize.end()) {
+            // nothing fits, double the arena (or more for huge meshes). The new space is one range
+            // at the end, merged with any free range before it
+            this->grow(arena, std::max(arena.capacity * 2, arena.capacity + count));
+            fit = arena.freeBySize.lower_bound(std::make_pair(count, 0u));
+        }
+        uint32_t offset = fit->second;
+        uint32_t remaining = fit->first - count;
+        this->eraseFree(arena, arena.freeRanges.find(offset));
+        if (remaining > 0) {
+            this->insertFree(arena, offset + count, remaining);
+        }
+        return offset;
+    }
+
+    void GeometryBuffer::freeRange(Arena& arena, uint32_t offset, uint32_t count) {
+        if (count == 0) {
+            return;
+        }
+        // merge with the following range
+        auto next = arena.freeRanges.lower_bound(offset);
+        if (next != arena.freeRanges.end() && offset + count == next->first) {
+            count += next->second;
+            this->eraseFree(arena, next);
+        }
+        // and with the preceding one
+        auto prev = arena.freeRanges.lower_bound(offset);
+        if (prev != arena.freeRanges.begin()) {
+            --prev;
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                count += prev->second;
+                this->eraseFree(arena, prev);
+            }
+        }
+        this->insertFree(arena, offset, count);
+    }
+
+    void GeometryBuffer::insertFree(Arena& arena, uint32_t offset, uint32_t count) {
+        arena.freeRanges.emplace(offset, count);
+        arena.freeBySize.emplace(count, offset);
+    }
+
+    void GeometryBuffer::eraseFree(Arena& arena, std::map<uint32_t, uint32_t>::iterator range) {
+        arena.freeBySize.erase(std::make_pair(range->second, range->first));
+        arena.freeRanges.erase(range);
+    }
+
+}
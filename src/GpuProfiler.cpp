@@ -0,0 +1,108 @@
+#include <GpuProfiler.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Skip {
+
+    GpuProfiler::GpuProfiler(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t frameCount) {
+        _device = device;
+        _timestampPeriod = timestampPeriod;
+        _timestampMask = timestampValidBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+        _pending.assign(frameCount, false);
+        if (timestampValidBits == 0 || timestampPeriod <= 0.0f) {
+            return;
+        }
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = frameCount * MAX_SCOPES * 2;
+        if (vkCreateQueryPool(_device, &queryPoolInfo, nullptr, &_queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool!");
+        }
+    }
+
+    GpuProfiler::~GpuProfiler() {
+        if (_queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(_device, _queryPool, nullptr);
+        }
+    }
+
+    uint32_t GpuProfiler::addScope(const std::string& name) {
+        if (_scopes.size() >= MAX_SCOPES) {
+            throw std::runtime_error("Too many GPU profiler scopes!");
+        }
+        _scopes.emplace_back();
+        _scopes.back().name = name;
+        return static_cast<uint32_t>(_scopes.size() - 1);
+    }
+
+    void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        if (!this->isSupported()) {
+            return;
+        }
+        // scopes left unwritten this frame stay unavailable and are skipped by collect
+        vkCmdResetQueryPool(commandBuffer, _queryPool, this->getQuery(frameIndex, 0), MAX_SCOPES * 2);
+        _pending[frameIndex] = true;
+    }
+
+    void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t scope) {
+        if (this->isSupported()) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _queryPool, this->getQuery(frameIndex, scope));
+        }
+    }
+
+    void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t scope) {
+        if (this->isSupported()) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _queryPool, this->getQuery(frameIndex, scope) + 1);
+        }
+    }
+
+    void GpuProfiler::collect(uint32_t frameIndex) {
+        if (!this->isSupported() || !_pending[frameIndex]) {
+            return;
+        }
+        _pending[frameIndex] = false;
+
+        // value and availability per query, no WAIT_BIT so unwritten queries do not block
+        uint32_t queryCount = static_cast<uint32_t>(_scopes.size()) * 2;
+        std::array<uint64_t, MAX_SCOPES * 2 * 2> results{};
+        VkResult result = vkGetQueryPoolResults(_device, _queryPool, this->getQuery(frameIndex, 0), queryCount,
+            sizeof(uint64_t) * 2 * queryCount, results.data(), sizeof(uint64_t) * 2,
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY) {
+            return;
+        }
+        for (size_t i = 0; i < _scopes.size(); i++) {
+            const uint64_t* begin = &results[i * 4];
+            const uint64_t* end = &results[i * 4 + 2];
+            if (begin[1] == 0 || end[1] == 0) {
+                continue;
+            }
+            // masked difference, a counter that wrapped between the two still gives the right delta
+            uint64_t ticks = (end[0] - begin[0]) & _timestampMask;
+            Scope& scope = _scopes[i];
+            scope.last = static_cast<float>(ticks * _timestampPeriod / 1000000.0);
+            scope.history[scope.head] = scope.last;
+            scope.head = (scope.head + 1) % HISTORY_SIZE;
+            scope.samples = std::min(scope.samples + 1, HISTORY_SIZE);
+        }
+    }
+
+    float GpuProfiler::getPercentile(uint32_t scope, float p) const {
+        const Scope& stats = _scopes[scope];
+        if (stats.samples == 0) {
+            return 0.0f;
+        }
+        // with fewer samples than the history holds, they are the ones before head
+        std::vector<float> sorted(stats.samples);
+        for (uint32_t i = 0; i < stats.samples; i++) {
+            sorted[i] = stats.history[(stats.head + HISTORY_SIZE - 1 - i) % HISTORY_SIZE];
+        }
+        size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index];
+    }
+
+}
@@ -1,22 +1,25 @@
 #include <ImguiContext.h>
+#include <PipelineCache.h>
+
+#include <algorithm>
+#include <cfloat>
 
 namespace Skip {
 
 
+    // Buffer memory is persistently mapped by the allocator, mapping only hands out the pointer
     void Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        if (vkMapMemory(device, memory, offset, size, 0, &mapped) != VK_SUCCESS) {
+        if (memory.mapped == nullptr) {
             throw std::runtime_error("Failed to map Skip::buffer");
         }
+        mapped = static_cast<char*>(memory.mapped) + offset;
     }
     void Buffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(device, memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     };
 
     VkResult Buffer::bind(VkDeviceSize offset) {
-        return vkBindBufferMemory(device, buffer, memory, offset);
+        return vkBindBufferMemory(device, buffer, memory.memory, memory.offset + offset);
     }
 
     void Buffer::setupDescriptor(VkDeviceSize size, VkDeviceSize offset) {
@@ -30,30 +33,22 @@ namespace Skip {
     }
 
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
+        return allocator->flush(memory, offset, size);
     }
     
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
+        return allocator->invalidate(memory, offset, size);
     }
 
     void Buffer::destroy() {
         if (buffer) {
             vkDestroyBuffer(device, buffer, nullptr);
+            buffer = VK_NULL_HANDLE;
         }
-        if (memory) {
-            vkFreeMemory(device, memory, nullptr);
+        if (allocator) {
+            allocator->free(memory);
         }
+        mapped = nullptr;
     }
 
     // IMGUI Class
@@ -69,12 +64,11 @@ namespace Skip {
     void ImguiContext::DestroyImguiContext(VkDevice device) {
         ImGui::DestroyContext();
 
-        vertexBuffer.destroy();
-        indexBuffer.destroy();
+        setFrameCount(0);
 
         vkDestroyImage(device, fontImage, nullptr);
         vkDestroyImageView(device, fontView, nullptr);
-        vkFreeMemory(device, fontMemory, nullptr);
+        allocator->free(fontMemory);
         vkDestroySampler(device, sampler, nullptr);
         vkDestroyPipelineCache(device, pipelineCache, nullptr);
         vkDestroyPipeline(device, pipeline, nullptr);
@@ -97,8 +91,9 @@ namespace Skip {
         io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
     }
 
-    void ImguiContext::initResources(VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass, 
-        VkQueue copyQueue, VkCommandPool commandPool, const std::string& shadersPath, VkSampleCountFlagBits msaaSamples) {
+    void ImguiContext::initResources(VkDevice device, DeviceAllocator* allocator, VkRenderPass renderPass, 
+        VkQueue copyQueue, VkCommandPool commandPool, const std::string& shadersPath, VkSampleCountFlagBits msaaSamples,
+        const std::vector<uint8_t>& pipelineCacheData) {
         ImGuiIO& io = ImGui::GetIO();
 
         // Create font texture
@@ -125,16 +120,8 @@ namespace Skip {
         if (vkCreateImage(device, &imageInfo, nullptr, &fontImage) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create font image!");
         }
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device, fontImage, &memRequirements);
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &fontMemory) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate image memory");
-        }
-        vkBindImageMemory(device, fontImage, fontMemory, 0);
+        this->allocator = allocator;
+        fontMemory = allocator->allocateImage(fontImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         // Image view
         VkImageViewCreateInfo viewInfo{};
@@ -153,8 +140,8 @@ namespace Skip {
 
         Buffer stagingBuffer;
 
-        createBuffer(device, physicalDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &stagingBuffer, uploadSize);
+        createBuffer(allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &stagingBuffer, uploadSize, nullptr, MemoryPool::Transient);
 
         stagingBuffer.map();
         memcpy(stagingBuffer.mapped, fontData, uploadSize);
@@ -274,12 +261,8 @@ namespace Skip {
 
         vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
-        // Pipeline cache
-        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-        if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline cache!");
-        }
+        // Pipeline cache, seeded with what the engine read from disk
+        pipelineCache = createPipelineCache(device, pipelineCacheData);
         // Pipeline layout
         // Push constants for UI rendering parameters
         VkPushConstantRange pushConstantRange{};
@@ -463,7 +446,8 @@ namespace Skip {
     }
     
     // Starts a new imGui frame and sets up windows and ui elements
-    void ImguiContext::newFrame(std::string title, std::string gpuDeviceName, float frameTimer, bool updateFrameGraph, Camera* camera) {
+    void ImguiContext::newFrame(std::string title, std::string gpuDeviceName, float frameTimer, bool updateFrameGraph, Camera* camera,
+        const GpuProfiler* profiler) {
         
         ImGui::NewFrame();
         // Init imGui windows and elements
@@ -477,9 +461,9 @@ namespace Skip {
         //ImGui::TextUnformatted(vulkanSwapchain->_vkDevice->_gpuInfo->properties.deviceName);
 
         // Update frame time display
-        /*if (updateFrameGraph) {
+        if (updateFrameGraph) {
             std::rotate(uiSettings.frameTimes.begin(), uiSettings.frameTimes.begin() + 1, uiSettings.frameTimes.end());
-            float frameTime = 1000.0f / (frameTimer * 1000.0f);
+            float frameTime = frameTimer * 1000.0f;
             uiSettings.frameTimes.back() = frameTime;
             if (frameTime < uiSettings.frameTimeMin) {
                 uiSettings.frameTimeMin = frameTime;
@@ -487,11 +471,35 @@ namespace Skip {
             if (frameTime > uiSettings.frameTimeMax) {
                 uiSettings.frameTimeMax = frameTime;
             }
-        }*/
+        }
 
-        /*ImGui::PlotLines("Frame Times", &uiSettings.frameTimes[0], 50, 0, "", uiSettings.frameTimeMin, uiSettings.frameTimeMax, ImVec2(0, 80));
+        ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::TextUnformatted(gpuDeviceName.c_str());
+        std::array<float, 50> sortedFrameTimes = uiSettings.frameTimes;
+        std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+        ImGui::Text("CPU frame %.2f ms, p50 %.2f p95 %.2f p99 %.2f", uiSettings.frameTimes.back(), sortedFrameTimes[25],
+            sortedFrameTimes[47], sortedFrameTimes[49]);
+        ImGui::PlotLines("##cpu", uiSettings.frameTimes.data(), static_cast<int>(uiSettings.frameTimes.size()), 0, "",
+            0.0f, uiSettings.frameTimeMax, ImVec2(300, 40));
+        if (profiler != nullptr && profiler->isSupported()) {
+            // one rolling graph per scope, oldest sample first
+            const std::vector<GpuProfiler::Scope>& scopes = profiler->getScopes();
+            for (uint32_t i = 0; i < scopes.size(); i++) {
+                const GpuProfiler::Scope& scope = scopes[i];
+                ImGui::Text("GPU %s %.2f ms, p50 %.2f p95 %.2f p99 %.2f", scope.name.c_str(), scope.last,
+                    profiler->getPercentile(i, 0.50f), profiler->getPercentile(i, 0.95f), profiler->getPercentile(i, 0.99f));
+                ImGui::PushID(static_cast<int>(i));
+                ImGui::PlotLines("##gpu", scope.history.data(), static_cast<int>(GpuProfiler::HISTORY_SIZE),
+                    static_cast<int>(scope.head), "", 0.0f, FLT_MAX, ImVec2(300, 40));
+                ImGui::PopID();
+            }
+        } else {
+            ImGui::TextUnformatted("GPU timestamps not supported");
+        }
+        ImGui::End();
 
-        ImGui::Text("Camera");
+        /*ImGui::Text("Camera");
 
         ImGui::InputFloat3("position x", &camera->_position.x, 2);
         ImGui::InputFloat3("rotation y", &camera->_position.y, 2);
@@ -530,11 +538,39 @@ namespace Skip {
         ImGui::Render();
     }
 
-    // Update vertex and index buffer containing the imGui elements when required
-    void ImguiContext::updateBuffers(VkDevice device, VkPhysicalDevice physicalDevice) {
-        ImDrawData* imDrawData = ImGui::GetDrawData();
+    // The regions are laid out per frame so the buffer is rebuilt at the same capacity on the next
+    // update, the caller makes sure the GPU is done with it
+    void ImguiContext::setFrameCount(uint32_t frameCount) {
+        destroyGeometryBuffers();
+        frames.resize(frameCount);
+    }
+
+    void ImguiContext::destroyGeometryBuffers() {
+        geometryBuffer.unmap();
+        geometryBuffer.destroy();
+        geometryBuffer = Buffer();
+        for (RetiredBuffer& retired : retiredBuffers) {
+            retired.buffer.unmap();
+            retired.buffer.destroy();
+        }
+        retiredBuffers.clear();
+    }
+
+    // Update vertex and index buffer containing the imGui elements
+    void ImguiContext::updateBuffers(uint32_t frameIndex) {
+        // this frame's last submission is done, so are its draws from replaced buffers
+        for (size_t i = 0; i < retiredBuffers.size();) {
+            retiredBuffers[i].inUse[frameIndex] = false;
+            if (std::none_of(retiredBuffers[i].inUse.begin(), retiredBuffers[i].inUse.end(), [](bool inUse) { return inUse; })) {
+                retiredBuffers[i].buffer.unmap();
+                retiredBuffers[i].buffer.destroy();
+                retiredBuffers.erase(retiredBuffers.begin() + i);
+            } else {
+                i++;
+            }
+        }
 
-        // Note: Alignment is done inside buffer creation
+        ImDrawData* imDrawData = ImGui::GetDrawData();
         VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
         VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
@@ -542,30 +578,35 @@ namespace Skip {
             return;
         }
 
-        // Update buffers only if vertex or index count has been changed compared to current buffer size
-
-        // Vertex buffer
-        if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-            vertexBuffer.unmap();
-            vertexBuffer.destroy();
-            createBuffer(device, physicalDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                &vertexBuffer, vertexBufferSize);
-            vertexCount = imDrawData->TotalVtxCount;
-            vertexBuffer.map();
+        // index offsets have to be a multiple of the index size
+        VkDeviceSize indexStart = (vertexBufferSize + 15) & ~VkDeviceSize(15);
+        VkDeviceSize required = indexStart + indexBufferSize;
+        if (geometryBuffer.buffer == VK_NULL_HANDLE || required > frameCapacity) {
+            if (geometryBuffer.buffer != VK_NULL_HANDLE) {
+                // the other frames may still be drawing from the old buffer
+                RetiredBuffer retired;
+                retired.buffer = geometryBuffer;
+                retired.inUse.assign(frames.size(), true);
+                retired.inUse[frameIndex] = false;
+                retiredBuffers.push_back(retired);
+            }
+            // doubled so a growing UI settles after a few frames
+            const VkDeviceSize minimumCapacity = 64 * 1024;
+            frameCapacity = std::max({ required, frameCapacity * 2, minimumCapacity });
+            frameCapacity = (frameCapacity + 255) & ~VkDeviceSize(255);
+            geometryBuffer = Buffer();
+            createBuffer(allocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                &geometryBuffer, frameCapacity * frames.size());
+            geometryBuffer.map();
         }
 
-        if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-            indexBuffer.unmap();
-            indexBuffer.destroy();
-            createBuffer(device, physicalDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                &indexBuffer, indexBufferSize);
-            indexCount = imDrawData->TotalIdxCount;
-            indexBuffer.map();
-        }
+        FrameData& frame = frames[frameIndex];
+        frame.vertexOffset = frameIndex * frameCapacity;
+        frame.indexOffset = frame.vertexOffset + indexStart;
 
         // Upload data
-        ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-        ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+        ImDrawVert* vtxDst = reinterpret_cast<ImDrawVert*>(static_cast<char*>(geometryBuffer.mapped) + frame.vertexOffset);
+        ImDrawIdx* idxDst = reinterpret_cast<ImDrawIdx*>(static_cast<char*>(geometryBuffer.mapped) + frame.indexOffset);
 
         for (int n = 0; n < imDrawData->CmdListsCount; n++) {
             const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -575,13 +616,13 @@ namespace Skip {
             idxDst += cmd_list->IdxBuffer.Size;
         }
 
-        // Flush to make writes visible to GPU
-        vertexBuffer.flush();
-        indexBuffer.flush();
+        // Flush only this frame's region, the others may be in use by the GPU
+        geometryBuffer.flush(required, frame.vertexOffset);
     }
 
-    void ImguiContext::drawFrame(VkCommandBuffer commandBuffer) {
+    void ImguiContext::drawFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
         ImGuiIO& io = ImGui::GetIO();
+        FrameData& frame = frames[frameIndex];
 
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
@@ -603,11 +644,11 @@ namespace Skip {
         int32_t vertexOffset = 0;
         int32_t indexOffset = 0;
 
-        if (imDrawData->CmdListsCount > 0) {
+        if (imDrawData->CmdListsCount > 0 && imDrawData->TotalVtxCount > 0 && geometryBuffer.buffer != VK_NULL_HANDLE) {
 
-            VkDeviceSize offsets[1] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+            VkDeviceSize offsets[1] = { frame.vertexOffset };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryBuffer.buffer, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, geometryBuffer.buffer, frame.indexOffset, VK_INDEX_TYPE_UINT16);
 
             for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
             {
@@ -919,8 +960,8 @@ namespace Skip {
             1, &imageMemoryBarrier);
     }
 
-    void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, 
-        VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+    void createBuffer(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, MemoryAllocation& bufferMemory, MemoryPool pool) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size; //size of buffer in bytes
@@ -928,27 +969,20 @@ namespace Skip {
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // buffer only used in graphics queue and not elsewhere
         bufferInfo.flags = 0;
 
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        if (vkCreateBuffer(allocator->getDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create buffer!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate buffer memory!");
-        }
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        // sub-allocated and bound by the allocator
+        bufferMemory = allocator->allocateBuffer(buffer, properties, pool);
     }
 
     // Creates a buffer based on Buffer struct
-    VkResult createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, 
-        Skip::Buffer* buffer, VkDeviceSize size, void* data) {
+    VkResult createBuffer(DeviceAllocator* allocator, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
+        Skip::Buffer* buffer, VkDeviceSize size, void* data, MemoryPool pool) {
+        VkDevice device = allocator->getDevice();
         buffer->device = device;
+        buffer->allocator = allocator;
 
         // Create the buffer handle
         VkBufferCreateInfo bufferCreateInfo{};
@@ -959,32 +993,17 @@ namespace Skip {
             throw std::runtime_error("Failed to create buffer from Skip::Buffer");
         };
 
-        // Create the memory backing up the buffer handle
+        // Sub-allocate the memory backing up the buffer handle
         VkMemoryRequirements memReqs;
-        VkMemoryAllocateInfo memAlloc{};
-        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
         vkGetBufferMemoryRequirements(device, buffer->buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        // Find a memory type index that fits the properties of the buffer
-        memAlloc.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, memoryPropertyFlags);
-        // If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-        VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-        if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-            allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-            allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-            memAlloc.pNext = &allocFlagsInfo;
-        }
-        if (vkAllocateMemory(device, &memAlloc, nullptr, &buffer->memory) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate buffer memory");
-        };
+        buffer->memory = allocator->allocate(memReqs, memoryPropertyFlags, pool);
 
         buffer->alignment = memReqs.alignment;
         buffer->size = size;
         buffer->usageFlags = usageFlags;
         buffer->memoryPropertyFlags = memoryPropertyFlags;
 
-        // If a pointer to the buffer data has been passed, map the buffer and copy over the data
+        // If a pointer to the buffer data has been passed, copy it over through the persistent mapping
         if (data != nullptr) {
             buffer->map();
             memcpy(buffer->mapped, data, size);
@@ -1000,4 +1019,4 @@ namespace Skip {
         // Attach the memory to the buffer object
         return buffer->bind();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,74 @@
+#include <LoadReport.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+namespace Skip {
+
+    void LoadReport::add(const std::string& asset, const std::string& stage, float milliseconds, uint64_t bytes,
+        const std::string& note) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.push_back(Entry{ asset, stage, milliseconds, bytes, note });
+    }
+
+    void LoadReport::addPhase(const std::string& phase, float milliseconds) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _phases.emplace_back(phase, milliseconds);
+    }
+
+    void LoadReport::clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.clear();
+        _phases.clear();
+    }
+
+    void LoadReport::print(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(2);
+
+        out << "Startup:" << std::endl;
+        float total = 0.0f;
+        for (const auto& phase : _phases) {
+            out << "    " << phase.first << ": " << phase.second << " ms" << std::endl;
+            total += phase.second;
+        }
+        out << "    total: " << total << " ms" << std::endl;
+
+        // summed per stage, more than the phase time when the stage ran on several threads
+        struct StageTotal {
+            uint32_t count = 0;
+            float milliseconds = 0.0f;
+            uint64_t bytes = 0;
+        };
+        std::map<std::string, StageTotal> stages;
+        for (const Entry& entry : _entries) {
+            StageTotal& stage = stages[entry.stage];
+            stage.count++;
+            stage.milliseconds += entry.milliseconds;
+            stage.bytes += entry.bytes;
+        }
+        for (const auto& stage : stages) {
+            out << "    " << stage.first << ": " << stage.second.count << " assets, " << stage.second.milliseconds
+                << " ms summed, " << stage.second.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        }
+
+        // slowest first
+        std::vector<Entry> entries = _entries;
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.milliseconds > b.milliseconds;
+        });
+        out << "Assets:" << std::endl;
+        for (const Entry& entry : entries) {
+            out << "    " << std::setw(10) << entry.milliseconds << " ms  " << std::setw(16) << std::left << entry.stage
+                << std::right << "  " << entry.asset << " (" << entry.bytes / 1024.0 << " KB)";
+            if (!entry.note.empty()) {
+                out << ", " << entry.note;
+            }
+            out << std::endl;
+        }
+        out.flags(flags);
+    }
+
+}
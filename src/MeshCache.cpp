@@ -0,0 +1,196 @@
+#include <MeshCache.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace Skip {
+
+    namespace {
+
+        const uint64_t FNV_OFFSET = 14695981039346656037ull;
+        const uint64_t FNV_PRIME = 1099511628211ull;
+
+        uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t hash = FNV_OFFSET) {
+            for (size_t i = 0; i < size; i++) {
+                hash ^= data[i];
+                hash *= FNV_PRIME;
+            }
+            return hash;
+        }
+
+        uint64_t alignOffset(uint64_t offset) {
+            return (offset + 15) & ~uint64_t(15);
+        }
+
+        bool getSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time) {
+            std::error_code error;
+            size = std::filesystem::file_size(sourcePath, error);
+            if (error) {
+                return false;
+            }
+            auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+            if (error) {
+                return false;
+            }
+            time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+            return true;
+        }
+
+        float getWeldTolerance(const SkipObject* object) {
+            return object->_useIndexBuffer ? object->_weldTolerance : 0.0f;
+        }
+
+        uint32_t getCacheFlags(const SkipObject* object) {
+            uint32_t flags = 0;
+            if (object->_useIndexBuffer) {
+                flags |= MeshCacheHeader::INDEXED;
+                // only indexed meshes get optimized
+                flags |= object->_optimizeMesh ? MeshCacheHeader::OPTIMIZED : 0;
+            }
+            return flags;
+        }
+
+        bool hashSource(const std::string& sourcePath, uint64_t& hash) {
+            MappedFile source;
+            if (!source.open(sourcePath)) {
+                return false;
+            }
+            hash = hashBytes(source.data(), source.size());
+            return true;
+        }
+
+    }
+
+    std::string getMeshCachePath(const std::string& sourcePath, uint32_t flags) {
+        // one file per source path and setting
+        uint64_t pathHash = hashBytes(reinterpret_cast<const uint8_t*>(sourcePath.data()), sourcePath.size());
+        std::ostringstream path;
+        path << MESH_CACHE_DIRECTORY << "/" << std::hex << pathHash << (flags & MeshCacheHeader::INDEXED ? ".indexed" : "")
+            << (flags & MeshCacheHeader::OPTIMIZED ? ".optimized" : "") << ".skipmesh";
+        return path.str();
+    }
+
+    bool loadMeshCache(const std::string& sourcePath, SkipObject* object) {
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        if (!getSourceStamp(sourcePath, sourceSize, sourceTime)) {
+            return false;
+        }
+
+        uint32_t flags = getCacheFlags(object);
+        std::shared_ptr<MappedMesh> mesh = std::make_shared<MappedMesh>();
+        MappedFile& cache = mesh->file;
+        if (!cache.open(getMeshCachePath(sourcePath, flags)) || cache.size() < sizeof(MeshCacheHeader)) {
+            return false;
+        }
+        MeshCacheHeader header;
+        memcpy(&header, cache.data(), sizeof(header));
+        if (header.magic != MeshCacheHeader::MAGIC || header.version != MeshCacheHeader::VERSION
+            || header.vertexStride != sizeof(Vertex) || header.flags != flags
+            || header.weldTolerance != getWeldTolerance(object) || header.sourceSize != sourceSize) {
+            return false;
+        }
+
+        // don't trust the sizes before checking them against the file
+        if (header.pathLength != sourcePath.size() || sizeof(header) + header.pathLength > cache.size()
+            || memcmp(cache.data() + sizeof(header), sourcePath.data(), sourcePath.size()) != 0) {
+            return false;
+        }
+        uint64_t vertexBytes = header.vertexCount * sizeof(Vertex);
+        uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+        if (header.vertexOffset > cache.size() || vertexBytes > cache.size() - header.vertexOffset
+            || header.indexOffset > cache.size() || indexBytes > cache.size() - header.indexOffset) {
+            return false;
+        }
+
+        if (header.sourceTime != sourceTime) {
+            // touched, e.g. by a checkout, the content decides
+            uint64_t sourceHash;
+            if (!hashSource(sourcePath, sourceHash) || sourceHash != header.sourceHash) {
+                return false;
+            }
+        }
+
+        // already in the final layout, the object reads it in place. The offsets are 16 byte aligned
+        // and the mapping starts on a page
+        mesh->vertices = reinterpret_cast<const Vertex*>(cache.data() + header.vertexOffset);
+        mesh->vertexCount = static_cast<size_t>(header.vertexCount);
+        mesh->indices = indexBytes > 0 ? reinterpret_cast<const uint32_t*>(cache.data() + header.indexOffset) : nullptr;
+        mesh->indexCount = static_cast<size_t>(header.indexCount);
+        object->_vertices.clear();
+        object->_indices.clear();
+        object->_mappedMesh = mesh;
+        if (flags & MeshCacheHeader::OPTIMIZED) {
+            object->_meshOptimized = true;
+            object->_vertexCacheBefore = header.vertexCacheBefore;
+            object->_vertexCacheAfter = header.vertexCacheAfter;
+        }
+        return true;
+    }
+
+    bool storeMeshCache(const std::string& sourcePath, const SkipObject* object) {
+        const std::vector<Vertex>& vertices = object->_vertices;
+        const std::vector<uint32_t>& indices = object->_indices;
+        uint32_t flags = getCacheFlags(object);
+        if ((flags & MeshCacheHeader::OPTIMIZED) && !object->_meshOptimized) {
+            return false;
+        }
+        MeshCacheHeader header{};
+        header.magic = MeshCacheHeader::MAGIC;
+        header.version = MeshCacheHeader::VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.flags = flags;
+        header.weldTolerance = getWeldTolerance(object);
+        header.vertexCacheBefore = object->_vertexCacheBefore;
+        header.vertexCacheAfter = object->_vertexCacheAfter;
+        if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceTime) || !hashSource(sourcePath, header.sourceHash)) {
+            return false;
+        }
+        header.pathLength = sourcePath.size();
+        header.vertexCount = vertices.size();
+        header.vertexOffset = alignOffset(sizeof(header) + header.pathLength);
+        header.indexCount = indices.size();
+        header.indexOffset = alignOffset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+
+        std::error_code error;
+        std::filesystem::create_directories(MESH_CACHE_DIRECTORY, error);
+        if (error) {
+            return false;
+        }
+
+        // written under a temporary name and renamed, so a reader (or another object loading the
+        // same source at the same time) never sees half a file
+        std::string path = getMeshCachePath(sourcePath, flags);
+        std::ostringstream temporaryPath;
+        temporaryPath << path << "." << std::this_thread::get_id() << ".tmp";
+        {
+            std::ofstream file(temporaryPath.str(), std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            const char padding[16] = {};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(sourcePath.data(), sourcePath.size());
+            file.write(padding, header.vertexOffset - (sizeof(header) + header.pathLength));
+            file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+            file.write(padding, header.indexOffset - (header.vertexOffset + header.vertexCount * sizeof(Vertex)));
+            file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+            if (!file) {
+                file.close();
+                std::filesystem::remove(temporaryPath.str(), error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath.str(), path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath.str(), error);
+            return false;
+        }
+        return true;
+    }
+
+}
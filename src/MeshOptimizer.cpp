@@ -0,0 +1,284 @@
+#include <MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Skip {
+
+    namespace {
+
+        // FIFO cache: a vertex is cached while fewer than cacheSize misses happened since its own
+        struct CacheSimulation {
+            std::vector<uint32_t> missTime;
+            uint32_t time;
+            uint32_t cacheSize;
+
+            CacheSimulation(size_t vertexCount, uint32_t size) : missTime(vertexCount, 0), time(size + 1), cacheSize(size) {
+            }
+
+            void reset() {
+                time += cacheSize + 1;
+            }
+
+            // misses of one triangle
+            uint32_t triangle(const uint32_t* corners) {
+                uint32_t misses = 0;
+                for (int i = 0; i < 3; i++) {
+                    if (time - missTime[corners[i]] > cacheSize) {
+                        missTime[corners[i]] = time++;
+                        misses++;
+                    }
+                }
+                return misses;
+            }
+        };
+
+        struct float3 {
+            float x, y, z;
+        };
+
+        float3 getPosition(const float* positions, size_t stride, uint32_t vertex) {
+            const float* position = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+            return float3{ position[0], position[1], position[2] };
+        }
+
+    }
+
+    VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+        VertexCacheStats stats;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return stats;
+        }
+        CacheSimulation cache(vertexCount, cacheSize);
+        uint64_t misses = 0;
+        for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+            misses += cache.triangle(&indices[triangle * 3]);
+        }
+        std::vector<uint8_t> used(vertexCount, 0);
+        size_t usedCount = 0;
+        for (uint32_t index : indices) {
+            usedCount += used[index] ? 0 : 1;
+            used[index] = 1;
+        }
+        stats.acmr = static_cast<float>(misses) / triangleCount;
+        stats.atvr = static_cast<float>(misses) / usedCount;
+        return stats;
+    }
+
+    void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters,
+        uint32_t cacheSize) {
+        clusters.clear();
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // triangles around every vertex, flattened
+        std::vector<uint32_t> live(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            live[indices[i]]++;
+        }
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+            adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + live[vertex];
+        }
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<uint32_t> result;
+        result.reserve(triangleCount * 3);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<uint32_t> deadEnds;
+        std::vector<uint32_t> candidates;
+        uint32_t time = cacheSize + 1;
+        size_t cursor = 0;
+
+        // fan around vertex 0 first, or the first vertex with triangles left
+        int64_t fan = 0;
+        clusters.push_back(0);
+        while (fan >= 0) {
+            candidates.clear();
+            for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++) {
+                uint32_t triangle = adjacency[a];
+                if (emitted[triangle]) {
+                    continue;
+                }
+                for (int corner = 0; corner < 3; corner++) {
+                    uint32_t vertex = indices[triangle * 3 + corner];
+                    result.push_back(vertex);
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    live[vertex]--;
+                    if (time - cacheTime[vertex] > cacheSize) {
+                        cacheTime[vertex] = time++;
+                    }
+                }
+                emitted[triangle] = 1;
+            }
+
+            // the candidate that is still cached after its remaining triangles went through, the
+            // one that entered the cache earliest of those
+            int64_t next = -1;
+            int64_t best = -1;
+            for (uint32_t vertex : candidates) {
+                if (live[vertex] == 0) {
+                    continue;
+                }
+                int64_t priority = 0;
+                if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize) {
+                    priority = time - cacheTime[vertex];
+                }
+                if (priority > best) {
+                    best = priority;
+                    next = vertex;
+                }
+            }
+
+            if (next == -1) {
+                // dead end, go back to recently used vertices, else the next unfinished one
+                while (!deadEnds.empty()) {
+                    uint32_t vertex = deadEnds.back();
+                    deadEnds.pop_back();
+                    if (live[vertex] > 0) {
+                        next = vertex;
+                        break;
+                    }
+                }
+                while (next == -1 && cursor < vertexCount) {
+                    if (live[cursor] > 0) {
+                        next = static_cast<int64_t>(cursor);
+                    }
+                    cursor++;
+                }
+                if (next != -1 && result.size() / 3 < triangleCount) {
+                    clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+                }
+            }
+            fan = next;
+        }
+        indices.swap(result);
+    }
+
+    void optimizeOverdraw(std::vector<uint32_t>& indices, const float* positions, size_t positionStride, size_t vertexCount,
+        const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || clusters.empty()) {
+            return;
+        }
+
+        // pieces facing away from the mesh center come first
+        double centerX = 0.0, centerY = 0.0, centerZ = 0.0;
+        for (uint32_t index : indices) {
+            float3 position = getPosition(positions, positionStride, index);
+            centerX += position.x;
+            centerY += position.y;
+            centerZ += position.z;
+        }
+        float3 center = { float(centerX / indices.size()), float(centerY / indices.size()), float(centerZ / indices.size()) };
+        float cacheOrderAcmr = analyzeVertexCache(indices, vertexCount, cacheSize).acmr;
+
+        // The split below only estimates the cost of reordering, when the result misses the
+        // threshold it is tried again with smaller margins
+        float splitThreshold = threshold;
+        for (int attempt = 0; attempt < 4; attempt++, splitThreshold = 1.0f + (splitThreshold - 1.0f) * 0.5f) {
+            // Split every cluster wherever its ACMR so far is within splitThreshold of the whole
+            // cluster's, starting over with a cold cache
+            std::vector<uint32_t> pieces;
+            CacheSimulation cache(vertexCount, cacheSize);
+            for (size_t c = 0; c < clusters.size(); c++) {
+                uint32_t start = clusters[c];
+                uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount);
+
+                cache.reset();
+                uint64_t clusterMisses = 0;
+                for (uint32_t triangle = start; triangle < end; triangle++) {
+                    clusterMisses += cache.triangle(&indices[triangle * 3]);
+                }
+                float clusterThreshold = splitThreshold * static_cast<float>(clusterMisses) / (end - start);
+
+                cache.reset();
+                uint64_t misses = 0;
+                uint32_t pieceStart = start;
+                pieces.push_back(start);
+                for (uint32_t triangle = start; triangle < end; triangle++) {
+                    misses += cache.triangle(&indices[triangle * 3]);
+                    if (triangle + 1 < end && misses <= clusterThreshold * (triangle + 1 - pieceStart)) {
+                        pieces.push_back(triangle + 1);
+                        pieceStart = triangle + 1;
+                        misses = 0;
+                        cache.reset();
+                    }
+                }
+            }
+            if (pieces.size() < 2) {
+                return;
+            }
+
+            std::vector<float> sortKeys(pieces.size());
+            for (size_t p = 0; p < pieces.size(); p++) {
+                uint32_t start = pieces[p];
+                uint32_t end = p + 1 < pieces.size() ? pieces[p + 1] : static_cast<uint32_t>(triangleCount);
+                float3 centroid = { 0.0f, 0.0f, 0.0f };
+                float3 normal = { 0.0f, 0.0f, 0.0f };
+                for (uint32_t triangle = start; triangle < end; triangle++) {
+                    float3 a = getPosition(positions, positionStride, indices[triangle * 3 + 0]);
+                    float3 b = getPosition(positions, positionStride, indices[triangle * 3 + 1]);
+                    float3 c = getPosition(positions, positionStride, indices[triangle * 3 + 2]);
+                    centroid.x += a.x + b.x + c.x;
+                    centroid.y += a.y + b.y + c.y;
+                    centroid.z += a.z + b.z + c.z;
+                    // area weighted
+                    float3 ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+                    float3 ac = { c.x - a.x, c.y - a.y, c.z - a.z };
+                    normal.x += ab.y * ac.z - ab.z * ac.y;
+                    normal.y += ab.z * ac.x - ab.x * ac.z;
+                    normal.z += ab.x * ac.y - ab.y * ac.x;
+                }
+                float cornerCount = 3.0f * (end - start);
+                float3 offset = { centroid.x / cornerCount - center.x, centroid.y / cornerCount - center.y,
+                    centroid.z / cornerCount - center.z };
+                float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+                sortKeys[p] = length > 0.0f ? (offset.x * normal.x + offset.y * normal.y + offset.z * normal.z) / length : 0.0f;
+            }
+
+            std::vector<uint32_t> pieceOrder(pieces.size());
+            std::iota(pieceOrder.begin(), pieceOrder.end(), 0);
+            std::stable_sort(pieceOrder.begin(), pieceOrder.end(), [&sortKeys](uint32_t a, uint32_t b) {
+                return sortKeys[a] > sortKeys[b];
+            });
+
+            std::vector<uint32_t> result;
+            result.reserve(indices.size());
+            for (uint32_t p : pieceOrder) {
+                uint32_t start = pieces[p];
+                uint32_t end = p + 1 < pieces.size() ? pieces[p + 1] : static_cast<uint32_t>(triangleCount);
+                result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+            }
+
+            if (analyzeVertexCache(result, vertexCount, cacheSize).acmr <= cacheOrderAcmr * threshold) {
+                indices.swap(result);
+                return;
+            }
+        }
+        // no split was cheap enough, the cache order stays
+    }
+
+    std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount) {
+        std::vector<uint32_t> remap(vertexCount, UNUSED_VERTEX);
+        uint32_t next = 0;
+        for (uint32_t& index : indices) {
+            if (remap[index] == UNUSED_VERTEX) {
+                remap[index] = next++;
+            }
+            index = remap[index];
+        }
+        return remap;
+    }
+
+}
@@ -0,0 +1,94 @@
+#include <PipelineCache.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace Skip {
+
+    std::vector<uint8_t> readPipelineCache(const VkPhysicalDeviceProperties& properties, const std::string& path) {
+        std::vector<uint8_t> data;
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return data;
+        }
+        std::streamsize size = file.tellg();
+        if (size < static_cast<std::streamsize>(sizeof(PipelineCacheHeader))) {
+            return data;
+        }
+        data.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+            data.clear();
+            return data;
+        }
+
+        // a new driver or another GPU rejects the old pipelines anyway, start over with an empty cache
+        PipelineCacheHeader header;
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.headerSize < sizeof(header) || header.headerSize > data.size()
+            || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+            || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            data.clear();
+        }
+        return data;
+    }
+
+    VkPipelineCache createPipelineCache(VkDevice device, const std::vector<uint8_t>& data) {
+        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        pipelineCacheCreateInfo.initialDataSize = data.size();
+        pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+        VkPipelineCache pipelineCache;
+        if (vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline cache!");
+        }
+        return pipelineCache;
+    }
+
+    bool writePipelineCache(VkDevice device, VkPipelineCache cache, const std::vector<VkPipelineCache>& others,
+        const std::string& path) {
+        if (!others.empty() && vkMergePipelineCaches(device, cache, static_cast<uint32_t>(others.size()), others.data()) != VK_SUCCESS) {
+            return false;
+        }
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return false;
+        }
+        std::vector<uint8_t> data(size);
+        if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::path cachePath(path);
+        if (cachePath.has_parent_path()) {
+            std::filesystem::create_directories(cachePath.parent_path(), error);
+            if (error) {
+                return false;
+            }
+        }
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(size));
+            if (!file) {
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -1,4 +1,7 @@
 #include <SkipScene.h>
+#include <CpuProfiler.h>
+
+#include <algorithm>
 
 namespace Skip {
 
@@ -18,9 +21,31 @@ namespace Skip {
     }
 
     void SkipScene::loadScene(float aspect) {
+        for (size_t i = 0; i < _objects.size(); i++) {
+            this->loadObject(i, aspect);
+        }
+        this->finishLoading(aspect);
+    }
+
+    void SkipScene::loadObject(size_t index, float aspect) {
+        // only touches the object itself, the tree is filled in finishLoading
+        SkipObject* object = _objects[index];
+        object->loadObject(aspect);
+        if (object->_optimizeMesh && !object->_meshOptimized) {
+            object->optimizeMesh();
+        }
+        object->computeBounds();
+    }
+
+    void SkipScene::finishLoading(float aspect) {
+        SKIP_PROFILE_ZONE("finishLoading");
         for (SkipObject* object : _objects) {
-            object->loadObject(aspect);
+            this->updateObject(object);
         }
+        _bvh.rebuild();
+
+        _projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
+        _projection[1][1] *= -1;
     }
 
     void SkipScene::addObject(SkipObject* skipObject, SkipObject* parent, bool inheritLighting) {
@@ -28,18 +53,129 @@ namespace Skip {
             skipObject->_inheritLighting = true;
             parent->addChild(skipObject, inheritLighting);
         }
+        skipObject->_sceneIndex = static_cast<uint32_t>(_objects.size());
         _objects.push_back(skipObject);
+        _objectsByName.emplace(skipObject->_name, skipObject);
+        if (skipObject->_instanced) {
+            _instancedObjects.push_back(skipObject);
+        }
+        if (skipObject->getVertexCount() > 0) {
+            // already loaded, otherwise loadScene puts it in the tree
+            this->updateObject(skipObject);
+        }
+        _version++;
+        if (_objectAdded) {
+            _objectAdded(skipObject);
+        }
     }
 
     void SkipScene::removeObject(std::string name) {
-        _objects.erase(
-            std::remove_if(
-                _objects.begin(),
-                _objects.end(),
-                [name](SkipObject* const& obj) { return obj->_name == name; }
-            ),
-            _objects.end()
-        );
+        auto range = _objectsByName.equal_range(name);
+        std::vector<SkipObject*> removed;
+        for (auto it = range.first; it != range.second; ++it) {
+            removed.push_back(it->second);
+        }
+        for (SkipObject* object : removed) {
+            this->removeObject(object);
+        }
+    }
+
+    void SkipScene::removeObject(SkipObject* object) {
+        uint32_t index = object->_sceneIndex;
+        if (index >= _objects.size() || _objects[index] != object) {
+            return;
+        }
+        if (object->_bvhProxy != DynamicBvh::NULL_NODE) {
+            _bvh.remove(object->_bvhProxy);
+            object->_bvhProxy = DynamicBvh::NULL_NODE;
+        }
+        if (object->_bvhDirty) {
+            _dirtyObjects.erase(std::find(_dirtyObjects.begin(), _dirtyObjects.end(), object));
+            object->_bvhDirty = false;
+        }
+        if (object->_instanced) {
+            _instancedObjects.erase(std::find(_instancedObjects.begin(), _instancedObjects.end(), object));
+        }
+        auto range = _objectsByName.equal_range(object->_name);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == object) {
+                _objectsByName.erase(it);
+                break;
+            }
+        }
+        if (_objectRemoved) {
+            _objectRemoved(object);
+        }
+
+        // the last object fills the gap, nothing else has to be renumbered
+        SkipObject* last = _objects.back();
+        _objects[index] = last;
+        last->_sceneIndex = index;
+        _objects.pop_back();
+        _version++;
+    }
+
+    void SkipScene::updateObject(SkipObject* object) {
+        if (object->_instanced) {
+            return;
+        }
+        if (object->_bvhProxy == DynamicBvh::NULL_NODE) {
+            object->updateWorldBounds();
+            object->_bvhProxy = _bvh.insert(object->_worldBounds, object);
+        } else if (!object->_bvhDirty) {
+            object->_bvhDirty = true;
+            _dirtyObjects.push_back(object);
+        }
+    }
+
+    uint32_t SkipScene::refit() {
+        // Objects moving within their fat boxes leave the tree alone, the rest are reinserted
+        uint32_t moved = 0;
+        for (SkipObject* object : _dirtyObjects) {
+            object->_bvhDirty = false;
+            object->updateWorldBounds();
+            if (_bvh.move(object->_bvhProxy, object->_worldBounds)) {
+                moved++;
+            }
+        }
+        _dirtyObjects.clear();
+        // reinserting keeps the tree valid but not as tight as a fresh build
+        if (moved > 0 && _bvh.isDegraded()) {
+            _bvh.rebuild();
+        }
+        return moved;
+    }
+
+    void SkipScene::queryFrustum(const Frustum& frustum, const std::function<void(SkipObject*, bool)>& visit) const {
+        _bvh.queryFrustum(frustum, [this, &visit](int32_t proxy, bool fullyInside) {
+            visit(static_cast<SkipObject*>(_bvh.getUserData(proxy)), fullyInside);
+        });
+    }
+
+    void SkipScene::queryAabb(const Aabb& box, const std::function<void(SkipObject*)>& visit) const {
+        _bvh.queryAabb(box, [this, &box, &visit](int32_t proxy) {
+            SkipObject* object = static_cast<SkipObject*>(_bvh.getUserData(proxy));
+            // the tree only knows the fat boxes
+            if (object->_worldBounds.overlaps(box)) {
+                visit(object);
+            }
+        });
+    }
+
+    SkipObject* SkipScene::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        float* hitDistance) const {
+        glm::vec3 inverseDirection = 1.0f / direction;
+        float distance;
+        int32_t proxy = _bvh.raycast(origin, direction, maxDistance, [this, &origin, &inverseDirection, maxDistance](int32_t proxy) {
+            return static_cast<SkipObject*>(_bvh.getUserData(proxy))->_worldBounds.intersectRay(origin, inverseDirection, maxDistance);
+        }, distance);
+        if (proxy == DynamicBvh::NULL_NODE) {
+            return nullptr;
+        }
+        if (hitDistance != nullptr) {
+            *hitDistance = distance;
+        }
+        return static_cast<SkipObject*>(_bvh.getUserData(proxy));
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <TextureCache.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace Skip {
+
+    namespace {
+
+        void combineHash(size_t& seed, size_t value) {
+            seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+        }
+
+    }
+
+    size_t TextureKeyHash::operator()(const TextureKey& key) const {
+        size_t seed = std::hash<std::string>()(key.path);
+        combineHash(seed, (key.srgb ? 1 : 0) | (key.mipmaps ? 2 : 0));
+        return seed;
+    }
+
+    size_t SamplerKeyHash::operator()(const SamplerKey& key) const {
+        size_t seed = std::hash<uint32_t>()(static_cast<uint32_t>(key.filter));
+        combineHash(seed, static_cast<size_t>(key.mipmapMode));
+        combineHash(seed, static_cast<size_t>(key.addressMode));
+        combineHash(seed, std::hash<float>()(key.maxAnisotropy));
+        return seed;
+    }
+
+    TextureCache::TextureCache(VkDevice device, DeviceAllocator* allocator, float maxAnisotropy) {
+        _device = device;
+        _allocator = allocator;
+        _maxAnisotropy = maxAnisotropy;
+    }
+
+    TextureCache::~TextureCache() {
+        for (auto& entry : _textures) {
+            this->destroyTexture(entry.second);
+        }
+        for (auto& entry : _samplers) {
+            vkDestroySampler(_device, entry.second, nullptr);
+        }
+    }
+
+    CachedTexture* TextureCache::acquire(const TextureKey& key, bool& created) {
+        auto inserted = _textures.emplace(key, CachedTexture());
+        CachedTexture& texture = inserted.first->second;
+        created = inserted.second;
+        if (!created) {
+            _hits++;
+        }
+        texture.references++;
+        return &texture;
+    }
+
+    void TextureCache::release(const TextureKey& key) {
+        auto it = _textures.find(key);
+        if (it == _textures.end()) {
+            throw std::runtime_error("Released texture " + key.path + " is not in the cache!");
+        }
+        if (--it->second.references == 0) {
+            this->destroyTexture(it->second);
+            _textures.erase(it);
+        }
+    }
+
+    VkSampler TextureCache::getSampler(const SamplerKey& key) {
+        auto it = _samplers.find(key);
+        if (it != _samplers.end()) {
+            return it->second;
+        }
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        // specify how to interpolate texels -- other option is VK_FILTER_NEAREST
+        samplerInfo.magFilter = key.filter;
+        samplerInfo.minFilter = key.filter;
+        // U, V, W is x, y, z in texture space
+        samplerInfo.addressModeU = key.addressMode;
+        samplerInfo.addressModeV = key.addressMode;
+        samplerInfo.addressModeW = key.addressMode;
+        //anisotropic filtering
+        samplerInfo.anisotropyEnable = key.maxAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = std::min(key.maxAnisotropy, _maxAnisotropy);
+        // border color when sampling beyond image (can't specify arbitrary color)
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        // mipmapping settings
+        samplerInfo.mipmapMode = key.mipmapMode;
+        samplerInfo.mipLodBias = 0.0f;
+        samplerInfo.minLod = 0.0f;
+        // the image view limits the levels, so the sampler does not depend on the texture
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        VkSampler sampler;
+        if (vkCreateSampler(_device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create a texture sampler!");
+        }
+        _samplers.emplace(key, sampler);
+        return sampler;
+    }
+
+    void TextureCache::destroyTexture(CachedTexture& texture) {
+        if (texture.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(_device, texture.view, nullptr);
+        }
+        if (texture.image != VK_NULL_HANDLE) {
+            vkDestroyImage(_device, texture.image, nullptr);
+            _allocator->free(texture.memory);
+        }
+        texture = CachedTexture();
+    }
+
+}
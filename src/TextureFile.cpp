@@ -0,0 +1,171 @@
+#include <TextureFile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace Skip {
+
+    namespace {
+
+        const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+        // what follows the identifier, up to the supercompression data range (two uint64_t
+        // the loader does not need) and then the level index
+        struct Ktx2Header {
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+        };
+        static_assert(sizeof(Ktx2Header) == 52, "KTX2 header must be packed");
+        const size_t KTX2_LEVEL_INDEX_OFFSET = 12 + sizeof(Ktx2Header) + 2 * sizeof(uint64_t);
+
+        struct Ktx2Level {
+            uint64_t byteOffset;
+            uint64_t byteLength;
+            uint64_t uncompressedByteLength;
+        };
+
+        uint64_t getLevelSize(const TextureFormatInfo& info, uint32_t width, uint32_t height) {
+            uint64_t blocksX = (width + info.blockSize - 1) / info.blockSize;
+            uint64_t blocksY = (height + info.blockSize - 1) / info.blockSize;
+            return blocksX * blocksY * info.blockBytes;
+        }
+
+    }
+
+    uint64_t CompressedTexture::dataSize() const {
+        uint64_t size = 0;
+        for (const TextureLevel& level : levels) {
+            size += level.size;
+        }
+        return size;
+    }
+
+    TextureFormatInfo getTextureFormatInfo(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return { 8, 4 };
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return { 16, 4 };
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return { 4, 1 };
+        default:
+            return { 0, 1 };
+        }
+    }
+
+    std::string getTextureFormatName(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return "BC1 rgb";
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return "BC1 rgb srgb";
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return "BC1";
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return "BC1 srgb";
+        case VK_FORMAT_BC2_UNORM_BLOCK: return "BC2";
+        case VK_FORMAT_BC2_SRGB_BLOCK: return "BC2 srgb";
+        case VK_FORMAT_BC3_UNORM_BLOCK: return "BC3";
+        case VK_FORMAT_BC3_SRGB_BLOCK: return "BC3 srgb";
+        case VK_FORMAT_BC4_UNORM_BLOCK: return "BC4";
+        case VK_FORMAT_BC4_SNORM_BLOCK: return "BC4 snorm";
+        case VK_FORMAT_BC5_UNORM_BLOCK: return "BC5";
+        case VK_FORMAT_BC5_SNORM_BLOCK: return "BC5 snorm";
+        case VK_FORMAT_BC7_UNORM_BLOCK: return "BC7";
+        case VK_FORMAT_BC7_SRGB_BLOCK: return "BC7 srgb";
+        case VK_FORMAT_R8G8B8A8_UNORM: return "RGBA8";
+        case VK_FORMAT_R8G8B8A8_SRGB: return "RGBA8 srgb";
+        default: return "format " + std::to_string(static_cast<uint32_t>(format));
+        }
+    }
+
+    std::string findCompressedTexture(const std::string& texturePath) {
+        std::filesystem::path path(texturePath);
+        if (path.extension() == ".ktx2") {
+            return texturePath;
+        }
+        std::error_code error;
+        path.replace_extension(".ktx2");
+        if (std::filesystem::is_regular_file(path, error)) {
+            return path.string();
+        }
+        return std::string();
+    }
+
+    void loadKtx2(const std::string& path, CompressedTexture& texture) {
+        texture.file = std::make_unique<MappedFile>();
+        if (!texture.file->open(path)) {
+            throw std::runtime_error("Failed to open texture file " + path + "!");
+        }
+        const uint8_t* data = texture.file->data();
+        size_t size = texture.file->size();
+
+        Ktx2Header header;
+        if (size < KTX2_LEVEL_INDEX_OFFSET || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            throw std::runtime_error(path + " is not a KTX2 file!");
+        }
+        memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(Ktx2Header));
+
+        // only what can be copied straight into a 2D image
+        TextureFormatInfo info = getTextureFormatInfo(static_cast<VkFormat>(header.vkFormat));
+        if (info.blockBytes == 0) {
+            throw std::runtime_error(path + " has an unsupported format (" + std::to_string(header.vkFormat) + ")!");
+        }
+        if (header.supercompressionScheme != 0) {
+            throw std::runtime_error(path + " is supercompressed, only plain KTX2 files are supported!");
+        }
+        if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+            throw std::runtime_error(path + " is not a single 2D texture!");
+        }
+
+        // a level count of 0 asks for mips to be generated, which block formats can not be blitted for
+        uint32_t levelCount = std::max(header.levelCount, 1u);
+        uint32_t maxLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(header.pixelWidth, header.pixelHeight)))) + 1;
+        if (levelCount > maxLevels || KTX2_LEVEL_INDEX_OFFSET + levelCount * sizeof(Ktx2Level) > size) {
+            throw std::runtime_error(path + " has an invalid level index!");
+        }
+
+        texture.format = static_cast<VkFormat>(header.vkFormat);
+        texture.width = header.pixelWidth;
+        texture.height = header.pixelHeight;
+        texture.levels.resize(levelCount);
+        for (uint32_t i = 0; i < levelCount; i++) {
+            Ktx2Level level;
+            memcpy(&level, data + KTX2_LEVEL_INDEX_OFFSET + i * sizeof(Ktx2Level), sizeof(Ktx2Level));
+
+            TextureLevel& textureLevel = texture.levels[i];
+            textureLevel.width = std::max(header.pixelWidth >> i, 1u);
+            textureLevel.height = std::max(header.pixelHeight >> i, 1u);
+            textureLevel.offset = level.byteOffset;
+            textureLevel.size = level.byteLength;
+            if (level.byteLength != getLevelSize(info, textureLevel.width, textureLevel.height)
+                || level.byteOffset > size || level.byteLength > size - level.byteOffset) {
+                throw std::runtime_error(path + " has an invalid mip level " + std::to_string(i) + "!");
+            }
+        }
+    }
+
+}
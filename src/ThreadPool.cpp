@@ -0,0 +1,93 @@
+#include <ThreadPool.h>
+#include <CpuProfiler.h>
+
+namespace Skip {
+
+    ThreadPool::ThreadPool(uint32_t threadCount, const std::string& name) {
+        for (uint32_t i = 0; i < threadCount; i++) {
+            _workers.emplace_back(&ThreadPool::workerLoop, this, name + " " + std::to_string(i + 1));
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (std::thread& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& job) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1 || _workers.empty()) {
+            // not worth waking anyone up
+            for (uint32_t i = 0; i < count; i++) {
+                job(i);
+            }
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _job = &job;
+        _count = count;
+        _next = 0;
+        _remaining = count;
+        _generation++;
+        _wake.notify_all();
+
+        this->runJobs(lock);
+        _done.wait(lock, [this] { return _remaining == 0; });
+        _job = nullptr;
+
+        if (_error) {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            lock.unlock();
+            std::rethrow_exception(error);
+        }
+    }
+
+    void ThreadPool::workerLoop(std::string name) {
+        SKIP_PROFILE_THREAD(name);
+        std::unique_lock<std::mutex> lock(_mutex);
+        uint64_t seenGeneration = _generation;
+        while (true) {
+            _wake.wait(lock, [this, seenGeneration] { return _stopping || _generation != seenGeneration; });
+            if (_stopping) {
+                return;
+            }
+            seenGeneration = _generation;
+            this->runJobs(lock);
+        }
+    }
+
+    void ThreadPool::runJobs(std::unique_lock<std::mutex>& lock) {
+        while (_job != nullptr && _next < _count) {
+            uint32_t index = _next++;
+            const std::function<void(uint32_t)>* job = _job;
+
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                (*job)(index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            if (error && !_error) {
+                _error = error;
+            }
+
+            if (--_remaining == 0) {
+                _done.notify_all();
+            }
+        }
+    }
+
+}
@@ -0,0 +1,344 @@
+#include <UploadManager.h>
+#include <ImguiContext.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace Skip {
+
+    UploadManager::UploadManager(VulkanDevice* device, VkDeviceSize ringSize) {
+        _device = device->_logicalDevice;
+        _allocator = device->_allocator;
+        _queue = device->_queues.transfer;
+        _graphicsQueue = device->_queues.graphics;
+        _transferFamily = device->_queueFamilies.transferFamily.value();
+        _graphicsFamily = device->_queueFamilies.graphicsFamily.value();
+        _ringSize = ringSize;
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = _transferFamily;
+        // batch command buffers are reused once they finish
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload command pool!");
+        }
+
+        VkSemaphoreTypeCreateInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &timelineInfo;
+        if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_timeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload timeline semaphore!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(_device, &fenceInfo, nullptr, &_synchronizeFence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload fence!");
+        }
+
+        createBuffer(_allocator, _ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _ringBuffer, _ringMemory);
+    }
+
+    UploadManager::~UploadManager() {
+        this->wait(this->flush());
+        vkDestroyBuffer(_device, _ringBuffer, nullptr);
+        _allocator->free(_ringMemory);
+        vkDestroySemaphore(_device, _timeline, nullptr);
+        vkDestroyFence(_device, _synchronizeFence, nullptr);
+        // frees the command buffers as well
+        vkDestroyCommandPool(_device, _commandPool, nullptr);
+    }
+
+    void* UploadManager::allocate(VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset, VkDeviceSize alignment) {
+        if (size > _ringSize / 2) {
+            // would have to drain most of the ring, a buffer of its own is freed with the batch
+            VkBuffer stagingBuffer;
+            MemoryAllocation stagingMemory;
+            createBuffer(_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                stagingBuffer, stagingMemory, MemoryPool::Transient);
+            this->getCommandBuffer();
+            _current.dedicatedStaging.emplace_back(stagingBuffer, stagingMemory);
+            buffer = stagingBuffer;
+            offset = 0;
+            return stagingMemory.mapped;
+        }
+
+        // the ring is used in order, wrapping skips the bytes left at the end
+        if (_ringUsed == 0) {
+            _ringHead = 0;
+        }
+        VkDeviceSize start = (_ringHead + alignment - 1) / alignment * alignment;
+        VkDeviceSize needed = start - _ringHead + size;
+        if (start + size > _ringSize) {
+            start = 0;
+            needed = _ringSize - _ringHead + size;
+        }
+        while (_ringUsed + needed > _ringSize) {
+            if (_submitted.empty()) {
+                // only the current batch holds ring space
+                this->flush();
+            }
+            this->wait(_submitted.front().value);
+        }
+
+        this->getCommandBuffer();
+        _current.ringBytes += needed;
+        _ringUsed += needed;
+        _ringHead = start + size;
+        buffer = _ringBuffer;
+        offset = start;
+        return static_cast<char*>(_ringMemory.mapped) + start;
+    }
+
+    VkCommandBuffer UploadManager::getCommandBuffer() {
+        if (_current.commandBuffer == VK_NULL_HANDLE) {
+            this->beginBatch();
+        }
+        return _current.commandBuffer;
+    }
+
+    void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+        VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+        if (size == 0) {
+            return;
+        }
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        void* staging = this->allocate(size, stagingBuffer, stagingOffset, 4);
+        memcpy(staging, data, static_cast<size_t>(size));
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = offset;
+        region.size = size;
+        vkCmdCopyBuffer(this->getCommandBuffer(), stagingBuffer, buffer, 1, &region);
+        this->releaseBuffer(buffer, offset, size, dstAccess, dstStage);
+        _uploadedBytes += size;
+    }
+
+    void UploadManager::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags dstAccess,
+        VkPipelineStageFlags dstStage) {
+        this->getCommandBuffer();
+        _acquireStages |= dstStage;
+        if (!this->hasDedicatedQueue()) {
+            // same family: waiting on the timeline makes the writes visible, no barrier needed
+            return;
+        }
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = _transferFamily;
+        barrier.dstQueueFamilyIndex = _graphicsFamily;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+        _current.bufferReleases.push_back(barrier);
+
+        // the matching acquire, on the graphics queue
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+        _bufferAcquires.push_back(barrier);
+    }
+
+    void UploadManager::releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout,
+        VkImageLayout newLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+        this->getCommandBuffer();
+        _acquireStages |= dstStage;
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = this->hasDedicatedQueue() ? _transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = this->hasDedicatedQueue() ? _graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = range;
+        // same family: the layout still has to change, visibility comes from the timeline wait
+        _current.imageReleases.push_back(barrier);
+
+        if (this->hasDedicatedQueue()) {
+            // the acquire repeats the layout transition, it only happens once
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dstAccess;
+            _imageAcquires.push_back(barrier);
+        }
+    }
+
+    uint64_t UploadManager::flush() {
+        if (_current.commandBuffer == VK_NULL_HANDLE) {
+            return _submittedValue;
+        }
+        VkCommandBuffer commandBuffer = _current.commandBuffer;
+        if (!_current.bufferReleases.empty() || !_current.imageReleases.empty()) {
+            // releases only need the copies to be done, the signal operation covers the rest
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                0, nullptr,
+                static_cast<uint32_t>(_current.bufferReleases.size()), _current.bufferReleases.data(),
+                static_cast<uint32_t>(_current.imageReleases.size()), _current.imageReleases.data());
+        }
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record upload command buffer!");
+        }
+
+        _current.value = ++_submittedValue;
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &_current.value;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &_timeline;
+        if (vkQueueSubmit(_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+
+        _current.bufferReleases.clear();
+        _current.imageReleases.clear();
+        _submitted.push_back(std::move(_current));
+        _current = Batch();
+        _batchCount++;
+        return _submittedValue;
+    }
+
+    uint64_t UploadManager::getCompletedValue() {
+        uint64_t value;
+        if (vkGetSemaphoreCounterValue(_device, _timeline, &value) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to read upload timeline semaphore!");
+        }
+        while (!_submitted.empty() && _submitted.front().value <= value) {
+            this->retire(_submitted.front());
+            _submitted.pop_front();
+        }
+        _completedValue = value;
+        return _completedValue;
+    }
+
+    void UploadManager::wait(uint64_t value) {
+        if (value > _completedValue) {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &_timeline;
+            waitInfo.pValues = &value;
+            if (vkWaitSemaphores(_device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to wait for upload batch!");
+            }
+        }
+        this->getCompletedValue();
+    }
+
+    uint64_t UploadManager::acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags& waitStage) {
+        this->flush();
+        if (_acquiredValue == _submittedValue) {
+            return 0;
+        }
+        // stages the uploads are used in, top of pipe does not hold anything up
+        waitStage = _acquireStages != 0 ? _acquireStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        if (!_bufferAcquires.empty() || !_imageAcquires.empty()) {
+            vkCmdPipelineBarrier(commandBuffer,
+                waitStage, waitStage, 0,
+                0, nullptr,
+                static_cast<uint32_t>(_bufferAcquires.size()), _bufferAcquires.data(),
+                static_cast<uint32_t>(_imageAcquires.size()), _imageAcquires.data());
+        }
+        _bufferAcquires.clear();
+        _imageAcquires.clear();
+        _acquireStages = 0;
+        _acquiredValue = _submittedValue;
+        return _acquiredValue;
+    }
+
+    void UploadManager::synchronize(VkCommandPool graphicsCommandPool, const std::function<void(VkCommandBuffer)>& record) {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands(_device, graphicsCommandPool);
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        uint64_t waitValue = this->acquire(commandBuffer, waitStage);
+        if (record) {
+            if (waitValue > 0) {
+                // the acquire only covers the stages the uploads were meant for, the recorded
+                // commands may use them anywhere
+                VkMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                vkCmdPipelineBarrier(commandBuffer, waitStage, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                    1, &barrier, 0, nullptr, 0, nullptr);
+            }
+            record(commandBuffer);
+        }
+        vkEndCommandBuffer(commandBuffer);
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (waitValue > 0) {
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &_timeline;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
+        if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _synchronizeFence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload synchronization!");
+        }
+        vkWaitForFences(_device, 1, &_synchronizeFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(_device, 1, &_synchronizeFence);
+        vkFreeCommandBuffers(_device, graphicsCommandPool, 1, &commandBuffer);
+        this->getCompletedValue();
+    }
+
+    void UploadManager::beginBatch() {
+        this->getCompletedValue();
+        if (_freeCommandBuffers.empty()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = _commandPool;
+            allocInfo.commandBufferCount = 1;
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate upload command buffer!");
+            }
+            _freeCommandBuffers.push_back(commandBuffer);
+        }
+        _current.commandBuffer = _freeCommandBuffers.back();
+        _freeCommandBuffers.pop_back();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(_current.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin upload command buffer!");
+        }
+    }
+
+    void UploadManager::retire(Batch& batch) {
+        _ringUsed -= batch.ringBytes;
+        for (auto& staging : batch.dedicatedStaging) {
+            vkDestroyBuffer(_device, staging.first, nullptr);
+            _allocator->free(staging.second);
+        }
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+        _freeCommandBuffers.push_back(batch.commandBuffer);
+    }
+
+}
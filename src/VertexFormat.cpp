@@ -0,0 +1,225 @@
+#include <VertexFormat.h>
+#include <objects/SkipObject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace Skip {
+
+    namespace {
+
+        uint16_t floatToHalf(float value) {
+            // round to nearest even, out of range values become infinity
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            uint32_t sign = (bits >> 16) & 0x8000;
+            uint32_t floatExponent = (bits >> 23) & 0xff;
+            int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+            uint32_t mantissa = bits & 0x7fffff;
+            if (floatExponent == 0xff) {
+                return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+            }
+            if (exponent >= 31) {
+                return static_cast<uint16_t>(sign | 0x7c00);
+            }
+            uint32_t shift = 13;
+            uint32_t half;
+            if (exponent <= 0) {
+                // subnormal half
+                if (exponent < -10) {
+                    return static_cast<uint16_t>(sign);
+                }
+                mantissa |= 0x800000;
+                shift = static_cast<uint32_t>(14 - exponent);
+                half = mantissa >> shift;
+            } else {
+                half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+            }
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1))) {
+                half++; // a carry into the exponent is still the right result
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t packSnorm16(const glm::vec2& value) {
+            auto pack = [](float component) {
+                float clamped = std::min(std::max(component, -1.0f), 1.0f);
+                return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::round(clamped * 32767.0f))));
+            };
+            return pack(value.x) | (pack(value.y) << 16);
+        }
+
+        uint32_t packUnorm8(const glm::vec3& color) {
+            auto pack = [](float component) {
+                return static_cast<uint32_t>(std::round(std::min(std::max(component, 0.0f), 1.0f) * 255.0f));
+            };
+            return pack(color.x) | (pack(color.y) << 8) | (pack(color.z) << 16) | (255u << 24);
+        }
+
+        float signNotZero(float value) {
+            return value >= 0.0f ? 1.0f : -1.0f;
+        }
+
+    }
+
+    VkVertexInputBindingDescription Vertex::getBindingDescription() {
+        // manage attribute binding per vertex
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0; // specifies the index of the binding in the array of bindings
+        bindingDescription.stride = sizeof(Vertex); // number of bytes from one entry to next
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    std::array<VkVertexInputAttributeDescription, 5> Vertex::getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+        // we have two attributes: position and color (hence the size)
+        attributeDescriptions[0].binding = 0; // binding the per-vertex data
+        attributeDescriptions[0].location = 0; // location directive of the input in the vertex shader
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; // type of data (look at reference guide)
+        attributeDescriptions[0].offset = offsetof(Vertex, position); // specifies the number of bytes since the start of the per-vertex data
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+        attributeDescriptions[3].binding = 0;
+        attributeDescriptions[3].location = 3;
+        attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[3].offset = offsetof(Vertex, normal);
+
+        attributeDescriptions[4].binding = 0;
+        attributeDescriptions[4].location = 4;
+        attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[4].offset = offsetof(Vertex, tangent);
+
+        return attributeDescriptions;
+    }
+
+    const char* getVertexFormatName(VertexFormat format) {
+        switch (format) {
+        case VertexFormat::Full:
+            return "full";
+        case VertexFormat::Compact:
+            return "compact";
+        case VertexFormat::CompactColor:
+            return "compact-color";
+        }
+        return "unknown";
+    }
+
+    uint32_t getVertexStride(VertexFormat format) {
+        switch (format) {
+        case VertexFormat::Full:
+            return sizeof(Vertex);
+        case VertexFormat::Compact:
+            return offsetof(CompactVertex, color);
+        case VertexFormat::CompactColor:
+            return sizeof(CompactVertex);
+        }
+        throw std::runtime_error("Unknown vertex format!");
+    }
+
+    VkVertexInputBindingDescription getVertexBindingDescription(VertexFormat format) {
+        VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
+        bindingDescription.stride = getVertexStride(format);
+        return bindingDescription;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> getVertexAttributeDescriptions(VertexFormat format) {
+        if (format == VertexFormat::Full) {
+            auto attributeDescriptions = Vertex::getAttributeDescriptions();
+            return std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end());
+        }
+        // same locations as Vertex, see compact.vert for the decode
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {
+            { 0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactVertex, position) },
+            { 2, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, texCoord) },
+            { 3, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) },
+            { 4, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, tangent) }
+        };
+        if (format == VertexFormat::CompactColor) {
+            attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+        }
+        return attributeDescriptions;
+    }
+
+    glm::vec2 encodeOctahedral(const glm::vec3& vector) {
+        float sum = std::fabs(vector.x) + std::fabs(vector.y) + std::fabs(vector.z);
+        if (sum == 0.0f) {
+            return glm::vec2(0.0f, 0.0f);
+        }
+        glm::vec2 encoded(vector.x / sum, vector.y / sum);
+        if (vector.z < 0.0f) {
+            // fold the lower half over the diagonals
+            encoded = glm::vec2((1.0f - std::fabs(encoded.y)) * signNotZero(encoded.x),
+                (1.0f - std::fabs(encoded.x)) * signNotZero(encoded.y));
+        }
+        return encoded;
+    }
+
+    glm::vec3 decodeOctahedral(const glm::vec2& encoded) {
+        glm::vec3 vector(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+        if (vector.z < 0.0f) {
+            float x = vector.x;
+            vector.x = (1.0f - std::fabs(vector.y)) * signNotZero(x);
+            vector.y = (1.0f - std::fabs(x)) * signNotZero(vector.y);
+        }
+        float length = std::sqrt(vector.x * vector.x + vector.y * vector.y + vector.z * vector.z);
+        return glm::vec3(vector.x / length, vector.y / length, vector.z / length);
+    }
+
+    void packVertices(VertexFormat format, const Vertex* vertices, size_t vertexCount, std::vector<uint8_t>& packed,
+        VertexDecodePushConstants& decode) {
+        uint32_t stride = getVertexStride(format);
+        packed.resize(vertexCount * stride);
+        decode = VertexDecodePushConstants{};
+        if (format == VertexFormat::Full) {
+            memcpy(packed.data(), vertices, packed.size());
+            return;
+        }
+        if (vertexCount == 0) {
+            return;
+        }
+
+        glm::vec3 boundsMin = vertices[0].position;
+        glm::vec3 boundsMax = vertices[0].position;
+        for (size_t i = 1; i < vertexCount; i++) {
+            boundsMin = glm::min(boundsMin, vertices[i].position);
+            boundsMax = glm::max(boundsMax, vertices[i].position);
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        decode.positionOffset = glm::vec4(boundsMin, 0.0f);
+        decode.positionScale = glm::vec4(extent, 0.0f);
+
+        for (size_t i = 0; i < vertexCount; i++) {
+            const Vertex& vertex = vertices[i];
+            CompactVertex compact{};
+            for (int axis = 0; axis < 3; axis++) {
+                // flat meshes have no extent along one axis
+                float t = extent[axis] > 0.0f ? (vertex.position[axis] - boundsMin[axis]) / extent[axis] : 0.0f;
+                compact.position[axis] = static_cast<uint16_t>(std::round(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f));
+            }
+            compact.normal = packSnorm16(encodeOctahedral(vertex.normal));
+            compact.tangent = packSnorm16(encodeOctahedral(vertex.tangent));
+            compact.texCoord = static_cast<uint32_t>(floatToHalf(vertex.texCoord.x))
+                | (static_cast<uint32_t>(floatToHalf(vertex.texCoord.y)) << 16);
+            compact.color = packUnorm8(vertex.color);
+            // the Compact stride ends before color
+            memcpy(packed.data() + i * stride, &compact, stride);
+        }
+    }
+
+}
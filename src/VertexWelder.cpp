@@ -0,0 +1,323 @@
+#include <VertexWelder.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace Skip {
+
+    VertexWelder::VertexWelder(size_t expectedVertices, float tolerance) {
+        _tolerance = std::max(tolerance, 0.0f);
+        _inverseTolerance = _tolerance > 0.0f ? 1.0f / _tolerance : 0.0f;
+        size_t capacity = 16;
+        while (capacity < expectedVertices * 2) {
+            capacity *= 2;
+        }
+        _slots.assign(capacity, EMPTY);
+        _tags.assign(capacity, 0);
+        _hashes.reserve(expectedVertices);
+    }
+
+    VertexWelder::Key VertexWelder::makeKey(const Vertex& vertex) {
+        const float values[] = {
+            vertex.position.x, vertex.position.y, vertex.position.z,
+            vertex.color.x, vertex.color.y, vertex.color.z,
+            vertex.texCoord.x, vertex.texCoord.y,
+            vertex.normal.x, vertex.normal.y, vertex.normal.z,
+            vertex.tangent.x, vertex.tangent.y, vertex.tangent.z
+        };
+        Key key;
+        for (size_t i = 0; i < key.size(); i++) {
+            // -0 and 0 compare equal, so they have to hash the same
+            float value = values[i] + 0.0f;
+            memcpy(&key[i], &value, sizeof(value));
+        }
+        return key;
+    }
+
+    uint64_t VertexWelder::hashKey(const Key& key) {
+        uint64_t hash = 0x9e3779b97f4a7c15ull;
+        for (uint32_t value : key) {
+            hash ^= value;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+        }
+        // murmur3 finalizer, spreads every input bit over the whole hash
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    uint64_t VertexWelder::hashCell(int32_t x, int32_t y, int32_t z) {
+        Key key{};
+        key[0] = static_cast<uint32_t>(x);
+        key[1] = static_cast<uint32_t>(y);
+        key[2] = static_cast<uint32_t>(z);
+        return hashKey(key);
+    }
+
+    bool VertexWelder::isNearby(const Vertex& a, const Vertex& b, float tolerance) {
+        auto near3 = [tolerance](const glm::vec3& u, const glm::vec3& v) {
+            return std::fabs(u.x - v.x) <= tolerance && std::fabs(u.y - v.y) <= tolerance && std::fabs(u.z - v.z) <= tolerance;
+        };
+        return near3(a.position, b.position) && near3(a.color, b.color) && near3(a.normal, b.normal)
+            && near3(a.tangent, b.tangent)
+            && std::fabs(a.texCoord.x - b.texCoord.x) <= tolerance && std::fabs(a.texCoord.y - b.texCoord.y) <= tolerance;
+    }
+
+    uint32_t VertexWelder::add(const Vertex& vertex, std::vector<Vertex>& vertices) {
+        // vertices is only ever appended to through add, so welded vertex i is vertices[i]
+        if ((_hashes.size() + 1) * 2 > _slots.size()) {
+            this->grow();
+        }
+        if (_tolerance > 0.0f) {
+            return this->addNearby(vertex, vertices);
+        }
+        Key key = makeKey(vertex);
+        uint64_t hash = hashKey(key);
+        uint32_t tag = static_cast<uint32_t>(hash);
+        size_t mask = _slots.size() - 1;
+        for (size_t slot = static_cast<size_t>(hash >> 32) & mask; ; slot = (slot + 1) & mask) {
+            uint32_t index = _slots[slot];
+            if (index == EMPTY) {
+                index = static_cast<uint32_t>(_hashes.size());
+                _slots[slot] = index;
+                _tags[slot] = tag;
+                _hashes.push_back(hash);
+                vertices.push_back(vertex);
+                return index;
+            }
+            if (_tags[slot] == tag && makeKey(vertices[index]) == key) {
+                return index;
+            }
+        }
+    }
+
+    uint32_t VertexWelder::addNearby(const Vertex& vertex, std::vector<Vertex>& vertices) {
+        // Anything within the tolerance has its position in this cell or one of its neighbours. The
+        // table holds every welded vertex under its cell's hash, several per cell
+        int32_t cell[3];
+        for (int axis = 0; axis < 3; axis++) {
+            // far out values share the outermost cells
+            double value = std::floor(static_cast<double>(vertex.position[axis]) * _inverseTolerance);
+            cell[axis] = static_cast<int32_t>(std::min(std::max(value, -2147483647.0), 2147483646.0));
+        }
+
+        size_t mask = _slots.size() - 1;
+        uint32_t match = EMPTY;
+        for (int32_t z = cell[2] - 1; z <= cell[2] + 1; z++) {
+            for (int32_t y = cell[1] - 1; y <= cell[1] + 1; y++) {
+                for (int32_t x = cell[0] - 1; x <= cell[0] + 1; x++) {
+                    uint64_t hash = hashCell(x, y, z);
+                    uint32_t tag = static_cast<uint32_t>(hash);
+                    for (size_t slot = static_cast<size_t>(hash >> 32) & mask; _slots[slot] != EMPTY; slot = (slot + 1) & mask) {
+                        uint32_t index = _slots[slot];
+                        // the earliest match wins, so the result only depends on the stream order
+                        if (_tags[slot] == tag && index < match && isNearby(vertices[index], vertex, _tolerance)) {
+                            match = index;
+                        }
+                    }
+                }
+            }
+        }
+        if (match != EMPTY) {
+            return match;
+        }
+
+        uint32_t index = static_cast<uint32_t>(_hashes.size());
+        uint64_t hash = hashCell(cell[0], cell[1], cell[2]);
+        this->insert(hash, index);
+        _hashes.push_back(hash);
+        vertices.push_back(vertex);
+        return index;
+    }
+
+    void VertexWelder::clear() {
+        std::fill(_slots.begin(), _slots.end(), EMPTY);
+        _hashes.clear();
+    }
+
+    void VertexWelder::grow() {
+        _slots.assign(_slots.size() * 2, EMPTY);
+        _tags.assign(_slots.size(), 0);
+        for (size_t index = 0; index < _hashes.size(); index++) {
+            this->insert(_hashes[index], static_cast<uint32_t>(index));
+        }
+    }
+
+    void VertexWelder::insert(uint64_t hash, uint32_t index) {
+        size_t mask = _slots.size() - 1;
+        size_t slot = static_cast<size_t>(hash >> 32) & mask;
+        while (_slots[slot] != EMPTY) {
+            slot = (slot + 1) & mask;
+        }
+        _slots[slot] = index;
+        _tags[slot] = static_cast<uint32_t>(hash);
+    }
+
+    void weldVertices(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        float tolerance, ThreadPool* threads) {
+        if (tolerance > 0.0f || threads == nullptr || stream.size() < PARALLEL_WELD_THRESHOLD) {
+            weldVerticesHashed(stream, vertices, indices, tolerance);
+            return;
+        }
+        weldVerticesSorted(stream, vertices, indices, threads);
+    }
+
+    void weldVerticesHashed(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        float tolerance) {
+        vertices.clear();
+        indices.clear();
+        indices.reserve(stream.size());
+        // triangle meshes usually end up with far fewer vertices than corners
+        VertexWelder welder(stream.size() / 4, tolerance);
+        for (const Vertex& vertex : stream) {
+            indices.push_back(welder.add(vertex, vertices));
+        }
+    }
+
+    void weldVerticesSorted(const std::vector<Vertex>& stream, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+        ThreadPool* threads) {
+        // Hash every vertex, radix sort (hash, index) pairs so duplicates end up next to each
+        // other, and point every vertex at the first index with the same key. Each step works
+        // on independent chunks of the stream
+        size_t count = stream.size();
+        if (count >= 0xffffffffull) {
+            throw std::runtime_error("Too many vertices to weld!");
+        }
+        vertices.clear();
+        indices.assign(count, 0);
+        if (count == 0) {
+            return;
+        }
+
+        uint32_t chunkCount = threads != nullptr ? (threads->getThreadCount() + 1) * 4 : 1;
+        chunkCount = static_cast<uint32_t>(std::min<size_t>(chunkCount, count));
+        size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        auto chunkStart = [count, chunkSize](uint32_t chunk) {
+            return std::min(count, chunk * chunkSize);
+        };
+        auto parallel = [threads, chunkCount](const std::function<void(uint32_t)>& job) {
+            if (threads != nullptr) {
+                threads->parallelFor(chunkCount, job);
+            } else {
+                for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                    job(chunk);
+                }
+            }
+        };
+
+        std::vector<uint64_t> hashes(count);
+        std::vector<uint64_t> sortedHashes(count);
+        std::vector<uint32_t> order(count);
+        std::vector<uint32_t> sortedOrder(count);
+        parallel([&](uint32_t chunk) {
+            for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                hashes[i] = VertexWelder::hashKey(VertexWelder::makeKey(stream[i]));
+                order[i] = static_cast<uint32_t>(i);
+            }
+        });
+
+        // LSD radix sort, 8 bits per pass. Stable, so equal hashes stay in index order
+        std::vector<std::array<uint32_t, 256>> offsets(chunkCount);
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            parallel([&](uint32_t chunk) {
+                std::array<uint32_t, 256>& histogram = offsets[chunk];
+                histogram.fill(0);
+                for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                    histogram[(hashes[i] >> shift) & 0xff]++;
+                }
+            });
+            // every chunk scatters into its own range of each bucket
+            uint32_t offset = 0;
+            for (size_t digit = 0; digit < 256; digit++) {
+                for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                    uint32_t bucketCount = offsets[chunk][digit];
+                    offsets[chunk][digit] = offset;
+                    offset += bucketCount;
+                }
+            }
+            parallel([&](uint32_t chunk) {
+                std::array<uint32_t, 256>& position = offsets[chunk];
+                for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                    uint32_t target = position[(hashes[i] >> shift) & 0xff]++;
+                    sortedHashes[target] = hashes[i];
+                    sortedOrder[target] = order[i];
+                }
+            });
+            std::swap(hashes, sortedHashes);
+            std::swap(order, sortedOrder);
+        }
+        sortedHashes = std::vector<uint64_t>();
+
+        // representative[i] is the first vertex with the same key as vertex i
+        std::vector<uint32_t> representative(count);
+        parallel([&](uint32_t chunk) {
+            // a run of equal hashes is handled by the chunk it starts in
+            size_t begin = chunkStart(chunk);
+            size_t end = chunkStart(chunk + 1);
+            while (begin > 0 && begin < end && hashes[begin] == hashes[begin - 1]) {
+                begin++;
+            }
+            while (end > begin && end < count && hashes[end] == hashes[end - 1]) {
+                end++;
+            }
+            for (size_t runBegin = begin; runBegin < end;) {
+                size_t runEnd = runBegin + 1;
+                while (runEnd < end && hashes[runEnd] == hashes[runBegin]) {
+                    runEnd++;
+                }
+                representative[order[runBegin]] = order[runBegin];
+                for (size_t i = runBegin + 1; i < runEnd; i++) {
+                    uint32_t vertex = order[i];
+                    representative[vertex] = vertex;
+                    // almost always equal to the run's first vertex, other keys only on collisions
+                    VertexWelder::Key key = VertexWelder::makeKey(stream[vertex]);
+                    for (size_t j = runBegin; j < i; j++) {
+                        uint32_t other = order[j];
+                        if (representative[other] == other && VertexWelder::makeKey(stream[other]) == key) {
+                            representative[vertex] = other;
+                            break;
+                        }
+                    }
+                }
+                runBegin = runEnd;
+            }
+        });
+
+        // number the representatives in stream order, reusing order for the new indices
+        std::vector<uint32_t>& remap = order;
+        std::vector<uint32_t> chunkFirst(chunkCount + 1, 0);
+        parallel([&](uint32_t chunk) {
+            uint32_t unique = 0;
+            for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                unique += representative[i] == i ? 1 : 0;
+            }
+            chunkFirst[chunk + 1] = unique;
+        });
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+            chunkFirst[chunk + 1] += chunkFirst[chunk];
+        }
+        vertices.resize(chunkFirst[chunkCount]);
+        parallel([&](uint32_t chunk) {
+            uint32_t next = chunkFirst[chunk];
+            for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                if (representative[i] == i) {
+                    remap[i] = next;
+                    vertices[next] = stream[i];
+                    next++;
+                }
+            }
+        });
+        parallel([&](uint32_t chunk) {
+            for (size_t i = chunkStart(chunk); i < chunkStart(chunk + 1); i++) {
+                indices[i] = remap[representative[i]];
+            }
+        });
+    }
+
+}
@@ -22,21 +22,47 @@ namespace Skip {
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+        std::optional<uint32_t> fallbackTransferFamily;
         int i = 0;
         for (const auto& queueFamily : queueFamilies) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
                 indices.graphicsFamily = i;
             }
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-            if (presentSupport) {
-                indices.presentFamily = i;
+            if (surface == VK_NULL_HANDLE) {
+                // headless: nothing is presented so the graphics family stands in for present
+                if (indices.graphicsFamily.has_value()) {
+                    indices.presentFamily = indices.graphicsFamily;
+                }
+            } else {
+                VkBool32 presentSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+                // prefer presenting from the graphics family
+                if (presentSupport && (!indices.presentFamily.has_value() || indices.graphicsFamily == static_cast<uint32_t>(i))) {
+                    indices.presentFamily = i;
+                }
             }
-            if (indices.isComplete()) {
-                break;
+
+            // Transfer only families are the DMA engines, they copy alongside rendering. Their image
+            // copies can be restricted to a coarser granularity, which mip tails do not fit
+            VkExtent3D granularity = queueFamily.minImageTransferGranularity;
+            bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+                && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+            bool fineGranularity = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+            if (transferOnly && fineGranularity && !indices.transferFamily.has_value()) {
+                indices.transferFamily = i;
+            }
+            // otherwise an async compute family, compute queues can copy as well and still run
+            // next to the graphics queue
+            bool asyncCopy = (queueFamily.queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))
+                && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            if (asyncCopy && fineGranularity && !fallbackTransferFamily.has_value()) {
+                fallbackTransferFamily = i;
             }
             i++;
         }
+        if (!indices.transferFamily.has_value()) {
+            indices.transferFamily = fallbackTransferFamily.has_value() ? fallbackTransferFamily : indices.graphicsFamily;
+        }
         return indices;
     }
 
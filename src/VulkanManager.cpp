@@ -129,11 +129,14 @@ namespace Skip {
     }
 
     std::vector<const char*> VulkanManager::getRequiredExtensions() {
-        //GLFW extensions!
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char*> extensions;
+        if (!_window->_headless) {
+            //GLFW extensions!
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
         if (_enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
@@ -191,6 +194,10 @@ namespace Skip {
     }
 
     void VulkanManager::createSurface() {
+        if (_window->_headless) {
+            // offscreen rendering does not need a surface
+            return;
+        }
         if (glfwCreateWindowSurface(_instance, _window->_glfw, nullptr, &(_window->_surface)) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create window surface!");
         }
@@ -243,6 +250,31 @@ namespace Skip {
         score += deviceProperties.limits.maxImageDimension2D;
         gpuInfo.device = device;
         gpuInfo.features = deviceFeatures;
+        if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceVulkan12Features vulkan12Features{};
+            vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &vulkan12Features;
+            vkGetPhysicalDeviceFeatures2(device, &features2);
+
+            VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+            indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties2{};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &indexingProperties;
+            vkGetPhysicalDeviceProperties2(device, &properties2);
+
+            // textures are added to the array while frames using it are in flight
+            gpuInfo.descriptorIndexing = deviceFeatures.shaderSampledImageArrayDynamicIndexing
+                && vulkan12Features.runtimeDescriptorArray
+                && vulkan12Features.descriptorBindingPartiallyBound
+                && vulkan12Features.descriptorBindingSampledImageUpdateAfterBind
+                && vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+            gpuInfo.maxBindlessTextures = std::min(indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+            gpuInfo.timelineSemaphore = vulkan12Features.timelineSemaphore;
+        }
         gpuInfo.properties = deviceProperties;
         gpuInfo.msaaSamples = getMaxUsableSampleCount(device);
         gpuInfo.score = score;
@@ -267,9 +299,14 @@ namespace Skip {
     }
 
     GPUInfo* VulkanManager::pickPhysicalDevice() {
-        // we pick the first device we have by default
+        // we pick the best scored device that has everything we need
+        for (GPUInfo& gpu : _gpuDevices) {
+            if (gpu.timelineSemaphore) {
+                return &gpu;
+            }
+        }
         if (_gpuDevices.size() > 0) {
-            return &_gpuDevices.front();
+            throw std::runtime_error("Failed to find a suitable GPU, Vulkan 1.2 with timeline semaphores is required!");
         } else {
             throw std::runtime_error("Failed to find a suitable GPU!");
         }
@@ -283,12 +320,12 @@ namespace Skip {
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
         std::set<uint32_t> uniqueQueueFamilies =
-        { indices.graphicsFamily.value(), indices.presentFamily.value() };
+        { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies) {
             VkDeviceQueueCreateInfo queueCreateInfo{};
             queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+            queueCreateInfo.queueFamilyIndex = queueFamily;
             queueCreateInfo.queueCount = 1;
             queueCreateInfo.pQueuePriorities = &queuePriority;
             queueCreateInfos.push_back(queueCreateInfo);
@@ -298,6 +335,11 @@ namespace Skip {
         //specify device features like geometry shaders and anisotropy
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // .ktx2 textures in BCn formats, loaded as png otherwise
+        deviceFeatures.textureCompressionBC = _vulkanDevice->_gpuInfo->features.textureCompressionBC;
+        bool descriptorIndexing = _vulkanDevice->_gpuInfo->descriptorIndexing;
+        // the bindless mode indexes its texture array with a push constant
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = descriptorIndexing;
         //deviceFeatures.sampleRateShading = VK_TRUE; // enable simple shading feature
 
         // create logical device
@@ -308,9 +350,26 @@ namespace Skip {
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
+        // core in 1.2, UploadManager tracks its batches with a timeline semaphore. pickPhysicalDevice
+        // only returns devices that have it
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+        // bindless mode, see VulkanSwapchain::setBindless
+        vulkan12Features.runtimeDescriptorArray = descriptorIndexing;
+        vulkan12Features.descriptorBindingPartiallyBound = descriptorIndexing;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = descriptorIndexing;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = descriptorIndexing;
+        createInfo.pNext = &vulkan12Features;
+
         // enable extensions - currently enable swap chain
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // headless rendering never presents so the swap chain extension is not required
+        std::vector<const char*> enabledExtensions;
+        if (!_window->_headless) {
+            enabledExtensions = deviceExtensions;
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (_enableValidationLayers) {
             createInfo.enabledLayerCount =
@@ -324,8 +383,13 @@ namespace Skip {
         if (vkCreateDevice(_vulkanDevice->getPhysicalDevice(), &createInfo, nullptr, &_vulkanDevice->_logicalDevice) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create logical device");
         }
-        vkGetDeviceQueue(_vulkanDevice->_logicalDevice, indices.presentFamily.value(), 0, &_vulkanDevice->_queues.graphics);
+        vkGetDeviceQueue(_vulkanDevice->_logicalDevice, indices.graphicsFamily.value(), 0, &_vulkanDevice->_queues.graphics);
         vkGetDeviceQueue(_vulkanDevice->_logicalDevice, indices.presentFamily.value(), 0, &_vulkanDevice->_queues.present);
+        // the graphics queue itself when no other family can copy
+        vkGetDeviceQueue(_vulkanDevice->_logicalDevice, indices.transferFamily.value(), 0, &_vulkanDevice->_queues.transfer);
+        _vulkanDevice->_queueFamilies = indices;
+
+        _vulkanDevice->_allocator = new DeviceAllocator(_vulkanDevice->_logicalDevice, _vulkanDevice->getPhysicalDevice());
     }
 
     
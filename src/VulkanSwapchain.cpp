@@ -1,4 +1,10 @@
 #include <VulkanSwapchain.h>
+#include <CpuProfiler.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -6,8 +12,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
+#include <cstddef>
+
 namespace Skip {
 
+    static_assert(offsetof(BindlessObjectData, light) == 256 && offsetof(BindlessObjectData, decode) == 400
+        && offsetof(BindlessObjectData, textureIndex) == 432 && sizeof(BindlessObjectData) == 448,
+        "BindlessObjectData has to match ObjectData in bindless.glsl");
+
     VulkanSwapchain::VulkanSwapchain() {};
 
     VulkanSwapchain::VulkanSwapchain(VulkanDevice* vkDevice, VulkanWindow* vkWindow, VkInstance* instance, SkipScene* scene) {
@@ -16,88 +28,119 @@ namespace Skip {
         _instance = instance;
         _scene = scene;
         _currentFrame = 0;
+        _headless = vkWindow->_headless;
 
         this->createSwapChain();
         this->createImageViews();
         this->createRenderPass();
-        this->createPipelineCache();
+        this->loadPipelineCache();
         this->createDescriptorSetLayout();
+        // sized for one per texture set: two dynamic ubos and a sampler
+        _descriptorAllocator = new DescriptorAllocator(*_vkDevice->getLogicalDevice(), {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 } }, _framesInFlight);
         this->createCommandPool();
 
         this->createGraphicsPipeline();
 
         this->initImgui();
+        // both caches have it now
+        _pipelineCacheData.clear();
+        _pipelineCacheData.shrink_to_fit();
+
+        _recordThreads = new ThreadPool(_recordThreadCount - 1, "record");
 
         this->createColorResources();
         this->createDepthResources();
         this->createFramebuffers();
-        this->createTextureImages();
-        this->createTextureImageViews();
+        // loading already goes through it
+        _uploads = new UploadManager(_vkDevice);
+        _textureCache = new TextureCache(*_vkDevice->getLogicalDevice(), _vkDevice->_allocator,
+            _vkDevice->_gpuInfo->properties.limits.maxSamplerAnisotropy);
+        this->loadAssets();
         this->createTextureSamplers();
-        this->loadObjects();
-        this->createVertexBuffers();
-        this->createIndexBuffers();
-        this->createUniformBuffers();
-        this->createDescriptorPool();
-        this->createDescriptorSets();
-        this->createSyncObjects();
-
-        this->allocateCommandBuffers();
-        this->buildCommandBuffers();
-        
+        this->createGeometryBuffer();
+        this->createFrameResources();
+        // from here on objects come and go one at a time
+        _scene->_objectAdded = [this](SkipObject* object) { this->addSceneObject(object); };
+        _scene->_objectRemoved = [this](SkipObject* object) { this->removeSceneObject(object); };
     };
 
     VulkanSwapchain::~VulkanSwapchain() {
+        _scene->_objectAdded = nullptr;
+        _scene->_objectRemoved = nullptr;
 
         vkDeviceWaitIdle(*_vkDevice->getLogicalDevice());
         this->cleanupSwapChain();
+        this->destroyFrameResources();
         
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        // before the UI cache goes away with the context
+        this->savePipelineCache();
         _imguiContext->DestroyImguiContext(logicalDevice);
+        // submits and waits for the last batch while everything it writes to still exists
+        delete _uploads;
         
         for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            vkDestroySampler(logicalDevice, _scene->_objects[i]->_textureSampler, nullptr);
-            vkDestroyImageView(logicalDevice, _scene->_objects[i]->_textureImageView, nullptr);
-
-            vkDestroyImage(logicalDevice, _scene->_objects[i]->_textureImage, nullptr);
-            vkFreeMemory(logicalDevice, _scene->_objects[i]->_textureImageMemory, nullptr);
-
-            if (_scene->_objects[i]->_useIndexBuffer) {
-                vkDestroyBuffer(logicalDevice, _scene->_objects[i]->_indexBuffer, nullptr);
-                vkFreeMemory(logicalDevice, _scene->_objects[i]->_indexBufferMemory, nullptr);
-            }
-            vkDestroyBuffer(logicalDevice, _scene->_objects[i]->_vertexBuffer, nullptr);
-            vkFreeMemory(logicalDevice, _scene->_objects[i]->_vertexBufferMemory, nullptr);
+            _textureCache->release(_scene->_objects[i]->getTextureKey());
         }
+        // also the samplers
+        delete _textureCache;
+        for (GeometryBuffer* geometryBuffer : _geometryBuffers) {
+            delete geometryBuffer;
+        }
+        delete _recordThreads;
 
+        delete _descriptorAllocator;
+        vkDestroyDescriptorUpdateTemplate(logicalDevice, _descriptorUpdateTemplate, nullptr);
         vkDestroyDescriptorSetLayout(logicalDevice, _descriptorSetLayout, nullptr);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(logicalDevice, _renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(logicalDevice, _imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(logicalDevice, _inFlightFences[i], nullptr);
-        }
         vkDestroyPipelineCache(logicalDevice, _pipelineCache, nullptr);
         vkDestroyCommandPool(logicalDevice, _commandPool, nullptr);
+        // every sub-allocation is gone by now, release the blocks before the device
+        delete _vkDevice->_allocator;
+        _vkDevice->_allocator = nullptr;
         vkDestroyDevice(logicalDevice, nullptr);
     };
 
     uint32_t VulkanSwapchain::stageFrame() {
+        SKIP_PROFILE_ZONE("stageFrame");
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        //wait for the frame to be finished
-        vkWaitForFences(logicalDevice, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+        auto waitStart = std::chrono::high_resolution_clock::now();
+        // wait until the GPU is done with the last frame that used this slot, with N slots
+        // the CPU only blocks here once it is N frames ahead
+        {
+            SKIP_PROFILE_ZONE("wait for frame slot");
+            vkWaitForFences(logicalDevice, 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+        }
+        // frames complete in submission order, everything up to the slot's last frame is done
+        _completedFrames = std::max(_completedFrames, _slotFrames[_currentFrame]);
+        this->destroyRetiredSwapchains(_completedFrames);
+        this->destroyRetiredResources(_completedFrames);
+        // the slot's last submission has completed so its timestamps are available
+        _gpuProfiler->collect(static_cast<uint32_t>(_currentFrame));
+        _descriptorAllocator->resetFrame(static_cast<uint32_t>(_currentFrame));
+        _gpuFrameTime = _gpuProfiler->getScopes()[_frameScope].last;
 
-        //Aquire image from swap chain
         uint32_t imageIndex;
-        // imageAvailableSemaphore is to be signaled when presentation engine is
-        // finished using engine (VK_NULL_HANDLE could be fence)
-        vkAcquireNextImageKHR(logicalDevice, _swapChain, UINT64_MAX,
-            _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (_headless) {
+            // there is no presentation engine, we cycle through the offscreen images ourselves
+            imageIndex = _offscreenImageIndex;
+            _offscreenImageIndex = (_offscreenImageIndex + 1) % static_cast<uint32_t>(_swapChainImages.size());
+        } else {
+            //Aquire image from swap chain
+            // imageAvailableSemaphore is to be signaled when presentation engine is
+            // finished using engine (VK_NULL_HANDLE could be fence)
+            vkAcquireNextImageKHR(logicalDevice, _swapChain, UINT64_MAX,
+                _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
 
         // Check if a previous frame is using this image (ie theres a fence to wait on)
+        // images can come back out of order so another slot may still be rendering into it
         if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
             vkWaitForFences(logicalDevice, 1, &_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
         }
+        _cpuWaitTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
         // Mark the image as now being in use by this frame
         _imagesInFlight[imageIndex] = _inFlightFences[_currentFrame];
 
@@ -105,36 +148,72 @@ namespace Skip {
     }
 
     void VulkanSwapchain::drawFrame(uint32_t currentImage, float deltaTime) {
-        //TODO debug this draw frame for each frame
+        SKIP_PROFILE_ZONE("drawFrame");
+        // The UI is rebuilt every frame, the scene draws only when they are invalidated
+        _frameTimer = deltaTime;
+        {
+            SKIP_PROFILE_ZONE("imgui newFrame");
+            _imguiContext->newFrame("test", _vkDevice->_gpuInfo->properties.deviceName, _frameTimer, true, _scene->_camera, _gpuProfiler);
+            _imguiContext->updateBuffers(static_cast<uint32_t>(_currentFrame));
+        }
 
-        this->buildCommandBuffers();
+        this->buildCommandBuffers(currentImage);
 
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
 
-        _frameTimer = (float)deltaTime / 1000.0f;
         //Submitting the command buffer
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        VkSemaphore waitSemaphores[] = { _imageAvailableSemaphores[_currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<uint64_t> waitValues; // ignored for the binary semaphores
+        // offscreen images are not handed out by a presentation engine so there is nothing to wait on
+        if (!_headless) {
+            waitSemaphores.push_back(_imageAvailableSemaphores[_currentFrame]);
+            waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            waitValues.push_back(0);
+        }
+        if (_uploadWaitValue > 0) {
+            waitSemaphores.push_back(_uploads->getSemaphore());
+            waitStages.push_back(_uploadWaitStage);
+            waitValues.push_back(_uploadWaitValue);
+        }
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        if (_uploadWaitValue > 0) {
+            submitInfo.pNext = &timelineInfo;
+        }
 
         //specify which command buffers to actually submit for execution
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &_commandBuffers[currentImage];
+        submitInfo.pCommandBuffers = &_commandBuffers[_currentFrame];
 
         // specify which semaphore (renderFinishedSemaphore) to signal
         // once the command buffer has finished executing
         VkSemaphore signalSemaphores[] = { _renderFinishedSemaphores[_currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = _headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         // reset fence before using it
         vkResetFences(logicalDevice, 1, &_inFlightFences[_currentFrame]);
-        if (vkQueueSubmit(_vkDevice->_queues.graphics, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to submit draw command buffer!");
+        {
+            SKIP_PROFILE_ZONE("vkQueueSubmit");
+            if (vkQueueSubmit(_vkDevice->_queues.graphics, 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit draw command buffer!");
+            }
+        }
+        _slotFrames[_currentFrame] = ++_submittedFrames;
+
+        if (_headless) {
+            // no presentation, the in flight fence is all that tracks the frame
+            _currentFrame = (_currentFrame + 1) % _framesInFlight;
+            return;
         }
 
         // Presentation
@@ -156,8 +235,12 @@ namespace Skip {
         // individual swap chain.
         presentInfo.pResults = nullptr; //optional
 
-        VkResult result = vkQueuePresentKHR(_vkDevice->_queues.present, &presentInfo);
-        vkQueueWaitIdle(_vkDevice->_queues.present);
+        // no wait after presenting, the in flight fences throttle the CPU in stageFrame
+        VkResult result;
+        {
+            SKIP_PROFILE_ZONE("vkQueuePresentKHR");
+            result = vkQueuePresentKHR(_vkDevice->_queues.present, &presentInfo);
+        }
         // gives condition if presentation queue is optimal/suboptimal
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
             _framebufferResized = false;
@@ -166,95 +249,263 @@ namespace Skip {
             throw std::runtime_error("Failed to present swap chain image!");
         }
 
-        _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        _currentFrame = (_currentFrame + 1) % _framesInFlight;
 
     }
 
-    void VulkanSwapchain::updateUniformBuffers(uint32_t currentImage) {
-
+    void VulkanSwapchain::updateUniformBuffers() {
+        SKIP_PROFILE_ZONE("updateUniformBuffers");
+        // Objects are written back to back into the current frame slot's region of the
+        // mapped ring. The memory is coherent so there are no driver calls involved
+        if (_scene->_objects.size() > _uniformObjectCapacity) {
+            this->growUniformBuffer(_scene->_objects.size());
+        }
+        char* frameData = static_cast<char*>(_uniformBuffer.mapped) + _currentFrame * _uniformFrameStride;
         for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            void* data;
-            vkMapMemory(*_vkDevice->getLogicalDevice(), _scene->_objects[i]->_mvpUboBuffersMemory[currentImage], 0,
-                sizeof(_scene->_objects[i]->_mvpUBO), 0, &data);
-            memcpy(data, &_scene->_objects[i]->_mvpUBO, sizeof(_scene->_objects[i]->_mvpUBO));
-            vkUnmapMemory(*_vkDevice->getLogicalDevice(), _scene->_objects[i]->_mvpUboBuffersMemory[currentImage]);
+            char* objectData = frameData + i * _uniformObjectStride;
+            memcpy(objectData, &_scene->_objects[i]->_mvpUBO, sizeof(MvpBufferObject));
+            memcpy(objectData + _uniformLightOffset, &_scene->_objects[i]->_lightUBO, sizeof(LightBufferObject));
+            if (_bindless) {
+                // objects move between entries when others are added or removed
+                BindlessObjectData* data = reinterpret_cast<BindlessObjectData*>(objectData);
+                data->decode = _scene->_objects[i]->_vertexDecode;
+                data->textureIndex = _scene->_objects[i]->_bindlessTextureIndex;
+            }
+            if (_scene->_objects[i]->_instanced) {
+                this->updateInstanceBuffer(static_cast<InstancedObject*>(_scene->_objects[i]));
+            }
+        }
+    }
+
+    void VulkanSwapchain::createInstanceBuffer(InstancedObject* object) {
+        // One region per frame slot so instances can change while earlier frames still read them
+        object->_instanceCapacity = std::max(object->_instanceCapacity, object->getInstanceCount());
+        VkDeviceSize size = sizeof(InstanceData) * object->_instanceCapacity * _framesInFlight;
+        createBuffer(_vkDevice->_allocator, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            object->_instanceBuffer, object->_instanceBufferMemory);
+        // a new buffer starts out empty in every region
+        object->_dirtyRanges.assign(_framesInFlight, { 0, object->getInstanceCount() });
+        this->invalidateCommandBuffers();
+    }
+
+    void VulkanSwapchain::destroyInstanceBuffer(InstancedObject* object) {
+        vkDestroyBuffer(*_vkDevice->getLogicalDevice(), object->_instanceBuffer, nullptr);
+        _vkDevice->_allocator->free(object->_instanceBufferMemory);
+        object->_instanceBuffer = VK_NULL_HANDLE;
+        object->_dirtyRanges.clear();
+    }
 
-            vkMapMemory(*_vkDevice->getLogicalDevice(), _scene->_objects[i]->_lightUboBuffersMemory[currentImage], 0,
-                sizeof(_scene->_objects[i]->_lightUBO), 0, &data);
-            memcpy(data, &_scene->_objects[i]->_lightUBO, sizeof(_scene->_objects[i]->_lightUBO));
-            vkUnmapMemory(*_vkDevice->getLogicalDevice(), _scene->_objects[i]->_lightUboBuffersMemory[currentImage]);
+    void VulkanSwapchain::updateInstanceBuffer(InstancedObject* object) {
+        if (object->getInstanceCount() > object->_instanceCapacity) {
+            // every region is too small, frames in flight keep drawing from the old buffer until they complete
+            RetiredResources& retired = this->retireResources();
+            retired.instanceBuffers.push_back(object->_instanceBuffer);
+            retired.instanceBuffersMemory.push_back(object->_instanceBufferMemory);
+            object->_instanceBuffer = VK_NULL_HANDLE;
+            object->_instanceBufferMemory = MemoryAllocation{};
+            object->_instanceCapacity = std::max(object->_instanceCapacity * 2, object->getInstanceCount());
+            this->createInstanceBuffer(object);
         }
+        if (object->getInstanceCount() != object->_recordedInstanceCount) {
+            // the instance count is baked into the recorded draw
+            this->invalidateCommandBuffers();
+        }
+
+        // only the instances changed since this slot was last written are copied
+        std::pair<uint32_t, uint32_t>& dirty = object->_dirtyRanges[_currentFrame];
+        uint32_t end = std::min(dirty.second, object->getInstanceCount());
+        if (dirty.first < end) {
+            char* region = static_cast<char*>(object->_instanceBufferMemory.mapped)
+                + sizeof(InstanceData) * object->_instanceCapacity * _currentFrame;
+            memcpy(region + sizeof(InstanceData) * dirty.first, &object->_instances[dirty.first],
+                sizeof(InstanceData) * (end - dirty.first));
+        }
+        dirty = { 0, 0 };
     }
 
-    void VulkanSwapchain::createPipelineCache() {
-        VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-        pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-        if (vkCreatePipelineCache(*_vkDevice->getLogicalDevice(), &pipelineCacheCreateInfo, nullptr, &_pipelineCache) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline cache!");
+    void VulkanSwapchain::loadPipelineCache() {
+        // Pipelines compiled by earlier runs come back from disk, the UI seeds its cache from the same data
+        _pipelineCacheData = readPipelineCache(_vkDevice->_gpuInfo->properties);
+        _pipelineCache = createPipelineCache(*_vkDevice->getLogicalDevice(), _pipelineCacheData);
+    }
+
+    void VulkanSwapchain::savePipelineCache() {
+        // the UI pipelines are merged in, so one file seeds both caches next time
+        if (!writePipelineCache(*_vkDevice->getLogicalDevice(), _pipelineCache, { _imguiContext->pipelineCache })) {
+            std::cerr << "Could not write the pipeline cache to " << PIPELINE_CACHE_PATH << std::endl;
         }
     }
 
     // recreateSwapChain is called when we draw frames
     void VulkanSwapchain::recreateSwapChain() {
-        int width = 0, height = 0;
-        glfwGetFramebufferSize(_vkWindow->_glfw, &width, &height);
-        while (width == 0 || height == 0) {
-            // minimize makes framebuffer size = 0
-            // we wait until window is maximized to proceed
+        SKIP_PROFILE_ZONE("recreateSwapChain");
+        if (!_headless) {
+            int width = 0, height = 0;
             glfwGetFramebufferSize(_vkWindow->_glfw, &width, &height);
-            glfwWaitEvents();
+            while (width == 0 || height == 0) {
+                // minimize makes framebuffer size = 0
+                // we wait until window is maximized to proceed
+                glfwGetFramebufferSize(_vkWindow->_glfw, &width, &height);
+                glfwWaitEvents();
+            }
         }
-        vkDeviceWaitIdle(*_vkDevice->getLogicalDevice());
+        auto start = std::chrono::high_resolution_clock::now();
 
-        this->cleanupSwapChain();
+        // no device wait, the old resources are destroyed once the frames using them are done
+        VkFormat oldFormat = _swapChainImageFormat;
+        this->retireSwapChain();
+        // the old swap chain is passed on, so the presentation engine can hand its resources over
         this->createSwapChain();
+        if (_swapChainImageFormat != oldFormat) {
+            // the render pass and the pipelines depend on the format, not on the size
+            VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+            vkDeviceWaitIdle(logicalDevice);
+            for (VkPipeline pipeline : _graphicsPipelines) {
+                vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+            }
+            vkDestroyPipeline(logicalDevice, _instancedPipeline, nullptr);
+            vkDestroyPipelineLayout(logicalDevice, _pipelineLayout, nullptr);
+            vkDestroyRenderPass(logicalDevice, _renderPass, nullptr);
+            this->createRenderPass();
+            this->createGraphicsPipeline();
+        }
         this->createImageViews();
-        this->createRenderPass();
-        this->createGraphicsPipeline();
         this->createColorResources();
         this->createDepthResources();
         this->createFramebuffers();
-        this->createUniformBuffers();
-        this->createDescriptorPool();
-        this->createDescriptorSets();
-        this->allocateCommandBuffers();
 
+        // frame slot resources survive the swap chain, only the image tracking starts over
+        _imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+        // the scene secondaries set the viewport from the extent
+        this->invalidateCommandBuffers();
+        _resizeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
     }
 
-    void VulkanSwapchain::cleanupSwapChain() {
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+    void VulkanSwapchain::resize(uint32_t width, uint32_t height) {
+        if (!_headless) {
+            throw std::runtime_error("Windowed swap chains follow the window size!");
+        }
+        _vkWindow->_width = width;
+        _vkWindow->_height = height;
+        this->recreateSwapChain();
+    }
 
-        vkDestroyImageView(logicalDevice, _colorImageView, nullptr);
-        vkDestroyImage(logicalDevice, _colorImage, nullptr);
-        vkFreeMemory(logicalDevice, _colorImageMemory, nullptr);
+    void VulkanSwapchain::retireSwapChain() {
+        // The swap chain handle stays in _swapChain as well, createSwapChain passes it as oldSwapchain
+        RetiredSwapchain retired;
+        retired.frame = _submittedFrames + 1;
+        retired.swapChain = _headless ? VK_NULL_HANDLE : _swapChain;
+        retired.imageViews.swap(_swapChainImageViews);
+        retired.framebuffers.swap(_swapChainFramebuffers);
+        if (_headless) {
+            // offscreen images are owned by us rather than a swap chain
+            retired.offscreenImages.swap(_swapChainImages);
+            retired.offscreenImagesMemory.swap(_offscreenImagesMemory);
+        }
+        retired.colorImage = _colorImage;
+        retired.colorImageMemory = _colorImageMemory;
+        retired.colorImageView = _colorImageView;
+        retired.depthImage = _depthImage;
+        retired.depthImageMemory = _depthImageMemory;
+        retired.depthImageView = _depthImageView;
+        _retiredSwapchains.push_back(std::move(retired));
+    }
 
-        vkDestroyImageView(logicalDevice, _depthImageView, nullptr);
-        vkDestroyImage(logicalDevice, _depthImage, nullptr);
-        vkFreeMemory(logicalDevice, _depthImageMemory, nullptr);
+    void VulkanSwapchain::destroyRetiredSwapchains(uint64_t completedFrame) {
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        auto it = _retiredSwapchains.begin();
+        // retired in frame order
+        for (; it != _retiredSwapchains.end() && it->frame <= completedFrame; ++it) {
+            vkDestroyImageView(logicalDevice, it->colorImageView, nullptr);
+            vkDestroyImage(logicalDevice, it->colorImage, nullptr);
+            _vkDevice->_allocator->free(it->colorImageMemory);
+
+            vkDestroyImageView(logicalDevice, it->depthImageView, nullptr);
+            vkDestroyImage(logicalDevice, it->depthImage, nullptr);
+            _vkDevice->_allocator->free(it->depthImageMemory);
+
+            for (VkFramebuffer framebuffer : it->framebuffers) {
+                vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+            }
+            for (VkImageView imageView : it->imageViews) {
+                vkDestroyImageView(logicalDevice, imageView, nullptr);
+            }
+            for (size_t i = 0; i < it->offscreenImages.size(); i++) {
+                vkDestroyImage(logicalDevice, it->offscreenImages[i], nullptr);
+                _vkDevice->_allocator->free(it->offscreenImagesMemory[i]);
+            }
+            if (it->swapChain != VK_NULL_HANDLE) {
+                vkDestroySwapchainKHR(logicalDevice, it->swapChain, nullptr);
+            }
+        }
+        _retiredSwapchains.erase(_retiredSwapchains.begin(), it);
+    }
 
-        for (size_t i = 0; i < _swapChainFramebuffers.size(); i++) {
-            vkDestroyFramebuffer(logicalDevice, _swapChainFramebuffers[i], nullptr);
+    VulkanSwapchain::RetiredResources& VulkanSwapchain::retireResources() {
+        // the frame being built does not use them anymore, the ones already submitted might
+        uint64_t frame = _submittedFrames + 1;
+        if (_retiredResources.empty() || _retiredResources.back().frame != frame) {
+            _retiredResources.emplace_back();
+            _retiredResources.back().frame = frame;
         }
-        for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            for (size_t j = 0; j < _swapChainImages.size(); j++) {
-                vkDestroyBuffer(logicalDevice, _scene->_objects[i]->_mvpUboBuffers[j], nullptr);
-                vkFreeMemory(logicalDevice, _scene->_objects[i]->_mvpUboBuffersMemory[j], nullptr);
+        return _retiredResources.back();
+    }
 
-                vkDestroyBuffer(logicalDevice, _scene->_objects[i]->_lightUboBuffers[j], nullptr);
-                vkFreeMemory(logicalDevice, _scene->_objects[i]->_lightUboBuffersMemory[j], nullptr);
+    void VulkanSwapchain::destroyRetiredResources(uint64_t completedFrame) {
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        auto it = _retiredResources.begin();
+        // retired in frame order
+        for (; it != _retiredResources.end() && it->frame <= completedFrame; ++it) {
+            for (Buffer& buffer : it->buffers) {
+                buffer.unmap();
+                buffer.destroy();
+            }
+            for (size_t i = 0; i < it->instanceBuffers.size(); i++) {
+                vkDestroyBuffer(logicalDevice, it->instanceBuffers[i], nullptr);
+                _vkDevice->_allocator->free(it->instanceBuffersMemory[i]);
+            }
+            for (auto& geometryBuffer : it->geometryBuffers) {
+                vkDestroyBuffer(logicalDevice, geometryBuffer.first, nullptr);
+                _vkDevice->_allocator->free(geometryBuffer.second);
+            }
+            for (auto& geometry : it->geometry) {
+                _geometryBuffers[static_cast<uint32_t>(geometry.first)]->remove(geometry.second);
+            }
+            for (VkDescriptorSet set : it->descriptorSets) {
+                _descriptorAllocator->free(_descriptorSetLayout, set);
+            }
+            for (auto& texture : it->bindlessTextures) {
+                // elements of a replaced set went away with it
+                if (texture.first == _bindlessDescriptorSet) {
+                    _bindlessFreeIndices.push_back(texture.second);
+                }
+            }
+            if (!it->bindlessDescriptorSets.empty()) {
+                vkFreeDescriptorSets(logicalDevice, _descriptorPool, static_cast<uint32_t>(it->bindlessDescriptorSets.size()),
+                    it->bindlessDescriptorSets.data());
+            }
+            for (const TextureKey& key : it->textures) {
+                _textureCache->release(key);
             }
         }
-        vkDestroyDescriptorPool(logicalDevice, _descriptorPool, nullptr);
-        vkFreeCommandBuffers(logicalDevice, _commandPool, static_cast<uint32_t>(_commandBuffers.size()),
-            _commandBuffers.data());
-        vkDestroyPipeline(logicalDevice, _graphicsPipeline, nullptr);
+        _retiredResources.erase(_retiredResources.begin(), it);
+    }
+
+    void VulkanSwapchain::cleanupSwapChain() {
+        // The device must be idle
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        this->retireSwapChain();
+        this->destroyRetiredSwapchains(UINT64_MAX);
+        _swapChain = VK_NULL_HANDLE;
+
+        for (VkPipeline pipeline : _graphicsPipelines) {
+            vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+        }
+        vkDestroyPipeline(logicalDevice, _instancedPipeline, nullptr);
         vkDestroyPipelineLayout(logicalDevice, _pipelineLayout, nullptr);
 
         vkDestroyRenderPass(logicalDevice, _renderPass, nullptr);
-        for (size_t i = 0; i < _swapChainImageViews.size(); i++) {
-            vkDestroyImageView(logicalDevice, _swapChainImageViews[i], nullptr);
-        }
-        vkDestroySwapchainKHR(logicalDevice, _swapChain, nullptr);
     }
 
     SwapchainDetails VulkanSwapchain::querySwapchain() {
@@ -327,6 +578,10 @@ namespace Skip {
         //     _swapChainImages
         //     _swapChainImageFormat
         //     _swapChainExtent
+        if (_headless) {
+            this->createOffscreenImages();
+            return;
+        }
 
         SwapchainDetails swapchainDetails = querySwapchain();
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainDetails.formats);
@@ -376,9 +631,8 @@ namespace Skip {
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        // Would want to keep track of previous swap chain just in case
-        // swap chain becomes invalid. Leave for now
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        // the swap chain being replaced on a resize, it can not acquire images any more after this
+        createInfo.oldSwapchain = _swapChain;
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
         if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &_swapChain) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create swap chain!");
@@ -393,6 +647,30 @@ namespace Skip {
         _swapChainExtent = extent;
     }
 
+    void VulkanSwapchain::createOffscreenImages() {
+        // Headless counterpart of createSwapChain. Builds the same member variables
+        // but the images are plain color attachments we allocate ourselves:
+        //     _swapChainImages
+        //     _swapChainImageFormat
+        //     _swapChainExtent
+        _swapChainImageFormat = findSupportedFormat(
+            { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+        );
+        _swapChainExtent = { _vkWindow->_width, _vkWindow->_height };
+
+        _swapChainImages.resize(HEADLESS_IMAGE_COUNT);
+        _offscreenImagesMemory.resize(HEADLESS_IMAGE_COUNT);
+        for (size_t i = 0; i < HEADLESS_IMAGE_COUNT; i++) {
+            // TRANSFER_SRC so rendered frames can be copied out for inspection
+            createImage(_swapChainExtent.width, _swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, _swapChainImageFormat,
+                VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _swapChainImages[i], _offscreenImagesMemory[i]);
+        }
+        _offscreenImageIndex = 0;
+    }
+
     void VulkanSwapchain::createImageViews() {
         //resize list to fit all image views we'll be creating
         // Builds the following member variables:
@@ -493,7 +771,8 @@ namespace Skip {
         colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // this will resolve layout
+        // this will resolve layout. Offscreen images are never presented so they end ready for read back
+        colorAttachmentResolve.finalLayout = _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentResolveRef{};
         colorAttachmentResolveRef.attachment = 2;
@@ -545,12 +824,17 @@ namespace Skip {
     void VulkanSwapchain::createDescriptorSetLayout() {
         // Builds the following member variables:
         //     _descriptorSetLayout
+        //     _descriptorUpdateTemplate, outside of bindless mode
+        if (_bindless) {
+            this->createBindlessDescriptorSetLayout();
+            return;
+        }
 
         // Every binding needs to be described
         // mvp binding
         VkDescriptorSetLayoutBinding mvpLayoutBinding{};
         mvpLayoutBinding.binding = 0;
-        mvpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        mvpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         mvpLayoutBinding.descriptorCount = 1;
         // specify shader stage. If all -- STAGE_ALL_GRAPHICS
         // but here we're only referencing vertex shader
@@ -568,7 +852,7 @@ namespace Skip {
 
         VkDescriptorSetLayoutBinding lightLayoutBinding{};
         lightLayoutBinding.binding = 2;
-        lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         lightLayoutBinding.descriptorCount = 1;
         lightLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
         lightLayoutBinding.pImmutableSamplers = nullptr;
@@ -583,15 +867,91 @@ namespace Skip {
         if (vkCreateDescriptorSetLayout(*_vkDevice->getLogicalDevice(), &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create descriptor set layout!");
         }
+        this->createDescriptorUpdateTemplate();
+    }
+
+    void VulkanSwapchain::createBindlessDescriptorSetLayout() {
+        // binding 0: every object's BindlessObjectData, binding 1: every texture
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 0;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutBinding textureLayoutBinding{};
+        textureLayoutBinding.binding = 1;
+        textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureLayoutBinding.descriptorCount = _bindlessTextureCapacity;
+        textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { objectLayoutBinding, textureLayoutBinding };
+        // only the used part of the array has to be valid, and new textures can be written while the
+        // set is bound in command buffers that are still pending
+        std::array<VkDescriptorBindingFlags, 2> bindingFlags = {
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+        };
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(*_vkDevice->getLogicalDevice(), &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create bindless descriptor set layout!");
+        }
+    }
+
+    void VulkanSwapchain::createDescriptorUpdateTemplate() {
+        // One entry per binding, reading its descriptor out of a TextureDescriptorData
+        std::array<VkDescriptorUpdateTemplateEntry, 3> entries{};
+        entries[0].dstBinding = 0;
+        entries[0].descriptorCount = 1;
+        entries[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        entries[0].offset = offsetof(TextureDescriptorData, mvp);
+
+        entries[1].dstBinding = 1;
+        entries[1].descriptorCount = 1;
+        entries[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        entries[1].offset = offsetof(TextureDescriptorData, texture);
+
+        entries[2].dstBinding = 2;
+        entries[2].descriptorCount = 1;
+        entries[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        entries[2].offset = offsetof(TextureDescriptorData, light);
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = _descriptorSetLayout;
+
+        if (vkCreateDescriptorUpdateTemplate(*_vkDevice->getLogicalDevice(), &templateInfo, nullptr,
+            &_descriptorUpdateTemplate) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor update template!");
+        }
     }
 
     void VulkanSwapchain::createGraphicsPipeline() {
         // Builds the following member variables:
         //     _pipelineLayout
-        //     _graphicsPipeline
+        //     _graphicsPipelines
+        //     _instancedPipeline
         VkDevice device = *_vkDevice->getLogicalDevice();
-        auto vertShaderCode = readFile("resources/shaders/vert.spv");
-        auto fragShaderCode = readFile("resources/shaders/frag.spv");
+        // the bindless mode uses the same shaders compiled with -DBINDLESS
+        auto shaderPath = [this](const std::string& name) {
+            return "resources/shaders/" + name + (_bindless ? "_bindless" : "") + ".spv";
+        };
+        auto vertShaderCode = readFile(shaderPath("vert"));
+        auto fragShaderCode = readFile(shaderPath("frag"));
 
         VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
         VkShaderModule fragShaderModule = createShaderModule(device, fragShaderCode);
@@ -743,8 +1103,14 @@ namespace Skip {
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = 1; // setting descriptor layout for binding info
         pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0; // optional
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        // position decode of the compact vertex formats, or the object index in bindless mode (the
+        // decode is in the object buffer then)
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = _bindless ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = _bindless ? sizeof(uint32_t) : sizeof(VertexDecodePushConstants);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
         if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create pipeline layout!");
         }
@@ -771,12 +1137,65 @@ namespace Skip {
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional -- can switch between pipelines, but right now there's only one
         pipelineInfo.basePipelineIndex = -1; // optional
 
-        if (vkCreateGraphicsPipelines(logicalDevice, _pipelineCache, 1, &pipelineInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS) {
+        if (vkCreateGraphicsPipelines(logicalDevice, _pipelineCache, 1, &pipelineInfo, nullptr,
+            &_graphicsPipelines[static_cast<uint32_t>(VertexFormat::Full)]) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create graphics pipeline!");
         }
 
+        // Instanced variant: same state, but the model matrix comes from a second vertex binding
+        // that advances per instance (see InstanceData)
+        auto instancedVertShaderCode = readFile(shaderPath("instanced_vert"));
+        VkShaderModule instancedVertShaderModule = createShaderModule(device, instancedVertShaderCode);
+        shaderStages[0].module = instancedVertShaderModule;
+
+        std::array<VkVertexInputBindingDescription, 2> instancedBindingDescriptions = {
+            bindingDescription,
+            InstanceData::getBindingDescription()
+        };
+        auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+        std::vector<VkVertexInputAttributeDescription> instancedAttributeDescriptions(attributeDescriptions.begin(),
+            attributeDescriptions.end());
+        instancedAttributeDescriptions.insert(instancedAttributeDescriptions.end(), instanceAttributeDescriptions.begin(),
+            instanceAttributeDescriptions.end());
+
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedBindingDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = instancedBindingDescriptions.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = instancedAttributeDescriptions.data();
+
+        if (vkCreateGraphicsPipelines(logicalDevice, _pipelineCache, 1, &pipelineInfo, nullptr, &_instancedPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create instanced graphics pipeline!");
+        }
+
+        // Compact vertex formats: their own vertex layout and a vertex shader decoding it
+        auto compactVertShaderCode = readFile(shaderPath("compact_vert"));
+        auto compactColorVertShaderCode = readFile(shaderPath("compact_color_vert"));
+        VkShaderModule compactVertShaderModule = createShaderModule(device, compactVertShaderCode);
+        VkShaderModule compactColorVertShaderModule = createShaderModule(device, compactColorVertShaderCode);
+        for (VertexFormat format : { VertexFormat::Compact, VertexFormat::CompactColor }) {
+            shaderStages[0].module = format == VertexFormat::Compact ? compactVertShaderModule : compactColorVertShaderModule;
+
+            auto compactBindingDescription = getVertexBindingDescription(format);
+            auto compactAttributeDescriptions = getVertexAttributeDescriptions(format);
+            vertexInputInfo.vertexBindingDescriptionCount = 1;
+            vertexInputInfo.pVertexBindingDescriptions = &compactBindingDescription;
+            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(compactAttributeDescriptions.size());
+            vertexInputInfo.pVertexAttributeDescriptions = compactAttributeDescriptions.data();
+
+            if (vkCreateGraphicsPipelines(logicalDevice, _pipelineCache, 1, &pipelineInfo, nullptr,
+                &_graphicsPipelines[static_cast<uint32_t>(format)]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create compact vertex graphics pipeline!");
+            }
+        }
+
+        vkDestroyShaderModule(logicalDevice, compactColorVertShaderModule, nullptr);
+        vkDestroyShaderModule(logicalDevice, compactVertShaderModule, nullptr);
+        vkDestroyShaderModule(logicalDevice, instancedVertShaderModule, nullptr);
         vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
         vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
+
+        // recorded scene draws reference the old pipeline
+        this->invalidateCommandBuffers();
     }
 
     void VulkanSwapchain::createCommandPool() {
@@ -801,7 +1220,7 @@ namespace Skip {
     }
 
     void VulkanSwapchain::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format,
-        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+        VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory) {
         //helper function
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -825,19 +1244,8 @@ namespace Skip {
             throw std::runtime_error("Failed to create image!");
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(logicalDevice, image, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(_vkDevice->getPhysicalDevice(), memRequirements.memoryTypeBits, properties);
-
-        if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate image memory");
-        }
-
-        vkBindImageMemory(logicalDevice, image, imageMemory, 0);
+        // sub-allocated and bound by the device allocator
+        imageMemory = _vkDevice->_allocator->allocateImage(image, properties);
     }
 
     void VulkanSwapchain::createDepthResources() {
@@ -846,13 +1254,8 @@ namespace Skip {
         createImage(_swapChainExtent.width, _swapChainExtent.height, 1, _vkDevice->_gpuInfo->msaaSamples, depthFormat,
             VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _depthImage, _depthImageMemory);
+        // no layout transition, the render pass starts the attachment from UNDEFINED and clears it
         _depthImageView = createImageView(_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-
-        VkDevice device = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-
-        transitionImageLayout(device, physicalDevice, _commandPool, _vkDevice->_queues.graphics, _depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
     }
 
 
@@ -884,74 +1287,272 @@ namespace Skip {
         }
     }
 
-    void VulkanSwapchain::createTextureImages() {
-        // There are going to be many texture images to process
-        // In this engine, we'll start with using the ModelObject struct
-        // to load an object and uv texture map
-        //
-        // Model Objects MUST contain a texture
-        // need a default texturePath
-
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            int texWidth, texHeight, texChannels;
-
+    void VulkanSwapchain::loadAssets() {
+        SKIP_PROFILE_ZONE("loadAssets");
+        // Every object's mesh is parsed and deduplicated and its texture decoded on worker
+        // threads, the GPU side follows on this thread in a few large batches
+        // Builds the following member variables:
+        //     _loadReport
+        //     each object's vertices, indices, bounds, _textureImage and _mipLevels
+        float aspect = _swapChainExtent.width / (float)_swapChainExtent.height;
+        uint32_t objectCount = static_cast<uint32_t>(_scene->_objects.size());
+        _loadReport.clear();
+
+        // one load per distinct texture, the other objects with the same key only take a reference
+        std::vector<TextureData> textures;
+        std::vector<CachedTexture*> objectTextures(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            bool created;
+            TextureKey key = _scene->_objects[i]->getTextureKey();
+            objectTextures[i] = _textureCache->acquire(key, created);
+            if (created) {
+                textures.emplace_back();
+                textures.back().key = key;
+                textures.back().texture = objectTextures[i];
+            }
+        }
+        uint32_t textureCount = static_cast<uint32_t>(textures.size());
+
+        auto stageStart = std::chrono::high_resolution_clock::now();
+        uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        {
+            ThreadPool loadThreads(threadCount - 1, "load");
+            // jobs [0, textureCount) decode textures, the rest load meshes
+            loadThreads.parallelFor(textureCount + objectCount, [this, aspect, textureCount, &textures](uint32_t job) {
+                auto start = std::chrono::high_resolution_clock::now();
+                if (job < textureCount) {
+                    SKIP_PROFILE_ZONE("load texture");
+                    this->decodeTexture(textures[job]);
+                } else {
+                    SKIP_PROFILE_ZONE("load mesh");
+                    SkipObject* object = _scene->_objects[job - textureCount];
+                    _scene->loadObject(job - textureCount, aspect);
+
+                    float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                        std::chrono::high_resolution_clock::now() - start).count();
+                    std::string note;
+                    if (object->_meshOptimized) {
+                        std::ostringstream stats;
+                        stats << std::fixed << std::setprecision(2) << "ACMR " << object->_vertexCacheBefore.acmr << " -> "
+                            << object->_vertexCacheAfter.acmr << ", ATVR " << object->_vertexCacheBefore.atvr << " -> "
+                            << object->_vertexCacheAfter.atvr;
+                        note = stats.str();
+                    }
+                    _loadReport.add(object->_name, "mesh load", time,
+                        object->getVertexCount() * sizeof(Vertex) + object->getIndexCount() * sizeof(uint32_t), note);
+                }
+            });
+        }
+        _scene->finishLoading(aspect);
+        auto stageEnd = std::chrono::high_resolution_clock::now();
+        _loadReport.addPhase("parse and decode (" + std::to_string(threadCount) + " threads)",
+            std::chrono::duration<float, std::chrono::milliseconds::period>(stageEnd - stageStart).count());
+
+        this->uploadTextures(textures);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            SkipObject* object = _scene->_objects[i];
+            object->_textureImage = objectTextures[i]->image;
+            object->_textureImageView = objectTextures[i]->view;
+            object->_textureFormat = objectTextures[i]->format;
+            object->_mipLevels = objectTextures[i]->mipLevels;
+        }
+        _loadReport.addPhase("texture upload (" + std::to_string(textureCount) + " distinct of " + std::to_string(objectCount) + ")",
+            std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - stageEnd).count());
+    }
 
-            stbi_uc* pixels = stbi_load(_scene->_objects[i]->_texturePath.c_str(), &texWidth,
-                &texHeight, &texChannels, STBI_rgb_alpha);
-            VkDeviceSize imageSize = texWidth * texHeight * 4;
+    void VulkanSwapchain::decodeTexture(TextureData& texture) {
+        // Runs on the load threads, fills texture with the mapped .ktx2 or the decoded pixels
+        auto start = std::chrono::high_resolution_clock::now();
+        const std::string& path = texture.key.path;
+        std::string note;
+        if (this->loadCompressedTexture(texture, note)) {
+            float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start).count();
+            _loadReport.add(path, "texture map", time, texture.compressed.dataSize(), note);
+            return;
+        }
 
-            _scene->_objects[i]->_mipLevels = static_cast<uint32_t>(floor(log2(std::max(texWidth, texHeight)))) + 1;
+        int texWidth, texHeight, texChannels;
+        stbi_uc* pixels = stbi_load(path.c_str(), &texWidth,
+            &texHeight, &texChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("Failed to load texture image " + path + "!");
+        }
+        texture.pixels = pixels;
+        texture.width = static_cast<uint32_t>(texWidth);
+        texture.height = static_cast<uint32_t>(texHeight);
+        texture.texture->mipLevels = texture.key.mipmaps
+            ? static_cast<uint32_t>(floor(log2(std::max(texWidth, texHeight)))) + 1 : 1;
+        texture.texture->format = texture.key.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+        float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        _loadReport.add(path, "texture decode", time, static_cast<uint64_t>(texWidth) * texHeight * 4, note);
+    }
 
-            if (!pixels) {
-                throw std::runtime_error("Failed to load texture image!");
+    bool VulkanSwapchain::loadCompressedTexture(TextureData& texture, std::string& note) {
+        // Runs on the load threads. A .ktx2 next to the image wins, the image is the fallback when
+        // the device can not sample its format or the file is broken
+        std::string path = findCompressedTexture(texture.key.path);
+        if (path.empty()) {
+            return false;
+        }
+        bool fallback = path != texture.key.path;
+        try {
+            loadKtx2(path, texture.compressed);
+        } catch (const std::runtime_error& error) {
+            if (!fallback) {
+                throw;
             }
+            texture.compressed = CompressedTexture();
+            note = std::string(error.what()) + ", decoded the image instead";
+            return false;
+        }
+        if (!this->isTextureFormatSupported(texture.compressed.format)) {
+            if (!fallback) {
+                throw std::runtime_error("Texture format of " + path + " is not supported by the device!");
+            }
+            note = getTextureFormatName(texture.compressed.format) + " not supported, decoded the image instead";
+            texture.compressed = CompressedTexture();
+            return false;
+        }
 
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
-            createBuffer(physicalDevice, logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                stagingBufferMemory);
+        if (!texture.key.mipmaps) {
+            texture.compressed.levels.resize(1);
+        }
+        texture.texture->format = texture.compressed.format;
+        texture.texture->mipLevels = static_cast<uint32_t>(texture.compressed.levels.size());
+        note = getTextureFormatName(texture.compressed.format) + ", " + std::to_string(texture.texture->mipLevels) + " mips";
+        return true;
+    }
 
-            void* data;
-            vkMapMemory(logicalDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-            memcpy(data, pixels, static_cast<size_t>(imageSize));
-            vkUnmapMemory(logicalDevice, stagingBufferMemory);
+    bool VulkanSwapchain::isTextureFormatSupported(VkFormat format) {
+        TextureFormatInfo info = getTextureFormatInfo(format);
+        if (info.blockBytes == 0 || (info.blockSize > 1 && !_vkDevice->_gpuInfo->features.textureCompressionBC)) {
+            return false;
+        }
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(_vkDevice->getPhysicalDevice(), format, &formatProperties);
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
 
-            stbi_image_free(pixels);
+    void VulkanSwapchain::uploadTextures(std::vector<TextureData>& textures) {
+        SKIP_PROFILE_ZONE("uploadTextures");
+        // Copies go to the transfer queue through the upload ring, the only graphics work is the
+        // mipmap generation of the decoded images, done in one submit at the end
+        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
+        auto start = std::chrono::high_resolution_clock::now();
+        uint64_t uploadedBytes = _uploads->_uploadedBytes;
+        uint32_t batchCount = _uploads->_batchCount;
+
+        // first check if image format supports linear blitting for the mipmaps, only images
+        // without prebuilt mips need it
+        for (VkFormat format : { VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM }) {
+            bool generatesMipmaps = std::any_of(textures.begin(), textures.end(), [format](const TextureData& texture) {
+                return !texture.compressed.file && texture.texture->format == format && texture.texture->mipLevels > 1;
+            });
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+            if (generatesMipmaps && !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+                throw std::runtime_error("Texture image format does not support linear blitting!");
+            }
+        }
 
-            createImage(texWidth, texHeight, _scene->_objects[i]->_mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _scene->_objects[i]->_textureImage, _scene->_objects[i]->_textureImageMemory);
+        for (TextureData& texture : textures) {
+            CachedTexture* cached = texture.texture;
+            bool compressed = static_cast<bool>(texture.compressed.file);
 
-            // image layout to transfer (pipeline barrier)
-            transitionImageLayout(logicalDevice, physicalDevice, _commandPool, _vkDevice->_queues.graphics, _scene->_objects[i]->_textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _scene->_objects[i]->_mipLevels);
+            // staging offsets are 16 byte aligned, a multiple of every block size
+            VkDeviceSize stagingSize = compressed ? texture.compressed.dataSize()
+                : static_cast<VkDeviceSize>(texture.width) * texture.height * 4;
+            VkBuffer stagingBuffer;
+            VkDeviceSize offset;
+            char* staging = static_cast<char*>(_uploads->allocate(stagingSize, stagingBuffer, offset, 16));
+            _uploads->_uploadedBytes += stagingSize;
+
+            VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            if (compressed) {
+                // levels are packed one after another, in the order of the regions
+                for (uint32_t level = 0; level < texture.compressed.levels.size(); level++) {
+                    memcpy(staging, texture.compressed.levelData(level), static_cast<size_t>(texture.compressed.levels[level].size));
+                    staging += texture.compressed.levels[level].size;
+                }
+                createImage(texture.compressed.width, texture.compressed.height, cached->mipLevels, VK_SAMPLE_COUNT_1_BIT,
+                    cached->format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    cached->image, cached->memory);
+            } else {
+                memcpy(staging, texture.pixels, static_cast<size_t>(stagingSize));
+                stbi_image_free(texture.pixels);
+                texture.pixels = nullptr;
+                createImage(texture.width, texture.height, cached->mipLevels, VK_SAMPLE_COUNT_1_BIT, cached->format,
+                    VK_IMAGE_TILING_OPTIMAL, usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cached->image, cached->memory);
+            }
 
-            //copy to staging buffer
-            copyBufferToImage(stagingBuffer, _scene->_objects[i]->_textureImage,
-                static_cast<uint32_t>(texWidth),
-                static_cast<uint32_t>(texHeight));
-            // prepare image for shader access
-            // moved the VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL transitioning to mipmap method
-            // TODO: can we make mipmapping optional?
-            generateMipmaps(_scene->_objects[i]->_textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, _scene->_objects[i]->_mipLevels);
+            // image layout to transfer (pipeline barrier)
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = cached->image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = cached->mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            // allocate may have submitted the batch, so the command buffer is fetched after it
+            VkCommandBuffer commandBuffer = _uploads->getCommandBuffer();
+            vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
 
-            vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-            vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+            if (compressed) {
+                copyCompressedTexture(commandBuffer, stagingBuffer, offset, cached->image, texture.compressed);
+                // every level was written by the copy, it is ready for sampling once graphics has it
+                _uploads->releaseImage(cached->image, barrier.subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                // the mapping is not needed once the levels are staged
+                texture.compressed = CompressedTexture();
+            } else {
+                copyBufferToImage(commandBuffer, stagingBuffer, offset, cached->image, texture.width, texture.height);
+                // the transfer queue can not blit, the mips are generated on the graphics queue below
+                _uploads->releaseImage(cached->image, barrier.subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
+            cached->view = createImageView(cached->image, cached->format, VK_IMAGE_ASPECT_COLOR_BIT, cached->mipLevels);
         }
 
-    }
+        _uploads->synchronize(_commandPool, [&](VkCommandBuffer commandBuffer) {
+            for (TextureData& texture : textures) {
+                if (texture.width == 0) {
+                    continue; // loaded from a .ktx2
+                }
+                // prepare image for shader access
+                // moved the VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL transitioning to mipmap method
+                // (with TextureKey::mipmaps off there is only the last transition)
+                generateMipmaps(commandBuffer, texture.texture->image, static_cast<int32_t>(texture.width),
+                    static_cast<int32_t>(texture.height), texture.texture->mipLevels);
+            }
+        });
 
-    void VulkanSwapchain::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-        VkDevice device = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, _commandPool);
+        float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        _loadReport.add(std::to_string(textures.size()) + " textures in " + std::to_string(_uploads->_batchCount - batchCount) + " batches",
+            "texture upload", time, _uploads->_uploadedBytes - uploadedBytes);
+    }
 
+    void VulkanSwapchain::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+        VkImage image, uint32_t width, uint32_t height) {
         VkBufferImageCopy region{};
-        region.bufferOffset = 0;
+        region.bufferOffset = bufferOffset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
 
@@ -975,26 +1576,32 @@ namespace Skip {
             1,
             &region
         );
-
-        endSingleTimeCommands(device, _vkDevice->_queues.graphics, _commandPool, commandBuffer);
     }
 
-    void VulkanSwapchain::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth,
-        int32_t texHeight, uint32_t mipLevels) {
-        VkDevice device = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        // first check if image format supports linear blitting
-        // there are alternatives to handle different formats
-        // It's uncommon to generate mipmap levels at runtime... They are usually
-        // pregenerated and stored in the texture file
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("Texture image format does not support linear blitting!");
+    void VulkanSwapchain::copyCompressedTexture(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+        VkImage image, const CompressedTexture& texture) {
+        uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+        std::vector<VkBufferImageCopy> regions(levelCount);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            VkBufferImageCopy& region = regions[level];
+            region.bufferOffset = bufferOffset;
+            region.bufferRowLength = 0; // tightly packed blocks
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0, 0, 0 };
+            // the extent of the level itself, partial blocks are allowed at the edge
+            region.imageExtent = { texture.levels[level].width, texture.levels[level].height, 1 };
+            bufferOffset += texture.levels[level].size;
         }
+        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+    }
 
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, _commandPool);
-
+    void VulkanSwapchain::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth,
+        int32_t texHeight, uint32_t mipLevels) {
+        // the caller checks that the format supports linear blitting
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.image = image;
@@ -1075,291 +1682,874 @@ namespace Skip {
             0, nullptr,
             0, nullptr,
             1, &barrier);
-
-        endSingleTimeCommands(device, _vkDevice->_queues.graphics, _commandPool, commandBuffer);
     }
 
-    void VulkanSwapchain::createTextureImageViews() {
+    void VulkanSwapchain::createTextureSamplers() {
+        // samplers do not depend on the image, objects with the same sampler state share one
         for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            _scene->_objects[i]->_textureImageView = createImageView(_scene->_objects[i]->_textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_ASPECT_COLOR_BIT, _scene->_objects[i]->_mipLevels);
+            _scene->_objects[i]->_textureSampler = _textureCache->getSampler(_scene->_objects[i]->_samplerState);
         }
     }
 
-    void VulkanSwapchain::createTextureSamplers() {
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+    void VulkanSwapchain::createGeometryBuffer() {
+        // Builds the following member variables:
+        //     _geometryBuffers, sized to fit the scene so loading does not have to grow them
+        std::array<uint32_t, VERTEX_FORMAT_COUNT> vertexCounts = {};
+        std::array<uint32_t, VERTEX_FORMAT_COUNT> indexCounts = {};
         for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            VkSamplerCreateInfo samplerInfo{};
-            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-            // specify how to interpolate texels -- other option is VK_FILTER_NEAREST
-            samplerInfo.magFilter = VK_FILTER_LINEAR;
-            samplerInfo.minFilter = VK_FILTER_LINEAR;
-            // U, V, W is x, y, z in texture space
-            // can specify repeat or clamp here
-            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            //anisotropic filtering
-            samplerInfo.anisotropyEnable = VK_TRUE;
-            samplerInfo.maxAnisotropy = 16.0f;
-            // border color when sampling beyond image (can't specify arbitrary color)
-            samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-            // if true: [0, texWidth) and [0, texHeight)
-            // else: [0, 1) on all axis
-            samplerInfo.unnormalizedCoordinates = VK_FALSE;
-            // mainly used for percentage-closer filtering on shadow maps
-            samplerInfo.compareEnable = VK_FALSE;
-            samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-            // mipmapping settings
-            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-            samplerInfo.mipLodBias = 0.0f;
-            // using the higher mip map levels will result in more blurry (as in for distance)
-            samplerInfo.minLod = 0.0f;
-            samplerInfo.maxLod = static_cast<float>(_scene->_objects[i]->_mipLevels); // Max level of detail
-
-            if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &_scene->_objects[i]->_textureSampler) != VK_SUCCESS) {
-                throw std::runtime_error("Failed to create a texture sampler!");
+            SkipObject* object = _scene->_objects[i];
+            uint32_t format = static_cast<uint32_t>(object->_instanced ? VertexFormat::Full : object->_vertexFormat);
+            vertexCounts[format] += static_cast<uint32_t>(object->getVertexCount());
+            if (object->_useIndexBuffer) {
+                indexCounts[format] += static_cast<uint32_t>(object->getIndexCount());
             }
         }
+        for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++) {
+            // the full format is always there for instanced objects added later
+            if (vertexCounts[format] == 0 && format != static_cast<uint32_t>(VertexFormat::Full)) {
+                continue;
+            }
+            _geometryBuffers[format] = this->newGeometryBuffer(static_cast<VertexFormat>(format),
+                std::max<uint32_t>(vertexCounts[format], 65536), std::max<uint32_t>(indexCounts[format], 262144));
+        }
+
+        for (size_t i = 0; i < _scene->_objects.size(); i++) {
+            this->uploadGeometry(_scene->_objects[i]);
+        }
     }
 
+    GeometryBuffer* VulkanSwapchain::getGeometryBuffer(VertexFormat format) {
+        GeometryBuffer*& geometryBuffer = _geometryBuffers[static_cast<uint32_t>(format)];
+        if (geometryBuffer == nullptr) {
+            geometryBuffer = this->newGeometryBuffer(format);
+        }
+        return geometryBuffer;
+    }
 
-    void VulkanSwapchain::loadObjects() {
-        float aspect = _swapChainExtent.width / (float)_swapChainExtent.height;
-        _scene->loadScene(aspect);
+    GeometryBuffer* VulkanSwapchain::newGeometryBuffer(VertexFormat format, uint32_t vertexCapacity, uint32_t indexCapacity) {
+        GeometryBuffer* geometryBuffer = new GeometryBuffer(_vkDevice->_allocator, _uploads, getVertexStride(format),
+            vertexCapacity, indexCapacity);
+        // frames in flight may still draw from an outgrown arena and the upload batch copies out of it
+        geometryBuffer->_retireBuffer = [this](VkBuffer buffer, const MemoryAllocation& memory) {
+            this->retireResources().geometryBuffers.emplace_back(buffer, memory);
+        };
+        return geometryBuffer;
     }
 
-    void VulkanSwapchain::createVertexBuffers() {
-        // This currently creates buffer and memory buffer in ModelObject
+    uint64_t VulkanSwapchain::getGeometryVersion() const {
+        // versions only grow, so the sum changes with any of them
+        uint64_t version = 0;
+        for (GeometryBuffer* geometryBuffer : _geometryBuffers) {
+            version += geometryBuffer != nullptr ? geometryBuffer->_version + 1 : 0;
+        }
+        return version;
+    }
 
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            VkDeviceSize bufferSize = sizeof(_scene->_objects[i]->_vertices[0]) * _scene->_objects[i]->_vertices.size();
-            // TRANSFER_SRC - source of transfer
-            createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer, stagingBufferMemory);
-            // filling the vertex buffer by first passing a staging buffer
-            // could specify special vaule VK_WHOLE_SIZE to map all memory (3rd param)
-            // Caching can be an issue which can be fixed with vkFlushedMappedMemoryRanges
-            // after writing to mapped memory or use a memory heap that is host coherent
-            void* data;
-            vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, _scene->_objects[i]->_vertices.data(), (size_t)bufferSize);
-            vkUnmapMemory(logicalDevice, stagingBufferMemory);
+    void VulkanSwapchain::uploadGeometry(SkipObject* object) {
+        // Objects added at runtime go through here as well (addSceneObject), the scene draws pick
+        // them up once they are re-recorded
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // the instanced pipeline only takes full vertices
+        VertexFormat format = object->_instanced ? VertexFormat::Full : object->_vertexFormat;
+        GeometryBuffer* geometryBuffer = this->getGeometryBuffer(format);
+        // straight out of the mesh cache mapping when the mesh came from there
+        uint32_t vertexCount = static_cast<uint32_t>(object->getVertexCount());
+        const void* vertices = object->getVertexData();
+        std::vector<uint8_t> packedVertices;
+        if (format != VertexFormat::Full) {
+            packVertices(format, object->getVertexData(), vertexCount, packedVertices, object->_vertexDecode);
+            vertices = packedVertices.data();
+        }
 
-            // TRANSFER_DST - transfer destination
-            createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _scene->_objects[i]->_vertexBuffer, _scene->_objects[i]->_vertexBufferMemory);
+        if (object->_useIndexBuffer) {
+            object->_geometry = geometryBuffer->add(vertices, vertexCount,
+                object->getIndexData(), static_cast<uint32_t>(object->getIndexCount()));
+        } else {
+            object->_geometry = geometryBuffer->add(vertices, vertexCount);
+        }
+        object->_geometryFormat = format;
 
-            copyBuffer(stagingBuffer, _scene->_objects[i]->_vertexBuffer, bufferSize);
+        float time = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        uint64_t vertexBytes = vertexCount * getVertexStride(format);
+        std::ostringstream note;
+        note << getVertexFormatName(format) << " vertices, " << getVertexStride(format) << " of " << sizeof(Vertex)
+            << " bytes, " << (vertexCount * (sizeof(Vertex) - getVertexStride(format))) / 1024 << " KB saved";
+        _loadReport.add(object->_name, "geometry upload", time, vertexBytes, note.str());
 
-            vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-            vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
+        this->invalidateCommandBuffers();
+    }
 
-        }
+    void VulkanSwapchain::releaseGeometry(SkipObject* object) {
+        // frames in flight may still draw the range, it goes back to the arena once they have completed
+        this->retireResources().geometry.emplace_back(object->_geometryFormat, object->_geometry);
+        object->_geometry = GeometryRange{};
+        this->invalidateCommandBuffers();
     }
 
-    void VulkanSwapchain::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-        // Memory transfer operations use command buffers --> we need a temp command buffer
-        // TODO: You might want to create a separate command pool for these short lived copy/transfers.
-        //       In that case, use VK_COMMAND_POOL_CREATE_TRANSIENT_BIT flag in command pool
-        VkDevice device = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, _commandPool);
+    void VulkanSwapchain::addSceneObject(SkipObject* object) {
+        SKIP_PROFILE_ZONE("addSceneObject");
+        // loadAssets for a single object on this thread. A texture not in the cache yet is uploaded
+        // right away, which waits for that one upload. The uniform ring grows in updateUniformBuffers
+        if (object->getVertexCount() == 0) {
+            float aspect = _swapChainExtent.width / (float)_swapChainExtent.height;
+            _scene->loadObject(object->_sceneIndex, aspect);
+            _scene->updateObject(object);
+        }
 
-        VkBufferCopy copyRegion{};
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        bool created;
+        TextureKey key = object->getTextureKey();
+        CachedTexture* texture = _textureCache->acquire(key, created);
+        if (created) {
+            std::vector<TextureData> textures(1);
+            textures[0].key = key;
+            textures[0].texture = texture;
+            this->decodeTexture(textures[0]);
+            this->uploadTextures(textures);
+        }
+        object->_textureImage = texture->image;
+        object->_textureImageView = texture->view;
+        object->_textureFormat = texture->format;
+        object->_mipLevels = texture->mipLevels;
+        object->_textureSampler = _textureCache->getSampler(object->_samplerState);
+
+        this->uploadGeometry(object);
+        if (object->_instanced) {
+            this->createInstanceBuffer(static_cast<InstancedObject*>(object));
+        }
+        this->acquireDescriptorSet(object);
+    }
 
-        endSingleTimeCommands(device, _vkDevice->_queues.graphics, _commandPool, commandBuffer);
+    void VulkanSwapchain::removeSceneObject(SkipObject* object) {
+        // frames in flight may still draw the object, everything it holds is retired instead of destroyed
+        this->releaseDescriptorSet(object);
+        this->releaseGeometry(object);
+        RetiredResources& retired = this->retireResources();
+        if (object->_instanced) {
+            InstancedObject* instanced = static_cast<InstancedObject*>(object);
+            retired.instanceBuffers.push_back(instanced->_instanceBuffer);
+            retired.instanceBuffersMemory.push_back(instanced->_instanceBufferMemory);
+            instanced->_instanceBuffer = VK_NULL_HANDLE;
+            instanced->_instanceBufferMemory = MemoryAllocation{};
+            instanced->_dirtyRanges.clear();
+        }
+        retired.textures.push_back(object->getTextureKey());
+        object->_textureImage = VK_NULL_HANDLE;
+        object->_textureImageView = VK_NULL_HANDLE;
+        object->_descriptorSet = VK_NULL_HANDLE;
     }
 
-    void VulkanSwapchain::createIndexBuffers() {
-        // Index buffers are only needed if normals/lightings are not needed as a per vertex
+    void VulkanSwapchain::createFrameResources() {
+        // Builds everything owned by a frame in flight slot
+        this->createUniformBuffers();
+        for (size_t i = 0; i < _scene->_objects.size(); i++) {
+            if (_scene->_objects[i]->_instanced) {
+                this->createInstanceBuffer(static_cast<InstancedObject*>(_scene->_objects[i]));
+            }
+        }
+        _descriptorAllocator->setFrameCount(_framesInFlight);
+        this->createDescriptorPool();
+        this->createDescriptorSets();
+        this->createSyncObjects();
+        this->createGpuProfiler();
+        this->allocateCommandBuffers();
+        _imguiContext->setFrameCount(_framesInFlight);
+        _imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+        _slotFrames.assign(_framesInFlight, 0);
+        _currentFrame = 0;
+    }
 
+    void VulkanSwapchain::destroyFrameResources() {
+        // The device must be idle, any slot could still be in use otherwise
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
+        _completedFrames = _submittedFrames;
+        this->destroyRetiredResources(UINT64_MAX);
+        _uniformBuffer.unmap();
+        _uniformBuffer.destroy();
+        _uniformBuffer = Buffer{};
         for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            // TODO Add check for if vbo or using indices
-            if (_scene->_objects[i]->_useIndexBuffer) {
-                VkDeviceSize bufferSize = sizeof(_scene->_objects[i]->_indices[0]) * _scene->_objects[i]->_indices.size();
-                // TRANSFER_SRC - source of transfer
-                createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                    stagingBuffer, stagingBufferMemory);
+            if (_scene->_objects[i]->_instanced) {
+                this->destroyInstanceBuffer(static_cast<InstancedObject*>(_scene->_objects[i]));
+            }
+        }
 
-                // filling the vertex buffer by first passing a staging buffer
-                // could specify special vaule VK_WHOLE_SIZE to map all memory (3rd param)
-                // Caching can be an issue which can be fixed with vkFlushedMappedMemoryRanges
-                // after writing to mapped memory or use a memory heap that is host coherent
-                void* data;
-                vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-                memcpy(data, _scene->_objects[i]->_indices.data(), (size_t)bufferSize);
-                vkUnmapMemory(logicalDevice, stagingBufferMemory);
+        // the per texture sets go back to the allocator, the next createDescriptorSets reuses them
+        for (auto& entry : _textureDescriptorSets) {
+            _descriptorAllocator->free(_descriptorSetLayout, entry.second.set);
+        }
+        _textureDescriptorSets.clear();
+        for (SkipObject* object : _scene->_objects) {
+            object->_descriptorSet = VK_NULL_HANDLE;
+        }
+        vkDestroyDescriptorPool(logicalDevice, _descriptorPool, nullptr);
+        _descriptorPool = VK_NULL_HANDLE;
+        _bindlessDescriptorSet = VK_NULL_HANDLE;
+        _bindlessTextures.clear();
+        _bindlessFreeIndices.clear();
+        _bindlessTextureCount = 0;
 
-                // TRANSFER_DST - transfer destination
-                createBuffer(physicalDevice, logicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _scene->_objects[i]->_indexBuffer, _scene->_objects[i]->_indexBufferMemory);
+        vkFreeCommandBuffers(logicalDevice, _commandPool, static_cast<uint32_t>(_commandBuffers.size()),
+            _commandBuffers.data());
+        // destroying the pools frees the scene secondaries
+        for (VkCommandPool pool : _recordCommandPools) {
+            vkDestroyCommandPool(logicalDevice, pool, nullptr);
+        }
+        _recordCommandPools.clear();
+        _sceneCommandBuffers.clear();
+        vkFreeCommandBuffers(logicalDevice, _commandPool, static_cast<uint32_t>(_uiCommandBuffers.size()),
+            _uiCommandBuffers.data());
 
-                copyBuffer(stagingBuffer, _scene->_objects[i]->_indexBuffer, bufferSize);
+        for (size_t i = 0; i < _inFlightFences.size(); i++) {
+            vkDestroySemaphore(logicalDevice, _renderFinishedSemaphores[i], nullptr);
+            vkDestroySemaphore(logicalDevice, _imageAvailableSemaphores[i], nullptr);
+            vkDestroyFence(logicalDevice, _inFlightFences[i], nullptr);
+        }
+        _imagesInFlight.assign(_imagesInFlight.size(), VK_NULL_HANDLE);
+
+        delete _gpuProfiler;
+        _gpuProfiler = nullptr;
+    }
 
-                vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-                vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
-            } 
+    void VulkanSwapchain::setFramesInFlight(uint32_t framesInFlight) {
+        if (framesInFlight == 0) {
+            throw std::runtime_error("At least one frame has to be in flight!");
         }
+        if (framesInFlight == _framesInFlight) {
+            return;
+        }
+        vkDeviceWaitIdle(*_vkDevice->getLogicalDevice());
+        this->destroyFrameResources();
+        _framesInFlight = framesInFlight;
+        this->createFrameResources();
     }
 
-    void VulkanSwapchain::createUniformBuffers() {
-        // Currently using one buffer for each skip object
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        VkPhysicalDevice physicalDevice = _vkDevice->getPhysicalDevice();
-        VkDeviceSize mvpbufferSize = sizeof(MvpBufferObject);
-        VkDeviceSize lightBufferSize = sizeof(LightBufferObject);
-        for (size_t i = 0; i < _scene->_objects.size(); i++) {
-            _scene->_objects[i]->_mvpUboBuffers.resize(_swapChainImages.size());
-            _scene->_objects[i]->_mvpUboBuffersMemory.resize(_swapChainImages.size());
-
-            _scene->_objects[i]->_lightUboBuffers.resize(_swapChainImages.size());
-            _scene->_objects[i]->_lightUboBuffersMemory.resize(_swapChainImages.size());
-
-            for (size_t j = 0; j < _swapChainImages.size(); j++) {
-                createBuffer(physicalDevice, logicalDevice, mvpbufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _scene->_objects[i]->_mvpUboBuffers[j],
-                    _scene->_objects[i]->_mvpUboBuffersMemory[j]);
-
-                createBuffer(physicalDevice, logicalDevice, lightBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _scene->_objects[i]->_lightUboBuffers[j],
-                    _scene->_objects[i]->_lightUboBuffersMemory[j]);
-            }
+    void VulkanSwapchain::setRecordThreadCount(uint32_t threadCount) {
+        if (threadCount == 0) {
+            throw std::runtime_error("At least one recording thread is needed!");
+        }
+        if (threadCount == _recordThreadCount) {
+            return;
         }
+        vkDeviceWaitIdle(*_vkDevice->getLogicalDevice());
+        this->destroyFrameResources();
+        delete _recordThreads;
+        _recordThreadCount = threadCount;
+        // the thread calling parallelFor records a slice too
+        _recordThreads = new ThreadPool(threadCount - 1, "record");
+        this->createFrameResources();
+    }
 
+    bool VulkanSwapchain::isBindlessSupported() const {
+        return _vkDevice->_gpuInfo->descriptorIndexing && _vkDevice->_gpuInfo->maxBindlessTextures > 0;
+    }
 
+    void VulkanSwapchain::setBindless(bool bindless) {
+        if (bindless == _bindless) {
+            return;
+        }
+        if (bindless && !this->isBindlessSupported()) {
+            throw std::runtime_error("Bindless mode needs descriptor indexing!");
+        }
+        // the set layout, and with it the pipeline layout and pipelines, differ between the modes
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        vkDeviceWaitIdle(logicalDevice);
+        this->destroyFrameResources();
+        for (VkPipeline pipeline : _graphicsPipelines) {
+            vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+        }
+        vkDestroyPipeline(logicalDevice, _instancedPipeline, nullptr);
+        vkDestroyPipelineLayout(logicalDevice, _pipelineLayout, nullptr);
+        // the free sets were allocated with the old layout
+        _descriptorAllocator->reset();
+        vkDestroyDescriptorUpdateTemplate(logicalDevice, _descriptorUpdateTemplate, nullptr);
+        _descriptorUpdateTemplate = VK_NULL_HANDLE;
+        vkDestroyDescriptorSetLayout(logicalDevice, _descriptorSetLayout, nullptr);
+
+        _bindless = bindless;
+        _bindlessTextureCapacity = std::min(BINDLESS_TEXTURE_CAPACITY, _vkDevice->_gpuInfo->maxBindlessTextures);
+        this->createDescriptorSetLayout();
+        this->createGraphicsPipeline();
+        this->createFrameResources();
     }
 
-    void VulkanSwapchain::createDescriptorPool() {
-        // describe descriptor types our sets are going to contain
-        // Create pools for each ubos and sampler
-        std::array<VkDescriptorPoolSize, 4> poolSizes{};
+    float VulkanSwapchain::measureSceneRecording(uint32_t iterations) {
+        // Re-records frame slot 0 back to back, returns the average time of one recording in ms
+        vkDeviceWaitIdle(*_vkDevice->getLogicalDevice());
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; i++) {
+            this->recordSceneCommandBuffer(0);
+        }
+        float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        this->invalidateCommandBuffers();
+        return elapsed / std::max<uint32_t>(iterations, 1);
+    }
 
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(_swapChainImages.size());
+    void VulkanSwapchain::createUniformBuffers() {
+        // Builds the following member variables:
+        //     _uniformBuffer, mapped for its whole lifetime
+        // Dynamic offsets have to respect minUniformBufferOffsetAlignment (always a power of two)
+        VkDeviceSize alignment = _vkDevice->_gpuInfo->properties.limits.minUniformBufferOffsetAlignment;
+        auto alignUniform = [alignment](VkDeviceSize size) {
+            return alignment > 0 ? (size + alignment - 1) & ~(alignment - 1) : size;
+        };
+        _uniformLightOffset = alignUniform(sizeof(MvpBufferObject));
+        _uniformObjectStride = _uniformLightOffset + alignUniform(sizeof(LightBufferObject));
+        if (_bindless) {
+            // an array of BindlessObjectData, indexed instead of offset
+            _uniformLightOffset = offsetof(BindlessObjectData, light);
+            _uniformObjectStride = sizeof(BindlessObjectData);
+        }
+        _uniformObjectCapacity = static_cast<uint32_t>(std::max<size_t>({ _uniformObjectCapacity, _scene->_objects.size(), 1 }));
+        _uniformFrameStride = _uniformObjectStride * _uniformObjectCapacity;
+
+        createBuffer(_vkDevice->_allocator, _bindless ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &_uniformBuffer, _uniformFrameStride * _framesInFlight);
+        _uniformBuffer.map();
+        if (_uniformBuffer.mapped == nullptr) {
+            throw std::runtime_error("Failed to map uniform buffer!");
+        }
+    }
 
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(_swapChainImages.size());
+    void VulkanSwapchain::growUniformBuffer(size_t objectCount) {
+        // Frames in flight still read the old ring through the old descriptors, both are retired
+        // rather than waiting for the GPU. Doubling keeps objects added one at a time cheap
+        RetiredResources& retired = this->retireResources();
+        retired.buffers.push_back(_uniformBuffer);
+        _uniformBuffer = Buffer{};
+        _uniformObjectCapacity = static_cast<uint32_t>(std::max<size_t>(objectCount, _uniformObjectCapacity * 2));
+        this->createUniformBuffers();
 
-        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[2].descriptorCount = static_cast<uint32_t>(_swapChainImages.size());
+        if (_bindless) {
+            retired.bindlessDescriptorSets.push_back(_bindlessDescriptorSet);
+            _bindlessDescriptorSet = VK_NULL_HANDLE;
+        } else {
+            for (auto& entry : _textureDescriptorSets) {
+                retired.descriptorSets.push_back(entry.second.set);
+            }
+            _textureDescriptorSets.clear();
+        }
+        this->createDescriptorSets();
+        // every slot's draws use the new offsets and sets from now on
+        this->invalidateCommandBuffers();
+    }
 
-        // TODO: Is this needed? This pool is used for imgui
-        poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[3].descriptorCount = static_cast<uint32_t>(_swapChainImages.size());
+    void VulkanSwapchain::createDescriptorPool() {
+        // Only the bindless set has a pool of its own, per texture sets come from _descriptorAllocator
+        if (!_bindless) {
+            return;
+        }
 
+        // The set in use, plus the ones frames in flight may still read after the uniform ring grew
+        // (at most once per frame). The texture array may be written to while it is bound
+        uint32_t setCount = _framesInFlight + 1;
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[0].descriptorCount = setCount;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = _bindlessTextureCapacity * setCount;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(_swapChainImages.size()) + 1; // +1 for imgui
-        // structure has optional flag to determine individual descriptor sets
-        // can be freed or not: VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
-        poolInfo.flags = 0;
-
+        poolInfo.maxSets = setCount;
         if (vkCreateDescriptorPool(*_vkDevice->getLogicalDevice(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create descriptor pool!");
+            throw std::runtime_error("Failed to create bindless descriptor pool!");
         }
     }
 
     void VulkanSwapchain::createDescriptorSets() {
-        // We'll create descriptor set for each SkipObject
+        // Descriptors of every object in the scene. Outside of bindless mode, sets handed back by
+        // destroyFrameResources are reused and only new textures allocate
+        if (_bindless) {
+            this->createBindlessDescriptorSet();
+        }
+        for (SkipObject* object : _scene->_objects) {
+            this->acquireDescriptorSet(object);
+        }
+    }
 
-        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        std::vector<VkDescriptorSetLayout> layouts(_swapChainImages.size(), _descriptorSetLayout);
+    void VulkanSwapchain::acquireDescriptorSet(SkipObject* object) {
+        // The object and frame slot are selected through the dynamic offsets when binding, so
+        // the set only depends on the texture
+        if (_bindless) {
+            object->_bindlessTextureIndex = this->addBindlessTexture(object->_textureImageView, object->_textureSampler);
+            return;
+        }
+        TextureDescriptorSet& shared = _textureDescriptorSets[std::make_pair(object->_textureImageView, object->_textureSampler)];
+        if (shared.set == VK_NULL_HANDLE) {
+            shared.set = _descriptorAllocator->allocate(_descriptorSetLayout);
+
+            TextureDescriptorData data{};
+            data.mvp.buffer = _uniformBuffer.buffer;
+            data.mvp.offset = 0;
+            data.mvp.range = sizeof(MvpBufferObject);
+            data.texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            data.texture.imageView = object->_textureImageView;
+            data.texture.sampler = object->_textureSampler;
+            data.light.buffer = _uniformBuffer.buffer;
+            data.light.offset = 0;
+            data.light.range = sizeof(LightBufferObject);
+            // the template reads every binding straight out of the struct, no write structs per binding
+            vkUpdateDescriptorSetWithTemplate(*_vkDevice->getLogicalDevice(), shared.set, _descriptorUpdateTemplate, &data);
+        }
+        shared.references++;
+        object->_descriptorSet = shared.set;
+    }
 
+    void VulkanSwapchain::releaseDescriptorSet(SkipObject* object) {
+        if (_bindless) {
+            this->releaseBindlessTexture(object->_textureImageView, object->_textureSampler);
+            return;
+        }
+        auto found = _textureDescriptorSets.find(std::make_pair(object->_textureImageView, object->_textureSampler));
+        if (found == _textureDescriptorSets.end()) {
+            return;
+        }
+        object->_descriptorSet = VK_NULL_HANDLE;
+        if (--found->second.references == 0) {
+            // frames in flight may still bind it
+            this->retireResources().descriptorSets.push_back(found->second.set);
+            _textureDescriptorSets.erase(found);
+        }
+    }
+
+    void VulkanSwapchain::createBindlessDescriptorSet() {
+        // Builds the following member variables:
+        //     _bindlessDescriptorSet, with the object buffer in it
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = _descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(_scene->_objects.size());
-        allocInfo.pSetLayouts = layouts.data();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &_descriptorSetLayout;
+        if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &_bindlessDescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate bindless descriptor set!");
+        }
 
-        _descriptorSets.resize(_swapChainImages.size());
-        if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, _descriptorSets.data()) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocated descriptor sets!");
+        // all frame slots, draws index past the slots before their own
+        VkDescriptorBufferInfo objectBufferInfo{};
+        objectBufferInfo.buffer = _uniformBuffer.buffer;
+        objectBufferInfo.offset = 0;
+        objectBufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = _bindlessDescriptorSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &objectBufferInfo;
+        vkUpdateDescriptorSets(logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+        // a new set starts with an empty array, createDescriptorSets adds the objects' textures to it
+        _bindlessTextures.clear();
+        _bindlessFreeIndices.clear();
+        _bindlessTextureCount = 0;
+    }
+
+    uint32_t VulkanSwapchain::addBindlessTexture(VkImageView view, VkSampler sampler) {
+        BindlessTexture& texture = _bindlessTextures[std::make_pair(view, sampler)];
+        if (texture.references++ > 0) {
+            return texture.index;
+        }
+        uint32_t index;
+        if (!_bindlessFreeIndices.empty()) {
+            index = _bindlessFreeIndices.back();
+            _bindlessFreeIndices.pop_back();
+        } else if (_bindlessTextureCount < _bindlessTextureCapacity) {
+            index = _bindlessTextureCount++;
+        } else {
+            _bindlessTextures.erase(std::make_pair(view, sampler));
+            throw std::runtime_error("Bindless texture array is full!");
         }
 
-        // descriptor sets need to be configured for each buffer
-        for (size_t i = 0; i < _scene->_objects.size(); i++) {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = view;
+        imageInfo.sampler = sampler;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = _bindlessDescriptorSet;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = index;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(*_vkDevice->getLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
+
+        texture.index = index;
+        return index;
+    }
 
-            VkDescriptorBufferInfo mvpBufferInfo{};
-            mvpBufferInfo.buffer = *_scene->_objects[i]->_mvpUboBuffers.data();
-            mvpBufferInfo.offset = 0;
-            mvpBufferInfo.range = sizeof(_scene->_objects[i]->_mvpUboBuffers);
-
-            VkDescriptorImageInfo imageInfo{};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = _scene->_objects[i]->_textureImageView;
-            imageInfo.sampler = _scene->_objects[i]->_textureSampler;
-
-            VkDescriptorBufferInfo lightBufferInfo{};
-            lightBufferInfo.buffer = *_scene->_objects[i]->_lightUboBuffers.data();
-            lightBufferInfo.offset = 0;
-            lightBufferInfo.range = sizeof(_scene->_objects[i]->_lightUboBuffers);
-
-            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = _descriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0; // not using array
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &mvpBufferInfo;
-            descriptorWrites[0].pImageInfo = nullptr; // Optional -- refer to image data
-            descriptorWrites[0].pTexelBufferView = nullptr; // Optional -- refer to buffer views
-
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = _descriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0; // not using array
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].pBufferInfo = nullptr;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pImageInfo = &imageInfo;
-            descriptorWrites[1].pTexelBufferView = nullptr;
-
-            descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[2].dstSet = _descriptorSets[i];
-            descriptorWrites[2].dstBinding = 2;
-            descriptorWrites[2].dstArrayElement = 0; // not using array
-            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[2].descriptorCount = 1;
-            descriptorWrites[2].pBufferInfo = &lightBufferInfo;
-            descriptorWrites[2].pImageInfo = nullptr;
-            descriptorWrites[2].pTexelBufferView = nullptr;
-
-            vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    void VulkanSwapchain::releaseBindlessTexture(VkImageView view, VkSampler sampler) {
+        auto found = _bindlessTextures.find(std::make_pair(view, sampler));
+        if (found == _bindlessTextures.end() || --found->second.references > 0) {
+            return;
         }
+        // frames in flight may still sample the element, it is reused once they have completed
+        this->retireResources().bindlessTextures.emplace_back(_bindlessDescriptorSet, found->second.index);
+        _bindlessTextures.erase(found);
     }
 
     void VulkanSwapchain::allocateCommandBuffers() {
-        _commandBuffers.resize(_swapChainFramebuffers.size());
+        // Every frame in flight slot owns
+        //     _commandBuffers       primary, re-recorded each frame, stitches the secondaries together
+        //     _sceneCommandBuffers  secondaries, static scene draws recorded once and reused,
+        //                           one per recording thread (slot major)
+        //     _uiCommandBuffers     secondary, imgui draws recorded each frame
+        VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
+        _commandBuffers.resize(_framesInFlight);
+        _sceneCommandBuffers.resize(_framesInFlight * _recordThreadCount);
+        _uiCommandBuffers.resize(_framesInFlight);
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = _commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandBufferCount = (uint32_t)_commandBuffers.size();
-        if (vkAllocateCommandBuffers(*_vkDevice->getLogicalDevice(), &allocInfo, _commandBuffers.data()) != VK_SUCCESS) {
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, _commandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("Failed to allocate command buffers!");
         }
+
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, _uiCommandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate secondary command buffers!");
+        }
+
+        // Command pools can only be used from one thread at a time, so every recording thread
+        // gets its own pool for its scene secondaries
+        QueueFamilyIndices queueFamilyIndices = QueueFamilyIndices::findQueueFamilies(_vkDevice->_gpuInfo, _vkWindow->_surface);
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        _recordCommandPools.resize(_recordThreadCount);
+        for (uint32_t thread = 0; thread < _recordThreadCount; thread++) {
+            if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &_recordCommandPools[thread]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create recording command pool!");
+            }
+
+            std::vector<VkCommandBuffer> threadCommandBuffers(_framesInFlight);
+            allocInfo.commandPool = _recordCommandPools[thread];
+            allocInfo.commandBufferCount = _framesInFlight;
+            if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, threadCommandBuffers.data()) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate secondary command buffers!");
+            }
+            for (uint32_t frame = 0; frame < _framesInFlight; frame++) {
+                _sceneCommandBuffers[frame * _recordThreadCount + thread] = threadCommandBuffers[frame];
+            }
+        }
+
+        // freshly allocated buffers hold nothing, record the scene on first use
+        _recordedVisibility.assign(_framesInFlight, std::vector<uint8_t>());
+        this->invalidateCommandBuffers();
+    }
+
+    void VulkanSwapchain::invalidateCommandBuffers() {
+        _sceneCommandBuffersDirty.assign(_framesInFlight, true);
+    }
+
+    void VulkanSwapchain::recordSceneCommandBuffer(uint32_t frameIndex) {
+        SKIP_PROFILE_ZONE("recordSceneCommandBuffer");
+        // Static scene draws. Only re-recorded when the scene, pipeline or swap chain changes.
+        // The objects are split into one contiguous slice per recording thread and every slice
+        // goes into its own secondary, allocated from that thread's command pool
+        uint32_t sliceCount = _recordThreadCount;
+        size_t objectCount = _scene->_objects.size();
+        if (_visibility.size() != objectCount) {
+            // not culled yet (benchmark), draw everything
+            this->setAllVisible();
+        }
+        _recordThreads->parallelFor(sliceCount, [this, frameIndex, sliceCount, objectCount](uint32_t slice) {
+            size_t begin = objectCount * slice / sliceCount;
+            size_t end = objectCount * (slice + 1) / sliceCount;
+            this->recordSceneSlice(frameIndex, slice, begin, end);
+        });
+
+        _sceneCommandBuffersDirty[frameIndex] = false;
+        _recordedVisibility[frameIndex] = _visibility;
+        _recordedSceneVersion = _scene->_version;
+        _recordedGeometryVersion = this->getGeometryVersion();
+    }
+
+    void VulkanSwapchain::recordSceneSlice(uint32_t frameIndex, uint32_t slice, size_t begin, size_t end) {
+        SKIP_PROFILE_ZONE("recordSceneSlice");
+        // Runs on a worker thread, only touches the slice's own command buffer and objects
+        VkCommandBuffer commandBuffer = _sceneCommandBuffers[frameIndex * _recordThreadCount + slice];
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = _renderPass;
+        inheritanceInfo.subpass = 0;
+        // a slot renders into whichever image was acquired, so the framebuffer is left unknown
+        inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording scene command buffer!");
+        }
+        // the slices run back to back, the scene scope spans from the first one to the last
+        if (slice == 0) {
+            _gpuProfiler->begin(commandBuffer, frameIndex, _sceneScope);
+        }
+
+        // dynamic state is not inherited from the primary command buffer
+        VkViewport viewport{};
+        viewport.width = _swapChainExtent.width;
+        viewport.height = _swapChainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.extent.width = _swapChainExtent.width;
+        scissor.extent.height = _swapChainExtent.height;
+        scissor.offset.x = 0;
+        scissor.offset.y = 0;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // bindless: one set for every draw, bound once per secondary since bindings are not inherited
+        uint32_t frameFirstObject = frameIndex * _uniformObjectCapacity;
+        if (_bindless) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1,
+                &_bindlessDescriptorSet, 0, nullptr);
+        }
+
+        //Basic Drawing Commands
+        // one pass per vertex format, objects of a format share its pipeline and geometry buffer and
+        // each draw picks its range through firstIndex/vertexOffset
+        // instanced objects are drawn afterwards, they need the other pipeline
+        for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++) {
+            bool formatBound = false;
+            for (size_t j = begin; j < end; j++) {
+                SkipObject* object = _scene->_objects[j];
+                if (object->_instanced || !_visibility[j] || static_cast<uint32_t>(object->_geometryFormat) != format) {
+                    continue;
+                }
+                const GeometryRange& geometry = object->_geometry;
+                if (!formatBound) {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipelines[format]);
+                    _geometryBuffers[format]->bind(commandBuffer);
+                    formatBound = true;
+                }
+                if (_bindless) {
+                    uint32_t objectIndex = frameFirstObject + static_cast<uint32_t>(j);
+                    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                        sizeof(uint32_t), &objectIndex);
+                } else {
+                    if (object->_geometryFormat != VertexFormat::Full) {
+                        // quantized positions are relative to the object's own bounds
+                        vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                            sizeof(VertexDecodePushConstants), &object->_vertexDecode);
+                    }
+
+                    // dynamic offsets follow binding order, mvp (0) then light (2)
+                    VkDeviceSize objectOffset = frameIndex * _uniformFrameStride + j * _uniformObjectStride;
+                    std::array<uint32_t, 2> dynamicOffsets = {
+                        static_cast<uint32_t>(objectOffset),
+                        static_cast<uint32_t>(objectOffset + _uniformLightOffset)
+                    };
+
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1,
+                        &object->_descriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+                }
+
+                if (geometry.indexCount > 0) {
+                    vkCmdDrawIndexed(commandBuffer, geometry.indexCount, 1, geometry.firstIndex, geometry.vertexOffset, 0);
+                } else {
+                    vkCmdDraw(commandBuffer, geometry.vertexCount, 1, static_cast<uint32_t>(geometry.vertexOffset), 0);
+                }
+            }
+        }
+
+        bool instancedPipelineBound = false;
+        for (size_t j = begin; j < end; j++) {
+            if (!_scene->_objects[j]->_instanced) {
+                continue;
+            }
+            InstancedObject* object = static_cast<InstancedObject*>(_scene->_objects[j]);
+            const GeometryRange& geometry = object->_geometry;
+            object->_recordedInstanceCount = object->getInstanceCount();
+            if (object->_recordedInstanceCount == 0) {
+                continue;
+            }
+            if (!instancedPipelineBound) {
+                // instanced meshes always live in the full format buffer
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _instancedPipeline);
+                _geometryBuffers[static_cast<uint32_t>(VertexFormat::Full)]->bind(commandBuffer);
+                instancedPipelineBound = true;
+            }
+
+            if (_bindless) {
+                uint32_t objectIndex = frameFirstObject + static_cast<uint32_t>(j);
+                vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                    sizeof(uint32_t), &objectIndex);
+            } else {
+                VkDeviceSize objectOffset = frameIndex * _uniformFrameStride + j * _uniformObjectStride;
+                std::array<uint32_t, 2> dynamicOffsets = {
+                    static_cast<uint32_t>(objectOffset),
+                    static_cast<uint32_t>(objectOffset + _uniformLightOffset)
+                };
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1,
+                    &object->_descriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+            }
+
+            // this slot's region of the instance buffer
+            VkDeviceSize instanceOffset = sizeof(InstanceData) * object->_instanceCapacity * frameIndex;
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &object->_instanceBuffer, &instanceOffset);
+
+            if (geometry.indexCount > 0) {
+                vkCmdDrawIndexed(commandBuffer, geometry.indexCount, object->_recordedInstanceCount, geometry.firstIndex,
+                    geometry.vertexOffset, 0);
+            } else {
+                vkCmdDraw(commandBuffer, geometry.vertexCount, object->_recordedInstanceCount,
+                    static_cast<uint32_t>(geometry.vertexOffset), 0);
+            }
+        }
+
+        if (slice == _recordThreadCount - 1) {
+            _gpuProfiler->end(commandBuffer, frameIndex, _sceneScope);
+        }
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record scene command buffer!");
+        }
+    }
+
+    void VulkanSwapchain::cullScene() {
+        SKIP_PROFILE_ZONE("cullScene");
+        // Builds _visibility for the current camera. The scene BVH rejects whole subtrees and
+        // accepts the ones fully inside, objects on the frustum border are then tested in
+        // batches by their bounding spheres and the survivors once more by their boxes
+        size_t objectCount = _scene->_objects.size();
+        if (!_frustumCulling || objectCount == 0) {
+            this->setAllVisible();
+            return;
+        }
+        _scene->refit();
+        _frustum.update(_scene->_projection * _scene->_camera->GetViewMatrix());
+
+        // only the entries set last frame are cleared, the whole vector only when the scene changed size
+        if (_visibility.size() != objectCount) {
+            _visibility.assign(objectCount, 0);
+        } else {
+            for (uint32_t index : _visibleObjects) {
+                _visibility[index] = 0;
+            }
+        }
+        _visibleObjects.clear();
+        auto markVisible = [this](SkipObject* object) {
+            _visibility[object->_sceneIndex] = 1;
+            _visibleObjects.push_back(object->_sceneIndex);
+        };
+        // not in the tree, see SkipScene::_bvh
+        for (SkipObject* object : _scene->_instancedObjects) {
+            markVisible(object);
+        }
+
+        _cullX.clear();
+        _cullY.clear();
+        _cullZ.clear();
+        _cullRadius.clear();
+        _cullCandidates.clear();
+        _scene->queryFrustum(_frustum, [this, &markVisible](SkipObject* object, bool fullyInside) {
+            if (fullyInside) {
+                markVisible(object);
+                return;
+            }
+            const glm::mat4& model = object->_mvpUBO.model;
+            glm::vec3 center = glm::vec3(model * glm::vec4(object->_boundsCenter, 1.0f));
+            // non uniform scales grow the sphere by the largest axis
+            float scale = std::max(glm::length(glm::vec3(model[0])),
+                std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            _cullX.push_back(center.x);
+            _cullY.push_back(center.y);
+            _cullZ.push_back(center.z);
+            _cullRadius.push_back(object->_boundsRadius * scale);
+            _cullCandidates.push_back(object);
+        });
+
+        _cullVisible.resize(_cullCandidates.size());
+        cullSpheres(_frustum, _cullX.data(), _cullY.data(), _cullZ.data(), _cullRadius.data(),
+            static_cast<uint32_t>(_cullCandidates.size()), _cullVisible.data());
+        for (size_t i = 0; i < _cullCandidates.size(); i++) {
+            const Aabb& bounds = _cullCandidates[i]->_worldBounds;
+            if (_cullVisible[i] && _frustum.intersectsAabb(bounds.min, bounds.max)) {
+                markVisible(_cullCandidates[i]);
+            }
+        }
+
+        // every object is reported at most once, by the tree or as an instanced object
+        _culledObjectCount = static_cast<uint32_t>(objectCount - _visibleObjects.size());
+    }
+
+    void VulkanSwapchain::setAllVisible() {
+        size_t objectCount = _scene->_objects.size();
+        _visibility.assign(objectCount, 1);
+        _visibleObjects.resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++) {
+            _visibleObjects[i] = static_cast<uint32_t>(i);
+        }
+        _culledObjectCount = 0;
     }
 
-    void VulkanSwapchain::buildCommandBuffers() {
+    void VulkanSwapchain::recordUiCommandBuffer(uint32_t frameIndex) {
+        SKIP_PROFILE_ZONE("recordUiCommandBuffer");
+        // The UI changes every frame so it is recorded every frame
+        VkCommandBuffer commandBuffer = _uiCommandBuffers[frameIndex];
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = _renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording ui command buffer!");
+        }
+
+        _gpuProfiler->begin(commandBuffer, frameIndex, _uiScope);
+        _imguiContext->drawFrame(commandBuffer, frameIndex);
+        _gpuProfiler->end(commandBuffer, frameIndex, _uiScope);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record ui command buffer!");
+        }
+    }
+
+    void VulkanSwapchain::buildCommandBuffers(uint32_t imageIndex) {
+        SKIP_PROFILE_ZONE("buildCommandBuffers");
+        // Only the current frame slot is recorded. Its previous submission has been
+        // waited on in stageFrame so its command buffers are free to reuse
+        uint32_t frameIndex = static_cast<uint32_t>(_currentFrame);
+        if (_scene->_version != _recordedSceneVersion || this->getGeometryVersion() != _recordedGeometryVersion) {
+            // objects were added or removed, or the geometry buffer was reallocated, since the
+            // scene was last recorded
+            this->invalidateCommandBuffers();
+        }
+        this->cullScene();
+        if (_visibility != _recordedVisibility[frameIndex]) {
+            // the slot was recorded with a different set of visible objects
+            _sceneCommandBuffersDirty[frameIndex] = true;
+        }
+        if (_sceneCommandBuffersDirty[frameIndex]) {
+            this->recordSceneCommandBuffer(frameIndex);
+        }
+        this->recordUiCommandBuffer(frameIndex);
 
         std::array<VkClearValue, 2> clearValues{};
         clearValues[0] = { 0.0f, 0.0f, 0.0f, 1.0f };
@@ -1368,6 +2558,7 @@ namespace Skip {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = _renderPass;
+        renderPassInfo.framebuffer = _swapChainFramebuffers[imageIndex];
         renderPassInfo.renderArea.offset = { 0, 0 };
         renderPassInfo.renderArea.extent = _swapChainExtent;
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
@@ -1375,73 +2566,39 @@ namespace Skip {
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        _imguiContext->newFrame("test", "GPU_NAME", _frameTimer, true, _scene->_camera);
-        
-        _imguiContext->updateBuffers(*_vkDevice->getLogicalDevice(), _vkDevice->getPhysicalDevice());
-
-        // Command Buffer Recording
-        for (size_t i = 0; i < _commandBuffers.size(); i++) {
+        VkCommandBuffer commandBuffer = _commandBuffers[frameIndex];
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording command buffer!");
+        }
+        // uploads recorded since the last frame go to the transfer queue now, the frame waits on them
+        // only at the stages that use them
+        _uploadWaitValue = _uploads->acquire(commandBuffer, _uploadWaitStage);
 
-            renderPassInfo.framebuffer = _swapChainFramebuffers[i];
+        _gpuProfiler->beginFrame(commandBuffer, frameIndex);
+        _gpuProfiler->begin(commandBuffer, frameIndex, _frameScope);
 
-            if (vkBeginCommandBuffer(_commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-                throw std::runtime_error("Failed to begin recording command buffer!");
-            }
-            
-            vkCmdBeginRenderPass(_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            VkViewport viewport{};
-            viewport.width = _swapChainExtent.width;
-            viewport.height = _swapChainExtent.height;
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(_commandBuffers[i], 0, 1, &viewport);
-
-            VkRect2D scissor{};
-            scissor.extent.width = _swapChainExtent.width;
-            scissor.extent.height = _swapChainExtent.height;
-            scissor.offset.x = 0;
-            scissor.offset.y = 0;
-            vkCmdSetScissor(_commandBuffers[i], 0, 1, &scissor);
-
-            //Basic Drawing Commands
-            vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[i], 0, nullptr);
-            vkCmdBindPipeline(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _graphicsPipeline);
-            
-            for (size_t j = 0; j < _scene->_objects.size(); j++) {
-                VkDeviceSize offsets[] = { 0 };
-                
-                vkCmdBindVertexBuffers(_commandBuffers[i], 0, 1, &_scene->_objects[j]->_vertexBuffer, offsets);
-
-                if (_scene->_objects[j]->_useIndexBuffer) {
-                    vkCmdBindIndexBuffer(_commandBuffers[i], _scene->_objects[j]->_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-                    vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1,
-                        &_descriptorSets[j], 0, nullptr);
-
-                    vkCmdDrawIndexed(_commandBuffers[i], _scene->_objects[j]->_indices.size(), 1, 0, 0, 0);
-                } else {
-                    vkCmdBindDescriptorSets(_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1,
-                        &_descriptorSets[j], 0, nullptr);
-                    vkCmdDraw(_commandBuffers[i], _scene->_objects[j]->_vertices.size(), 1, 0, 0);
-                }
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            }
+        // the slot's scene slices in object order, then the UI on top
+        std::vector<VkCommandBuffer> secondaryCommandBuffers(_sceneCommandBuffers.begin() + frameIndex * _recordThreadCount,
+            _sceneCommandBuffers.begin() + (frameIndex + 1) * _recordThreadCount);
+        secondaryCommandBuffers.push_back(_uiCommandBuffers[frameIndex]);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
 
-            _imguiContext->drawFrame(_commandBuffers[i]);
+        vkCmdEndRenderPass(commandBuffer);
 
-            vkCmdEndRenderPass(_commandBuffers[i]);
-            if (vkEndCommandBuffer(_commandBuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("Failed to record command buffer!");
-            }
+        _gpuProfiler->end(commandBuffer, frameIndex, _frameScope);
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record command buffer!");
         }
     }
 
     void VulkanSwapchain::createSyncObjects() {
-        _imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        _renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        _inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        _imagesInFlight.resize(_swapChainImages.size(), VK_NULL_HANDLE);
+        _imageAvailableSemaphores.resize(_framesInFlight);
+        _renderFinishedSemaphores.resize(_framesInFlight);
+        _inFlightFences.resize(_framesInFlight);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1450,7 +2607,7 @@ namespace Skip {
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
         VkDevice logicalDevice = *_vkDevice->getLogicalDevice();
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < _framesInFlight; i++) {
             if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr,
                 &_imageAvailableSemaphores[i]) != VK_SUCCESS ||
                 vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr,
@@ -1463,10 +2620,29 @@ namespace Skip {
         }
     }
 
+    void VulkanSwapchain::createGpuProfiler() {
+        // Builds the following member variables:
+        //     _gpuProfiler
+        // The scopes written by buildCommandBuffers and the command buffers it executes
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(_vkDevice->getPhysicalDevice(), &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(_vkDevice->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+        uint32_t validBits = queueFamilies[_vkDevice->_queueFamilies.graphicsFamily.value()].timestampValidBits;
+
+        _gpuProfiler = new GpuProfiler(*_vkDevice->getLogicalDevice(), _vkDevice->_gpuInfo->properties.limits.timestampPeriod,
+            validBits, _framesInFlight);
+        _timestampsSupported = _gpuProfiler->isSupported();
+        _frameScope = _gpuProfiler->addScope("frame");
+        _sceneScope = _gpuProfiler->addScope("scene");
+        _uiScope = _gpuProfiler->addScope("imgui");
+    }
+
     void VulkanSwapchain::initImgui() {
         _imguiContext = new ImguiContext();
         _imguiContext->init((float)_swapChainExtent.width, (float)_swapChainExtent.height);
-        _imguiContext->initResources(*_vkDevice->getLogicalDevice(), _vkDevice->getPhysicalDevice(), _renderPass, _vkDevice->_queues.graphics, _commandPool, "resources/shaders/imgui", _vkDevice->_gpuInfo->msaaSamples);
+        _imguiContext->initResources(*_vkDevice->getLogicalDevice(), _vkDevice->_allocator, _renderPass, _vkDevice->_queues.graphics, _commandPool, "resources/shaders/imgui", _vkDevice->_gpuInfo->msaaSamples,
+            _pipelineCacheData);
     }
     
 }
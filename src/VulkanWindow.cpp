@@ -31,8 +31,10 @@ namespace Skip {
     }
 
     VulkanWindow::~VulkanWindow() {
-        glfwDestroyWindow(_glfw);
-        glfwTerminate();
+        if (_glfw != nullptr) {
+            glfwDestroyWindow(_glfw);
+            glfwTerminate();
+        }
     }
 
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -41,6 +43,10 @@ namespace Skip {
     }
 
     void VulkanWindow::init() {
+        if (_headless) {
+            // no display available, nothing to create
+            return;
+        }
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
@@ -55,6 +61,9 @@ namespace Skip {
     }
     
     bool VulkanWindow::shouldClose() {
+        if (_headless) {
+            return false;
+        }
         return glfwWindowShouldClose(_glfw);
     }
 
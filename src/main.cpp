@@ -3,6 +3,11 @@
 #include <objects/Model.h>
 #include <objects/Cube.h>
 #include <objects/Sphere.h>
+#include <objects/InstancedObject.h>
+#include <VertexWelder.h>
+#include <CpuProfiler.h>
+#include <cmath>
+#include <unordered_map>
 using namespace std;
 
 Skip::VulkanWindow* window;
@@ -10,8 +15,217 @@ Skip::VulkanManager* vulkanManager;
 Skip::VulkanSwapchain* swapchain;
 Skip::SkipScene* scene;
 
-int main()
+// Command line options
+//     --headless            render into offscreen images, no window or display needed
+//     --frames <count>      number of frames rendered in headless mode (default 1000)
+//     --width <pixels>      headless render target width
+//     --height <pixels>     headless render target height
+//     --frames-in-flight <n> how many frames the CPU may run ahead of the GPU (default 2)
+//     --instances <count>   adds a grid of instanced cubes drawn with a single draw call
+//     --objects <count>     adds a grid of individual cubes, one draw call each
+//     --record-threads <n>  threads recording the scene command buffers (default 1)
+//     --record-benchmark    measures scene recording time against thread count, then exits
+//     --resize-benchmark    headless only, resizes the render target every 10 frames and reports the latency
+//     --no-culling          draws every object, even outside the camera frustum
+//     --no-mesh-optimize    keeps meshes in the order they were loaded in
+//     --vertex-format <f>   full, compact or compact-color vertices for every non instanced mesh
+//     --load-report         prints how long loading each mesh and texture took
+//     --weld-benchmark <obj> compares vertex welding methods on an obj file, then exits
+//     --trace <file.json>   records CPU profiler zones and writes them as a Chrome trace on exit
+//     --bindless            one descriptor set for the whole scene, objects indexed by a push constant
+struct RunOptions {
+    bool headless = false;
+    uint32_t frameCount = 1000;
+    uint32_t width = 1200;
+    uint32_t height = 800;
+    uint32_t framesInFlight = 2;
+    uint32_t instanceCount = 0;
+    uint32_t objectCount = 0;
+    uint32_t recordThreads = 1;
+    bool recordBenchmark = false;
+    bool resizeBenchmark = false;
+    bool frustumCulling = true;
+    bool optimizeMeshes = true;
+    Skip::VertexFormat vertexFormat = Skip::VertexFormat::Full;
+    bool loadReport = false;
+    std::string weldBenchmarkPath;
+    std::string tracePath;
+    bool bindless = false;
+};
+
+RunOptions parseOptions(int argc, char** argv) {
+    RunOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            options.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--width" && hasValue) {
+            options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--height" && hasValue) {
+            options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--frames-in-flight" && hasValue) {
+            options.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--instances" && hasValue) {
+            options.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--objects" && hasValue) {
+            options.objectCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--record-threads" && hasValue) {
+            options.recordThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--record-benchmark") {
+            options.recordBenchmark = true;
+        } else if (arg == "--resize-benchmark") {
+            options.resizeBenchmark = true;
+        } else if (arg == "--no-culling") {
+            options.frustumCulling = false;
+        } else if (arg == "--no-mesh-optimize") {
+            options.optimizeMeshes = false;
+        } else if (arg == "--vertex-format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "full") {
+                options.vertexFormat = Skip::VertexFormat::Full;
+            } else if (format == "compact") {
+                options.vertexFormat = Skip::VertexFormat::Compact;
+            } else if (format == "compact-color") {
+                options.vertexFormat = Skip::VertexFormat::CompactColor;
+            } else {
+                throw std::runtime_error("Unknown vertex format: " + format);
+            }
+        } else if (arg == "--load-report") {
+            options.loadReport = true;
+        } else if (arg == "--weld-benchmark" && hasValue) {
+            options.weldBenchmarkPath = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        } else if (arg == "--bindless") {
+            options.bindless = true;
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
+void printFrameTimes(const std::string& label, std::vector<float> times) {
+    if (times.empty()) {
+        std::cout << label << ": no samples" << std::endl;
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    float total = 0.0f;
+    for (float time : times) {
+        total += time;
+    }
+    auto percentile = [&times](float p) {
+        return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))];
+    };
+    std::cout << label << " (ms): avg " << total / times.size()
+        << " min " << times.front()
+        << " p50 " << percentile(0.50f)
+        << " p95 " << percentile(0.95f)
+        << " p99 " << percentile(0.99f)
+        << " max " << times.back() << std::endl;
+}
+
+// the hash models used to be welded with, kept to compare against
+struct LegacyVertexHash {
+    size_t operator()(Skip::Vertex const& vertex) const {
+        return ((std::hash<glm::vec3>()(vertex.position) ^
+            (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+            (std::hash<glm::vec2>()(vertex.texCoord) << 1);
+    }
+};
+
+void runWeldBenchmark(const std::string& path) {
+    std::vector<Skip::Vertex> corners;
+    auto start = std::chrono::high_resolution_clock::now();
+    Skip::Model::readObj(path, corners);
+    float parseTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Welding " << path << ": " << corners.size() << " corners, parsed in " << parseTime << " ms" << std::endl;
+
+    // best of a few runs
+    const uint32_t iterations = 5;
+    auto measure = [&corners, iterations](const std::string& label, const std::function<size_t()>& weld) {
+        float best = std::numeric_limits<float>::max();
+        size_t vertexCount = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            vertexCount = weld();
+            best = std::min(best, std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start).count());
+        }
+        std::cout << "    " << label << ": " << best << " ms, " << vertexCount << " vertices" << std::endl;
+    };
+
+    measure("unordered_map", [&corners]() {
+        std::unordered_map<Skip::Vertex, uint32_t, LegacyVertexHash> uniqueVertices;
+        std::vector<Skip::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        indices.reserve(corners.size());
+        for (const Skip::Vertex& vertex : corners) {
+            if (uniqueVertices.count(vertex) == 0) {
+                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            indices.push_back(uniqueVertices[vertex]);
+        }
+        return vertices.size();
+    });
+    measure("open addressing", [&corners]() {
+        std::vector<Skip::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Skip::weldVerticesHashed(corners, vertices, indices);
+        return vertices.size();
+    });
+    measure("radix sort, 1 thread", [&corners]() {
+        std::vector<Skip::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Skip::weldVerticesSorted(corners, vertices, indices);
+        return vertices.size();
+    });
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    Skip::ThreadPool threads(threadCount - 1);
+    measure("radix sort, " + std::to_string(threadCount) + " threads", [&corners, &threads]() {
+        std::vector<Skip::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Skip::weldVerticesSorted(corners, vertices, indices, &threads);
+        return vertices.size();
+    });
+}
+
+// every exit path goes through here, so --trace works with the benchmarks too
+void writeTrace(const RunOptions& options) {
+    if (options.tracePath.empty()) {
+        return;
+    }
+    Skip::CpuProfiler::setEnabled(false);
+    if (!Skip::CpuProfiler::writeChromeTrace(options.tracePath)) {
+        std::cerr << "Failed to write trace " << options.tracePath << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
 {
+    RunOptions options = parseOptions(argc, argv);
+    SKIP_PROFILE_THREAD("main");
+    if (!options.tracePath.empty()) {
+#ifdef SKIP_PROFILING
+        // from the start, so asset loading is in the trace too
+        Skip::CpuProfiler::setEnabled(true);
+#else
+        std::cerr << "--trace: built without SKIP_PROFILING, no zones will be recorded" << std::endl;
+#endif
+    }
+
+    if (!options.weldBenchmarkPath.empty()) {
+        runWeldBenchmark(options.weldBenchmarkPath);
+        writeTrace(options);
+        return 0;
+    }
+
     bool enableValidationLayers = false;
     #ifndef NODEBUG
         enableValidationLayers = true;
@@ -54,45 +268,211 @@ int main()
     scene->addObject(modelObject, lightSphere);
     scene->addObject(sphere, lightSphere);
 
+    // one mesh, one texture and one draw for the whole grid
+    Skip::InstancedObject* cubes = nullptr;
+    if (options.instanceCount > 0) {
+        cubes = new Skip::InstancedObject("InstancedCubes", new Skip::Cube(glm::vec3(0.0f, 0.0f, 0.0f)), options.instanceCount);
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(options.instanceCount))));
+        for (uint32_t i = 0; i < options.instanceCount; i++) {
+            Skip::InstanceData instance;
+            float x = (static_cast<float>(i % side) - side * 0.5f) * 0.3f;
+            float z = (static_cast<float>(i / side) - side * 0.5f) * 0.3f;
+            instance.model = Skip::buildTranslate(x, -1.0f, z) * Skip::buildScale(0.1f, 0.1f, 0.1f);
+            instance.color = glm::vec4(0.5f + 0.5f * (i % 2), 0.5f + 0.5f * ((i / side) % 2), 1.0f, 1.0f);
+            cubes->addInstance(instance);
+        }
+        scene->addObject(cubes, lightSphere);
+    }
+
+    // the same grid as separate objects, mostly to put load on command buffer recording
+    std::vector<Skip::SkipObject*> gridObjects;
+    uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(options.objectCount))));
+    for (uint32_t i = 0; i < options.objectCount; i++) {
+        float x = (static_cast<float>(i % gridSide) - gridSide * 0.5f) * 0.3f;
+        float z = (static_cast<float>(i / gridSide) - gridSide * 0.5f) * 0.3f;
+        Skip::Cube* cube = new Skip::Cube("GridCube" + std::to_string(i), glm::vec3(x, 1.0f, z), DEFAULT_TEXTURE, true);
+        cube->_mvpUBO.model = cube->GetPositionMatrix() * Skip::buildScale(0.1f, 0.1f, 0.1f);
+        gridObjects.push_back(cube);
+        scene->addObject(cube, lightSphere);
+    }
+
+    for (Skip::SkipObject* object : scene->_objects) {
+        object->_optimizeMesh = options.optimizeMeshes;
+        object->_vertexFormat = options.vertexFormat;
+    }
+
     // create window
     // Window will create keys to events based on components
     window = new Skip::VulkanWindow(scene);
+    if (options.headless) {
+        window->_headless = true;
+        window->_width = options.width;
+        window->_height = options.height;
+    }
     window->init();
 
     vulkanManager = new Skip::VulkanManager(window, scene, enableValidationLayers);
     swapchain = vulkanManager->_vulkanSwapchain;
+    swapchain->setFramesInFlight(options.framesInFlight);
+    swapchain->setRecordThreadCount(options.recordThreads);
+    swapchain->_frustumCulling = options.frustumCulling;
+    if (options.bindless) {
+        if (swapchain->isBindlessSupported()) {
+            swapchain->setBindless(true);
+        } else {
+            std::cerr << "--bindless: the device does not support descriptor indexing, using descriptor sets per texture" << std::endl;
+        }
+    }
+    if (options.loadReport || options.headless) {
+        swapchain->_loadReport.print(std::cout);
+    }
+
+    if (options.recordBenchmark) {
+        // record the same scene with 1, 2, 4, ... threads up to the core count
+        const uint32_t iterations = 100;
+        uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        size_t drawCount = scene->_objects.size();
+        float singleThreadTime = 0.0f;
+        std::cout << "Scene recording: " << drawCount << " draws, " << iterations << " recordings per thread count" << std::endl;
+        for (uint32_t threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1) {
+            swapchain->setRecordThreadCount(threads);
+            swapchain->measureSceneRecording(10); // warm up
+            float recordTime = swapchain->measureSceneRecording(iterations);
+            if (threads == 1) {
+                singleThreadTime = recordTime;
+            }
+            std::cout << "    " << threads << " threads: " << recordTime << " ms per recording, "
+                << drawCount / std::max(recordTime, 0.0001f) << " draws/ms, "
+                << singleThreadTime / std::max(recordTime, 0.0001f) << "x" << std::endl;
+        }
+        writeTrace(options);
+        vulkanManager->~VulkanManager();
+        delete cubes;
+        return 0;
+    }
 
     uint32_t currentImage;
     float currentTime, deltaTime;
     float lastTime = 0.0;
     glm::mat4 mvMat;
 
-    while (!window->shouldClose()) {
-        glfwPollEvents();
+    // headless runs render a fixed number of frames and report timings
+    uint32_t framesRendered = 0;
+    std::vector<float> frameTimes, cpuFrameTimes, gpuFrameTimes;
+    std::vector<float> resizeTimes, resizeFrameTimes;
+    bool resized = false;
+    uint64_t culledObjects = 0;
+    auto runStart = std::chrono::high_resolution_clock::now();
+    auto frameStart = runStart;
 
-        currentImage = swapchain->stageFrame();
-        currentTime = glfwGetTime();
+    while (options.headless ? framesRendered < options.frameCount : !window->shouldClose()) {
+        SKIP_PROFILE_ZONE("frame");
+        if (options.headless) {
+            if (options.resizeBenchmark && framesRendered > 0 && framesRendered % 10 == 0) {
+                // alternate between the requested size and three quarters of it
+                bool shrink = (framesRendered / 10) % 2 == 1;
+                swapchain->resize(shrink ? options.width * 3 / 4 : options.width, shrink ? options.height * 3 / 4 : options.height);
+                resizeTimes.push_back(swapchain->_resizeTime);
+                resized = true;
+            }
+            currentImage = swapchain->stageFrame();
+            auto now = std::chrono::high_resolution_clock::now();
+            currentTime = std::chrono::duration<float>(now - runStart).count();
+        } else {
+            glfwPollEvents();
+            currentImage = swapchain->stageFrame();
+            currentTime = glfwGetTime();
+        }
         deltaTime = currentTime - lastTime;
         lastTime = currentTime;
 
-        window->processKeys(deltaTime);
+        if (!options.headless) {
+            SKIP_PROFILE_ZONE("processKeys");
+            window->processKeys(deltaTime);
+        }
+
+        {
+            SKIP_PROFILE_ZONE("update matrices");
+            modelObject->_mvpUBO.view = scene->_camera->GetViewMatrix();
+            mvMat = modelObject->_mvpUBO.view * modelObject->_mvpUBO.model;
+            modelObject->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
 
-        modelObject->_mvpUBO.view = scene->_camera->GetViewMatrix();
-        mvMat = modelObject->_mvpUBO.view * modelObject->_mvpUBO.model;
-        modelObject->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
+            lightSphere->_mvpUBO.view = scene->_camera->GetViewMatrix();
+            mvMat = lightSphere->_mvpUBO.view * lightSphere->_mvpUBO.model;
+            lightSphere->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
 
-        lightSphere->_mvpUBO.view = scene->_camera->GetViewMatrix();
-        mvMat = lightSphere->_mvpUBO.view * lightSphere->_mvpUBO.model;
-        lightSphere->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
+            sphere->_mvpUBO.view = scene->_camera->GetViewMatrix();
+            mvMat = sphere->_mvpUBO.view * sphere->_mvpUBO.model;
+            sphere->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
 
-        sphere->_mvpUBO.view = scene->_camera->GetViewMatrix();
-        mvMat = sphere->_mvpUBO.view * sphere->_mvpUBO.model;
-        sphere->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
+            for (Skip::SkipObject* object : gridObjects) {
+                object->_mvpUBO.view = scene->_camera->GetViewMatrix();
+                mvMat = object->_mvpUBO.view * object->_mvpUBO.model;
+                object->_mvpUBO.norm = glm::transpose(glm::inverse((mvMat)));
+            }
 
-        swapchain->updateUniformBuffers(currentImage);
+            if (cubes != nullptr) {
+                // model and normal matrices come from the instances
+                cubes->_mvpUBO.view = scene->_camera->GetViewMatrix();
+            }
+        }
+
+        swapchain->updateUniformBuffers();
+
+        vulkanManager->drawFrame(currentImage, deltaTime);
+
+        if (options.headless) {
+            auto frameEnd = std::chrono::high_resolution_clock::now();
+            float frameTime = std::chrono::duration<float, std::milli>(frameEnd - frameStart).count();
+            frameStart = frameEnd;
+            // the first frames include pipeline warm up, leave them out of the report
+            if (resized) {
+                // re-records the scene, reported on its own
+                resizeFrameTimes.push_back(frameTime);
+                resized = false;
+            } else if (framesRendered > 0) {
+                frameTimes.push_back(frameTime);
+                culledObjects += swapchain->_culledObjectCount;
+                cpuFrameTimes.push_back(std::max(0.0f, frameTime - swapchain->_cpuWaitTime));
+                if (swapchain->_timestampsSupported && framesRendered >= swapchain->_framesInFlight) {
+                    gpuFrameTimes.push_back(swapchain->_gpuFrameTime);
+                }
+            }
+            framesRendered++;
+        }
+    }
 
-        vulkanManager->drawFrame(currentImage);
+    if (options.headless) {
+        vkDeviceWaitIdle(*vulkanManager->_vulkanDevice->getLogicalDevice());
+        std::cout << "Headless run: " << framesRendered << " frames at " << options.width << "x" << options.height
+            << " with " << swapchain->_framesInFlight << " frames in flight, " << swapchain->_recordThreadCount << " recording threads"
+            << (swapchain->_bindless ? ", bindless" : "")
+            << " on " << vulkanManager->_vulkanDevice->_gpuInfo->properties.deviceName << std::endl;
+        printFrameTimes("Frame time", frameTimes);
+        printFrameTimes("CPU frame time", cpuFrameTimes);
+        printFrameTimes("GPU frame time", gpuFrameTimes);
+        // the last GpuProfiler::HISTORY_SIZE frames of each pass
+        const Skip::GpuProfiler* profiler = swapchain->_gpuProfiler;
+        for (uint32_t i = 0; swapchain->_timestampsSupported && i < profiler->getScopes().size(); i++) {
+            std::cout << "    GPU " << profiler->getScopes()[i].name << " (ms): p50 " << profiler->getPercentile(i, 0.50f)
+                << " p95 " << profiler->getPercentile(i, 0.95f) << " p99 " << profiler->getPercentile(i, 0.99f) << std::endl;
+        }
+        if (options.resizeBenchmark) {
+            printFrameTimes("Resize", resizeTimes);
+            printFrameTimes("Frame after resize", resizeFrameTimes);
+        }
+        std::cout << "Frustum culling: " << (options.frustumCulling ? "on" : "off") << ", avg "
+            << (frameTimes.empty() ? 0.0 : static_cast<double>(culledObjects) / frameTimes.size())
+            << " of " << scene->_objects.size() << " objects culled per frame" << std::endl;
+        std::cout << "Scene BVH: " << scene->_bvh.getProxyCount() << " objects, height " << scene->_bvh.getHeight() << std::endl;
+        vulkanManager->_vulkanDevice->_allocator->printStats(std::cout);
+        Skip::DescriptorAllocatorStats descriptorStats = swapchain->_descriptorAllocator->getStats();
+        std::cout << "Descriptor sets: " << descriptorStats.setCount << " in " << descriptorStats.poolCount << " pools, "
+            << descriptorStats.freeSetCount << " free, " << descriptorStats.transientSetCount << " transient" << std::endl;
     }
+    writeTrace(options);
     vulkanManager->~VulkanManager();
+    // takes the cube mesh with it
+    delete cubes;
     return 0;
 }
@@ -1,4 +1,5 @@
 #include <objects/Cube.h>
+#include <VertexWelder.h>
 
 namespace Skip {
 
@@ -19,16 +20,11 @@ namespace Skip {
     }
 
     void Cube::loadObject(float aspect) {
-        for (auto vertex : CUBE_VERTICES) {
-            if (_useIndexBuffer) {
-                if (_uniqueVertices.count(vertex) == 0) {
-                    _uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-                    _vertices.push_back(vertex);
-                }
-                _indices.push_back(_uniqueVertices[vertex]);
-            } else {
-                _vertices.push_back(vertex);
-            }
+        std::vector<Vertex> corners(CUBE_VERTICES.begin(), CUBE_VERTICES.end());
+        if (_useIndexBuffer) {
+            weldVertices(corners, _vertices, _indices, _weldTolerance);
+        } else {
+            _vertices = std::move(corners);
         }
 
         glm::mat4 pMat = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
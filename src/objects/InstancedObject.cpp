@@ -0,0 +1,107 @@
+#include <objects/InstancedObject.h>
+
+namespace Skip {
+
+    InstancedObject::InstancedObject(std::string name, SkipObject* mesh, uint32_t capacity)
+        : SkipObject(name, mesh->_position, mesh->_texturePath, mesh->_useIndexBuffer) {
+        _mesh = mesh;
+        _instanced = true;
+        _instanceCapacity = std::max<uint32_t>(capacity, 1);
+    }
+
+    InstancedObject::InstancedObject(SkipObject* mesh, uint32_t capacity)
+        : InstancedObject(DEFAULT_INSTANCED_NAME, mesh, capacity) {
+    }
+
+    InstancedObject::~InstancedObject() {
+        delete _mesh;
+    }
+
+    void InstancedObject::loadObject(float aspect) {
+        // the scene only sets the flag on objects it holds, never on the mesh
+        _mesh->_optimizeMesh = _optimizeMesh;
+        _mesh->loadObject(aspect);
+        _vertices = _mesh->_vertices;
+        _indices = _mesh->_indices;
+        _mappedMesh = _mesh->_mappedMesh;
+        _meshOptimized = _mesh->_meshOptimized;
+        _vertexCacheBefore = _mesh->_vertexCacheBefore;
+        _vertexCacheAfter = _mesh->_vertexCacheAfter;
+
+        _mvpUBO.proj = _mesh->_mvpUBO.proj;
+        if (!_inheritLighting) {
+            _lightUBO.position = _position;
+        }
+    }
+
+    uint32_t InstancedObject::addInstance(const InstanceData& instance) {
+        uint32_t index = static_cast<uint32_t>(_instances.size());
+        _instances.push_back(instance);
+        this->markDirty(index, index + 1);
+        return index;
+    }
+
+    void InstancedObject::setInstance(uint32_t index, const InstanceData& instance) {
+        if (index >= _instances.size()) {
+            throw std::runtime_error("Instance index out of range!");
+        }
+        _instances[index] = instance;
+        this->markDirty(index, index + 1);
+    }
+
+    void InstancedObject::removeInstance(uint32_t index) {
+        if (index >= _instances.size()) {
+            throw std::runtime_error("Instance index out of range!");
+        }
+        uint32_t last = static_cast<uint32_t>(_instances.size() - 1);
+        if (index != last) {
+            _instances[index] = _instances[last];
+            this->markDirty(index, index + 1);
+        }
+        _instances.pop_back();
+    }
+
+    void InstancedObject::clearInstances() {
+        _instances.clear();
+    }
+
+    void InstancedObject::markDirty(uint32_t begin, uint32_t end) {
+        // every frame slot has its own copy, so each one has to see the change
+        for (auto& range : _dirtyRanges) {
+            if (range.first >= range.second) {
+                range = { begin, end };
+            } else {
+                range.first = std::min(range.first, begin);
+                range.second = std::max(range.second, end);
+            }
+        }
+    }
+
+    VkVertexInputBindingDescription InstanceData::getBindingDescription() {
+        // binding 1 advances once per instance instead of once per vertex
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescription;
+    }
+
+    std::array<VkVertexInputAttributeDescription, 5> InstanceData::getAttributeDescriptions() {
+        // a mat4 attribute takes four locations, one per column. Locations continue after Vertex
+        std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+        for (uint32_t i = 0; i < 4; i++) {
+            attributeDescriptions[i].binding = 1;
+            attributeDescriptions[i].location = 5 + i;
+            attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[i].offset = offsetof(InstanceData, model) + i * sizeof(glm::vec4);
+        }
+
+        attributeDescriptions[4].binding = 1;
+        attributeDescriptions[4].location = 9;
+        attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[4].offset = offsetof(InstanceData, color);
+
+        return attributeDescriptions;
+    }
+}
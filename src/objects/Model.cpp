@@ -1,4 +1,7 @@
 #include <objects/Model.h>
+#include <CpuProfiler.h>
+#include <MeshCache.h>
+#include <VertexWelder.h>
 
 namespace Skip {
 
@@ -27,12 +30,41 @@ namespace Skip {
     }
 
     void Model::loadObject(float aspect) {
+        SKIP_PROFILE_ZONE("Model::loadObject");
+        // parsing large obj files dominates startup, later runs read the cached result instead
+        if (!loadMeshCache(_modelPath, this)) {
+            std::vector<Vertex> corners;
+            readObj(_modelPath, corners);
+            if (_useIndexBuffer) {
+                SKIP_PROFILE_ZONE("weldVertices");
+                weldVertices(corners, _vertices, _indices, _weldTolerance);
+            } else {
+                _vertices = std::move(corners);
+            }
+            // optimized before caching, so later loads skip it too
+            if (_optimizeMesh) {
+                this->optimizeMesh();
+            }
+            storeMeshCache(_modelPath, this);
+        }
+
+        glm::mat4 pMat = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
+        pMat[1][1] *= -1;
+
+        _mvpUBO.proj = pMat;
+        if (!_inheritLighting) {
+            _lightUBO.position = _position;
+        }
+    }
+
+    void Model::readObj(const std::string& path, std::vector<Vertex>& corners) {
+        SKIP_PROFILE_ZONE("readObj");
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, _modelPath.c_str())) {
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
             throw std::runtime_error(warn + err);
         }
 
@@ -41,6 +73,12 @@ namespace Skip {
         // in our case, we are ignoring material/texture per face
 
         //combine all faces in the file into a single model
+        size_t cornerCount = 0;
+        for (const auto& shape : shapes) {
+            cornerCount += shape.mesh.indices.size();
+        }
+        corners.clear();
+        corners.reserve(cornerCount);
         for (const auto& shape : shapes) {
             for (const auto& index : shape.mesh.indices) {
                 Vertex vertex{};
@@ -65,27 +103,9 @@ namespace Skip {
                 };
 
                 vertex.color = { 1.0f, 1.0f, 1.0f };
-                if (_useIndexBuffer) {
-                    if (_uniqueVertices.count(vertex) == 0) {
-                        _uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-                        _vertices.push_back(vertex);
-                    }
-                    _indices.push_back(_uniqueVertices[vertex]);
-                } else {
-                    _vertices.push_back(vertex);
-                }
-
-                
+                corners.push_back(vertex);
             }
         }
-
-        glm::mat4 pMat = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 1000.0f);
-        pMat[1][1] *= -1;
-
-        _mvpUBO.proj = pMat;
-        if (!_inheritLighting) {
-            _lightUBO.position = _position;
-        }
     }
 
 }
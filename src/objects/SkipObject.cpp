@@ -1,4 +1,8 @@
 #include <objects/SkipObject.h>
+#include <CpuProfiler.h>
+#include <MeshCache.h>
+#include <algorithm>
+#include <cmath>
 
 namespace Skip {
 
@@ -27,51 +31,89 @@ namespace Skip {
         _children.push_back(child);
     }
 
-    glm::mat4 SkipObject::GetPositionMatrix() {
-        return buildTranslate(_position.x, _position.y, _position.z);
+    const Vertex* SkipObject::getVertexData() const {
+        return _mappedMesh ? _mappedMesh->vertices : _vertices.data();
     }
 
-    VkVertexInputBindingDescription Vertex::getBindingDescription() {
-        // manage attribute binding per vertex
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0; // specifies the index of the binding in the array of bindings
-        bindingDescription.stride = sizeof(Vertex); // number of bytes from one entry to next
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    size_t SkipObject::getVertexCount() const {
+        return _mappedMesh ? _mappedMesh->vertexCount : _vertices.size();
+    }
 
-        return bindingDescription;
+    const uint32_t* SkipObject::getIndexData() const {
+        return _mappedMesh ? _mappedMesh->indices : _indices.data();
     }
 
-    std::array<VkVertexInputAttributeDescription, 5> Vertex::getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
-        // we have two attributes: position and color (hence the size)
-        attributeDescriptions[0].binding = 0; // binding the per-vertex data
-        attributeDescriptions[0].location = 0; // location directive of the input in the vertex shader
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; // type of data (look at reference guide)
-        attributeDescriptions[0].offset = offsetof(Vertex, position); // specifies the number of bytes since the start of the per-vertex data
+    size_t SkipObject::getIndexCount() const {
+        return _mappedMesh ? _mappedMesh->indexCount : _indices.size();
+    }
 
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
+    void SkipObject::optimizeMesh() {
+        SKIP_PROFILE_ZONE("optimizeMesh");
+        // a mapped mesh was optimized before it was cached
+        if (!_useIndexBuffer || _mappedMesh || _indices.size() < 3) {
+            return;
+        }
+        _vertexCacheBefore = analyzeVertexCache(_indices, _vertices.size());
+
+        std::vector<uint32_t> clusters;
+        optimizeVertexCache(_indices, _vertices.size(), clusters);
+        optimizeOverdraw(_indices, &_vertices[0].position.x, sizeof(Vertex), _vertices.size(), clusters);
+
+        std::vector<uint32_t> remap = optimizeVertexFetch(_indices, _vertices.size());
+        // unreferenced vertices are dropped
+        size_t usedCount = std::count_if(remap.begin(), remap.end(), [](uint32_t index) { return index != UNUSED_VERTEX; });
+        std::vector<Vertex> vertices(usedCount);
+        for (size_t i = 0; i < remap.size(); i++) {
+            if (remap[i] != UNUSED_VERTEX) {
+                vertices[remap[i]] = _vertices[i];
+            }
+        }
+        _vertices.swap(vertices);
 
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+        _vertexCacheAfter = analyzeVertexCache(_indices, _vertices.size());
+        _meshOptimized = true;
+    }
 
-        attributeDescriptions[3].binding = 0;
-        attributeDescriptions[3].location = 3;
-        attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[3].offset = offsetof(Vertex, normal);
+    void SkipObject::computeBounds() {
+        const Vertex* vertices = this->getVertexData();
+        size_t vertexCount = this->getVertexCount();
+        if (vertexCount == 0) {
+            return;
+        }
+        _boundsMin = vertices[0].position;
+        _boundsMax = vertices[0].position;
+        for (size_t i = 0; i < vertexCount; i++) {
+            const Vertex& vertex = vertices[i];
+            _boundsMin = glm::min(_boundsMin, vertex.position);
+            _boundsMax = glm::max(_boundsMax, vertex.position);
+        }
 
-        attributeDescriptions[4].binding = 0;
-        attributeDescriptions[4].location = 4;
-        attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[4].offset = offsetof(Vertex, tangent);
+        // sphere around the box center, tighter than the box's own bounding sphere
+        _boundsCenter = (_boundsMin + _boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for (size_t i = 0; i < vertexCount; i++) {
+            glm::vec3 offset = vertices[i].position - _boundsCenter;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        _boundsRadius = std::sqrt(radiusSquared);
+    }
 
-        return attributeDescriptions;
+    void SkipObject::updateWorldBounds() {
+        // every axis of the model matrix stretches the box along that axis' direction (Arvo)
+        const glm::mat4& model = _mvpUBO.model;
+        _worldBounds.min = glm::vec3(model[3]);
+        _worldBounds.max = _worldBounds.min;
+        for (int column = 0; column < 3; column++) {
+            glm::vec3 a = glm::vec3(model[column]) * _boundsMin[column];
+            glm::vec3 b = glm::vec3(model[column]) * _boundsMax[column];
+            _worldBounds.min += glm::min(a, b);
+            _worldBounds.max += glm::max(a, b);
+        }
     }
 
+    glm::mat4 SkipObject::GetPositionMatrix() {
+        return buildTranslate(_position.x, _position.y, _position.z);
+    }
 
     float toRadians(float degrees) {
         return (degrees * 2.0f * 3.14159f) / 360.0f;
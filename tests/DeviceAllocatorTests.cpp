@@ -0,0 +1,282 @@
+#include <DeviceAllocator.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+// The allocator only needs a handful of entry points, they are faked here so the buddy and
+// linear logic can run without a device
+namespace {
+
+    struct FakeDevice {
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        VkDeviceSize bufferImageGranularity = 1;
+        VkDeviceSize nonCoherentAtomSize = 64;
+        uint64_t nextMemory = 1;
+        std::map<VkDeviceMemory, VkDeviceSize> memory;
+        std::map<VkDeviceMemory, std::unique_ptr<char[]>> mapped; // only host visible blocks get backing
+        std::vector<VkMappedMemoryRange> flushedRanges;
+    };
+
+    FakeDevice fake;
+
+    const uint32_t DEVICE_LOCAL_TYPE = 0;
+    const uint32_t HOST_COHERENT_TYPE = 1;
+    const uint32_t HOST_CACHED_TYPE = 2;
+
+    // a 4GB device local heap and a 256MB host visible one, like a discrete GPU without resizable BAR
+    void resetFakeDevice(VkDeviceSize bufferImageGranularity = 1) {
+        fake = FakeDevice{};
+        fake.bufferImageGranularity = bufferImageGranularity;
+        VkPhysicalDeviceMemoryProperties& properties = fake.memoryProperties;
+        properties.memoryHeapCount = 2;
+        properties.memoryHeaps[0].size = 4ull * 1024 * 1024 * 1024;
+        properties.memoryHeaps[1].size = 256ull * 1024 * 1024;
+        properties.memoryTypeCount = 3;
+        properties.memoryTypes[DEVICE_LOCAL_TYPE] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+        properties.memoryTypes[HOST_COHERENT_TYPE] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+        properties.memoryTypes[HOST_CACHED_TYPE] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1 };
+    }
+
+    VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment = 1) {
+        VkMemoryRequirements result{};
+        result.size = size;
+        result.alignment = alignment;
+        result.memoryTypeBits = ~0u;
+        return result;
+    }
+
+    class DeviceAllocatorTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            resetFakeDevice();
+        }
+    };
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* properties) {
+    *properties = fake.memoryProperties;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* properties) {
+    *properties = VkPhysicalDeviceProperties{};
+    properties->limits.bufferImageGranularity = fake.bufferImageGranularity;
+    properties->limits.nonCoherentAtomSize = fake.nonCoherentAtomSize;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* allocateInfo,
+    const VkAllocationCallbacks*, VkDeviceMemory* memory) {
+    *memory = reinterpret_cast<VkDeviceMemory>(static_cast<uintptr_t>(fake.nextMemory++));
+    fake.memory[*memory] = allocateInfo->allocationSize;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) {
+    fake.memory.erase(memory);
+    fake.mapped.erase(memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize,
+    VkMemoryMapFlags, void** data) {
+    fake.mapped[memory] = std::unique_ptr<char[]>(new char[fake.memory[memory]]);
+    *data = fake.mapped[memory].get() + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice, uint32_t rangeCount, const VkMappedMemoryRange* ranges) {
+    fake.flushedRanges.insert(fake.flushedRanges.end(), ranges, ranges + rangeCount);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements*) {
+    ADD_FAILURE() << "not faked";
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) {
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage, VkMemoryRequirements*) {
+    ADD_FAILURE() << "not faked";
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) {
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+}
+
+TEST_F(DeviceAllocatorTest, RoundsUpToPowerOfTwoNodes) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    Skip::MemoryAllocation small = allocator.allocate(requirements(100), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(small.size, Skip::DeviceAllocator::MIN_BUDDY_SIZE);
+    EXPECT_EQ(small.offset, 0u);
+    EXPECT_EQ(small.order, 0u);
+
+    Skip::MemoryAllocation odd = allocator.allocate(requirements(3000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(odd.size, 4096u);
+    EXPECT_EQ(odd.order, 4u);
+    EXPECT_EQ(odd.offset % 4096, 0u);
+    EXPECT_EQ(odd.memory, small.memory);
+
+    Skip::AllocatorStats stats = allocator.getStats();
+    EXPECT_EQ(stats.longLived.blockCount, 1u);
+    EXPECT_EQ(stats.longLived.allocationCount, 2u);
+    EXPECT_EQ(stats.longLived.bytesUsed, 256u + 4096u);
+    EXPECT_EQ(stats.longLived.bytesReserved, Skip::DeviceAllocator::LONG_LIVED_BLOCK_SIZE);
+}
+
+TEST_F(DeviceAllocatorTest, HonoursAlignment) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Skip::MemoryAllocation aligned = allocator.allocate(requirements(300, 65536), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(aligned.offset % 65536, 0u);
+    EXPECT_GE(aligned.size, 65536u);
+}
+
+TEST_F(DeviceAllocatorTest, BuddiesMergeBackIntoTheWholeBlock) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    std::vector<Skip::MemoryAllocation> allocations;
+    for (uint32_t i = 0; i < 64; i++) {
+        allocations.push_back(allocator.allocate(requirements(256 << (i % 5)), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    }
+    // free in an order that leaves holes until the very end
+    for (size_t i = 0; i < allocations.size(); i += 2) {
+        allocator.free(allocations[i]);
+    }
+    for (size_t i = 1; i < allocations.size(); i += 2) {
+        allocator.free(allocations[i]);
+    }
+    EXPECT_EQ(allocator.getStats().longLived.bytesUsed, 0u);
+
+    // half a block is the largest sub-allocation, both halves only fit if everything coalesced
+    VkMemoryRequirements half = requirements(Skip::DeviceAllocator::LONG_LIVED_BLOCK_SIZE / 2);
+    Skip::MemoryAllocation lower = allocator.allocate(half, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Skip::MemoryAllocation upper = allocator.allocate(half, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(lower.offset, 0u);
+    EXPECT_EQ(upper.offset, half.size);
+    EXPECT_EQ(allocator.getStats().deviceMemoryCount, 1u);
+}
+
+TEST_F(DeviceAllocatorTest, RandomAllocationsNeverOverlap) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> sizes(1, 256 * 1024);
+    std::uniform_int_distribution<uint32_t> alignments(0, 12);
+    std::vector<Skip::MemoryAllocation> live;
+
+    for (uint32_t i = 0; i < 20000; i++) {
+        if (!live.empty() && random() % 3 == 0) {
+            size_t index = random() % live.size();
+            allocator.free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+            continue;
+        }
+        VkDeviceSize size = sizes(random);
+        VkDeviceSize alignment = VkDeviceSize(1) << alignments(random);
+        Skip::MemoryAllocation allocation = allocator.allocate(requirements(size, alignment), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        ASSERT_TRUE(allocation.isValid());
+        ASSERT_GE(allocation.size, size);
+        ASSERT_EQ(allocation.offset % alignment, 0u);
+        live.push_back(allocation);
+    }
+
+    std::sort(live.begin(), live.end(), [](const Skip::MemoryAllocation& a, const Skip::MemoryAllocation& b) {
+        return a.memory != b.memory ? a.memory < b.memory : a.offset < b.offset;
+    });
+    for (size_t i = 1; i < live.size(); i++) {
+        if (live[i].memory == live[i - 1].memory) {
+            ASSERT_GE(live[i].offset, live[i - 1].offset + live[i - 1].size);
+        }
+    }
+
+    for (Skip::MemoryAllocation& allocation : live) {
+        allocator.free(allocation);
+    }
+    EXPECT_EQ(allocator.getStats().longLived.bytesUsed, 0u);
+    EXPECT_EQ(allocator.getStats().longLived.allocationCount, 0u);
+}
+
+TEST_F(DeviceAllocatorTest, LargeAllocationsAreDedicated) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    VkDeviceSize size = Skip::DeviceAllocator::LONG_LIVED_BLOCK_SIZE / 2 + 1;
+    Skip::MemoryAllocation large = allocator.allocate(requirements(size), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(large.offset, 0u);
+    EXPECT_EQ(large.size, size);
+    EXPECT_EQ(allocator.getStats().dedicated.blockCount, 1u);
+    EXPECT_EQ(allocator.getStats().longLived.blockCount, 0u);
+
+    allocator.free(large);
+    EXPECT_FALSE(large.isValid());
+    EXPECT_EQ(allocator.getStats().deviceMemoryCount, 0u);
+    EXPECT_EQ(fake.memory.size(), 0u);
+}
+
+TEST_F(DeviceAllocatorTest, SmallHeapsGetSmallerBlocks) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // an eighth of the 256MB heap
+    EXPECT_EQ(allocator.getStats().longLived.bytesReserved, 32ull * 1024 * 1024);
+}
+
+TEST_F(DeviceAllocatorTest, TransientBlocksRewindWhenEmpty) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    Skip::MemoryAllocation first = allocator.allocate(requirements(1000), hostVisible, Skip::MemoryPool::Transient);
+    Skip::MemoryAllocation second = allocator.allocate(requirements(1000, 512), hostVisible, Skip::MemoryPool::Transient);
+    EXPECT_EQ(first.offset, 0u);
+    EXPECT_EQ(second.offset, 1024u);
+    EXPECT_EQ(second.mapped, static_cast<char*>(first.mapped) + 1024);
+
+    // freeing one of them does not rewind, the head only goes back once the block is empty
+    allocator.free(first);
+    Skip::MemoryAllocation third = allocator.allocate(requirements(100), hostVisible, Skip::MemoryPool::Transient);
+    EXPECT_EQ(third.offset, 2024u);
+
+    allocator.free(second);
+    allocator.free(third);
+    Skip::MemoryAllocation rewound = allocator.allocate(requirements(100), hostVisible, Skip::MemoryPool::Transient);
+    EXPECT_EQ(rewound.offset, 0u);
+    EXPECT_EQ(allocator.getStats().transient.blockCount, 1u);
+}
+
+TEST_F(DeviceAllocatorTest, KeepsResourcesOnSeparateGranularityPages) {
+    resetFakeDevice(4096);
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    Skip::MemoryAllocation a = allocator.allocate(requirements(100), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    Skip::MemoryAllocation b = allocator.allocate(requirements(100), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    EXPECT_EQ(a.size, 4096u);
+    EXPECT_EQ(b.offset, 4096u);
+
+    VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    Skip::MemoryAllocation c = allocator.allocate(requirements(100), hostVisible, Skip::MemoryPool::Transient);
+    Skip::MemoryAllocation d = allocator.allocate(requirements(100), hostVisible, Skip::MemoryPool::Transient);
+    EXPECT_EQ(d.offset - c.offset, 4096u);
+}
+
+TEST_F(DeviceAllocatorTest, FlushesWidenToNonCoherentAtoms) {
+    Skip::DeviceAllocator allocator(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    Skip::MemoryAllocation coherent = allocator.allocate(requirements(1000),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    EXPECT_EQ(allocator.flush(coherent), VK_SUCCESS);
+    EXPECT_TRUE(fake.flushedRanges.empty());
+
+    allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    Skip::MemoryAllocation cached = allocator.allocate(requirements(1000),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    ASSERT_EQ(cached.memoryType, HOST_CACHED_TYPE);
+    EXPECT_EQ(allocator.flush(cached, 10, 100), VK_SUCCESS);
+    ASSERT_EQ(fake.flushedRanges.size(), 1u);
+    EXPECT_EQ(fake.flushedRanges[0].offset, cached.offset);
+    EXPECT_EQ(fake.flushedRanges[0].size, 128u);
+}
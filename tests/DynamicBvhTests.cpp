@@ -0,0 +1,207 @@
+#include <DynamicBvh.h>
+
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+    // user data is the index into the test's own box list
+    void* toUserData(size_t index) {
+        return reinterpret_cast<void*>(static_cast<uintptr_t>(index));
+    }
+
+    size_t fromUserData(void* userData) {
+        return static_cast<size_t>(reinterpret_cast<uintptr_t>(userData));
+    }
+
+    Skip::Aabb cube(const glm::vec3& center, float halfSize) {
+        return Skip::Aabb{ center - glm::vec3(halfSize), center + glm::vec3(halfSize) };
+    }
+
+    // random unit cubes, some moved around and some removed, so the tree has seen every operation
+    class DynamicBvhTest : public ::testing::Test {
+    protected:
+        static constexpr size_t COUNT = 5000;
+
+        Skip::DynamicBvh bvh;
+        std::vector<Skip::Aabb> boxes;
+        std::vector<int32_t> proxies;
+        std::vector<bool> alive;
+        std::mt19937 random{ 7 };
+
+        void SetUp() override {
+            std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+            for (size_t i = 0; i < COUNT; i++) {
+                boxes.push_back(cube(glm::vec3(position(random), position(random), position(random)), 0.5f));
+                proxies.push_back(bvh.insert(boxes[i], toUserData(i)));
+                alive.push_back(true);
+            }
+            for (size_t i = 0; i < COUNT; i += 2) {
+                boxes[i] = cube(glm::vec3(position(random), position(random), position(random)), 0.5f);
+                bvh.move(proxies[i], boxes[i]);
+            }
+            for (size_t i = 0; i < COUNT; i += 3) {
+                bvh.remove(proxies[i]);
+                alive[i] = false;
+            }
+        }
+
+        std::set<size_t> queryAabb(const Skip::Aabb& query) const {
+            std::set<size_t> result;
+            bvh.queryAabb(query, [&](int32_t proxy) {
+                result.insert(fromUserData(bvh.getUserData(proxy)));
+            });
+            return result;
+        }
+
+        std::set<size_t> bruteForceAabb(const Skip::Aabb& query) const {
+            std::set<size_t> result;
+            for (size_t i = 0; i < COUNT; i++) {
+                if (alive[i] && bvh.getFatAabb(proxies[i]).overlaps(query)) {
+                    result.insert(i);
+                }
+            }
+            return result;
+        }
+    };
+
+}
+
+TEST_F(DynamicBvhTest, QueryAabbMatchesBruteForce) {
+    EXPECT_EQ(bvh.getProxyCount(), COUNT - (COUNT + 2) / 3);
+    for (float size : { 1.0f, 10.0f, 40.0f, 250.0f }) {
+        Skip::Aabb query = cube(glm::vec3(10.0f, -5.0f, 3.0f), size);
+        EXPECT_EQ(this->queryAabb(query), this->bruteForceAabb(query)) << "query size " << size;
+    }
+}
+
+TEST_F(DynamicBvhTest, FatBoxesAbsorbSmallMoves) {
+    size_t index = 1;
+    ASSERT_TRUE(alive[index]);
+    glm::vec3 center = boxes[index].getCenter();
+    EXPECT_FALSE(bvh.move(proxies[index], cube(center + glm::vec3(0.05f, 0.0f, 0.0f), 0.5f)));
+    EXPECT_TRUE(bvh.getFatAabb(proxies[index]).contains(boxes[index]));
+
+    boxes[index] = cube(center + glm::vec3(5.0f, 0.0f, 0.0f), 0.5f);
+    EXPECT_TRUE(bvh.move(proxies[index], boxes[index]));
+    EXPECT_TRUE(bvh.getFatAabb(proxies[index]).contains(boxes[index]));
+    EXPECT_EQ(fromUserData(bvh.getUserData(proxies[index])), index);
+    EXPECT_EQ(this->queryAabb(boxes[index]).count(index), 1u);
+}
+
+TEST_F(DynamicBvhTest, StaysBalanced) {
+    // a sorted insert order is the worst case for an unbalanced tree
+    Skip::DynamicBvh line;
+    for (uint32_t i = 0; i < 4096; i++) {
+        line.insert(cube(glm::vec3(static_cast<float>(i) * 2.0f, 0.0f, 0.0f), 0.5f), nullptr);
+    }
+    EXPECT_LE(line.getHeight(), 2 * 12 + 2);
+    EXPECT_LE(bvh.getHeight(), 2 * static_cast<int32_t>(std::ceil(std::log2(float(bvh.getProxyCount())))) + 2);
+}
+
+TEST_F(DynamicBvhTest, RebuildKeepsProxies) {
+    bvh.rebuild();
+    EXPECT_FALSE(bvh.isDegraded());
+    for (size_t i = 0; i < COUNT; i++) {
+        if (alive[i]) {
+            ASSERT_EQ(fromUserData(bvh.getUserData(proxies[i])), i);
+            ASSERT_TRUE(bvh.getFatAabb(proxies[i]).contains(boxes[i]));
+        }
+    }
+    Skip::Aabb query = cube(glm::vec3(0.0f), 30.0f);
+    EXPECT_EQ(this->queryAabb(query), this->bruteForceAabb(query));
+
+    // proxies inserted after a rebuild reuse freed nodes without clashing with the rebuilt ones
+    boxes.push_back(cube(glm::vec3(0.0f), 0.5f));
+    proxies.push_back(bvh.insert(boxes.back(), toUserData(COUNT)));
+    EXPECT_EQ(this->queryAabb(boxes.back()).count(COUNT), 1u);
+}
+
+TEST_F(DynamicBvhTest, InternalAreaIsTrackedIncrementally) {
+    bvh.rebuild();
+    float rebuiltArea = bvh.getInternalArea();
+    EXPECT_GT(rebuiltArea, 0.0f);
+
+    // scattering every proxy far outside the original volume loosens the tree
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    for (size_t i = 0; i < COUNT; i++) {
+        if (alive[i]) {
+            boxes[i] = cube(glm::vec3(position(random), position(random), position(random)), 0.5f);
+            bvh.move(proxies[i], boxes[i]);
+        }
+    }
+    EXPECT_GT(bvh.getInternalArea(), rebuiltArea);
+
+    // with every proxy gone there are no internal nodes left, whatever happened in between
+    for (size_t i = 0; i < COUNT; i++) {
+        if (alive[i]) {
+            bvh.remove(proxies[i]);
+        }
+    }
+    EXPECT_EQ(bvh.getProxyCount(), 0u);
+    EXPECT_EQ(bvh.getHeight(), 0);
+    EXPECT_NEAR(bvh.getInternalArea(), 0.0f, rebuiltArea * 1e-4f);
+}
+
+TEST_F(DynamicBvhTest, QueryFrustumMatchesBruteForce) {
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 150.0f), glm::vec3(20.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Skip::Frustum frustum;
+    frustum.update(projection * view);
+
+    std::set<size_t> visited;
+    bvh.queryFrustum(frustum, [&](int32_t proxy, bool fullyInside) {
+        const Skip::Aabb& box = bvh.getFatAabb(proxy);
+        if (fullyInside) {
+            EXPECT_EQ(frustum.classifyAabb(box.min, box.max), Skip::FrustumTest::Inside);
+        }
+        EXPECT_TRUE(visited.insert(fromUserData(bvh.getUserData(proxy))).second) << "visited twice";
+    });
+
+    std::set<size_t> expected;
+    for (size_t i = 0; i < COUNT; i++) {
+        const Skip::Aabb& box = bvh.getFatAabb(proxies[i]);
+        if (alive[i] && frustum.classifyAabb(box.min, box.max) != Skip::FrustumTest::Outside) {
+            expected.insert(i);
+        }
+    }
+    EXPECT_EQ(visited, expected);
+    EXPECT_FALSE(expected.empty());
+}
+
+TEST_F(DynamicBvhTest, RaycastFindsTheClosestHit) {
+    glm::vec3 direction(0.0f, 0.0f, 1.0f);
+    for (size_t target = 1; target < COUNT; target += 331) {
+        if (!alive[target]) {
+            continue;
+        }
+        glm::vec3 origin = boxes[target].getCenter();
+        origin.z = -300.0f;
+        auto exactHit = [&](int32_t proxy) {
+            return boxes[fromUserData(bvh.getUserData(proxy))].intersectRay(origin, 1.0f / direction, 1000.0f);
+        };
+
+        float distance;
+        int32_t hit = bvh.raycast(origin, direction, 1000.0f, exactHit, distance);
+        ASSERT_NE(hit, Skip::DynamicBvh::NULL_NODE);
+
+        float closest = 1000.0f;
+        for (size_t i = 0; i < COUNT; i++) {
+            float t = alive[i] ? boxes[i].intersectRay(origin, 1.0f / direction, 1000.0f) : -1.0f;
+            if (t >= 0.0f) {
+                closest = std::min(closest, t);
+            }
+        }
+        EXPECT_FLOAT_EQ(distance, closest);
+        EXPECT_LE(distance, boxes[target].min.z - origin.z);
+    }
+
+    float distance;
+    EXPECT_EQ(bvh.raycast(glm::vec3(0.0f, 500.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 1000.0f, nullptr, distance),
+        Skip::DynamicBvh::NULL_NODE);
+}
@@ -0,0 +1,123 @@
+#include <Frustum.h>
+
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+namespace {
+
+    // camera at the origin looking down -z, same projection as the scene
+    Skip::Frustum makeFrustum() {
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 1000.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        Skip::Frustum frustum;
+        frustum.update(projection * view);
+        return frustum;
+    }
+
+    struct Spheres {
+        std::vector<float> x, y, z, radius;
+
+        void add(const glm::vec3& center, float r) {
+            x.push_back(center.x);
+            y.push_back(center.y);
+            z.push_back(center.z);
+            radius.push_back(r);
+        }
+        uint32_t size() const { return static_cast<uint32_t>(x.size()); }
+    };
+
+}
+
+TEST(Frustum, PlanesAreNormalized) {
+    Skip::Frustum frustum = makeFrustum();
+    for (const glm::vec4& plane : frustum.planes) {
+        EXPECT_NEAR(glm::length(glm::vec3(plane)), 1.0f, 1e-5f);
+    }
+    // the near plane faces down the view direction, 0.1 units in front of the camera
+    EXPECT_NEAR(frustum.planes[4].z, -1.0f, 1e-5f);
+    EXPECT_NEAR(frustum.planes[4].w, -0.1f, 1e-4f);
+}
+
+TEST(Frustum, Spheres) {
+    Skip::Frustum frustum = makeFrustum();
+    EXPECT_TRUE(frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f));
+    EXPECT_FALSE(frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f));   // behind
+    EXPECT_FALSE(frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, -1100.0f), 1.0f)); // past the far plane
+    EXPECT_FALSE(frustum.intersectsSphere(glm::vec3(100.0f, 0.0f, -10.0f), 1.0f)); // off to the side
+    // centre outside, but close enough for the radius to reach in
+    EXPECT_TRUE(frustum.intersectsSphere(glm::vec3(0.0f, 0.0f, 1.0f), 1.5f));
+}
+
+TEST(Frustum, ClassifiesBoxes) {
+    Skip::Frustum frustum = makeFrustum();
+    EXPECT_EQ(frustum.classifyAabb(glm::vec3(-1.0f, -1.0f, -12.0f), glm::vec3(1.0f, 1.0f, -10.0f)), Skip::FrustumTest::Inside);
+    EXPECT_EQ(frustum.classifyAabb(glm::vec3(-1.0f, -1.0f, -12.0f), glm::vec3(100.0f, 1.0f, -10.0f)), Skip::FrustumTest::Intersects);
+    EXPECT_EQ(frustum.classifyAabb(glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 10.0f)), Skip::FrustumTest::Outside);
+
+    EXPECT_TRUE(frustum.intersectsAabb(glm::vec3(-1.0f, -1.0f, -12.0f), glm::vec3(100.0f, 1.0f, -10.0f)));
+    EXPECT_FALSE(frustum.intersectsAabb(glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 10.0f)));
+}
+
+TEST(Frustum, CullSpheresMatchesTheScalarTest) {
+    Skip::Frustum frustum = makeFrustum();
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> radius(0.0f, 20.0f);
+
+    // an odd count so the batched path leaves a tail for the scalar loop
+    Spheres spheres;
+    for (uint32_t i = 0; i < 4099; i++) {
+        spheres.add(glm::vec3(position(random), position(random), position(random) - 200.0f), radius(random));
+    }
+
+    std::vector<uint8_t> visible(spheres.size(), 2);
+    uint32_t visibleCount = Skip::cullSpheres(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+        spheres.radius.data(), spheres.size(), visible.data());
+
+    uint32_t expectedCount = 0;
+    for (uint32_t i = 0; i < spheres.size(); i++) {
+        bool expected = frustum.intersectsSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]);
+        ASSERT_EQ(visible[i], expected ? 1 : 0) << "sphere " << i;
+        expectedCount += expected;
+    }
+    EXPECT_EQ(visibleCount, expectedCount);
+    EXPECT_GT(visibleCount, 0u);
+    EXPECT_LT(visibleCount, spheres.size());
+}
+
+TEST(Frustum, CullSpheresKeepsTouchingSpheres) {
+    // spheres resting exactly on each plane from the outside count as visible on both paths
+    Skip::Frustum frustum = makeFrustum();
+    Spheres spheres;
+    for (const glm::vec4& plane : frustum.planes) {
+        glm::vec3 normal = glm::vec3(plane);
+        glm::vec3 onPlane = normal * -plane.w + glm::vec3(0.0f, 0.0f, -50.0f) - normal * glm::dot(normal, glm::vec3(0.0f, 0.0f, -50.0f));
+        for (float r : { 0.0f, 0.5f, 2.0f, 8.0f }) {
+            spheres.add(onPlane - normal * r, r);
+        }
+    }
+
+    std::vector<uint8_t> visible(spheres.size());
+    Skip::cullSpheres(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radius.data(),
+        spheres.size(), visible.data());
+    for (uint32_t i = 0; i < spheres.size(); i++) {
+        bool expected = frustum.intersectsSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]);
+        EXPECT_EQ(visible[i], expected ? 1 : 0) << "sphere " << i;
+    }
+}
+
+TEST(Frustum, CullSpheresHandlesEmptyAndShortInput) {
+    Skip::Frustum frustum = makeFrustum();
+    EXPECT_EQ(Skip::cullSpheres(frustum, nullptr, nullptr, nullptr, nullptr, 0, nullptr), 0u);
+
+    Spheres spheres;
+    spheres.add(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f);
+    spheres.add(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f);
+    spheres.add(glm::vec3(0.0f, 5.0f, -20.0f), 1.0f);
+    std::vector<uint8_t> visible(spheres.size());
+    EXPECT_EQ(Skip::cullSpheres(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radius.data(),
+        spheres.size(), visible.data()), 2u);
+    EXPECT_EQ(visible, std::vector<uint8_t>({ 1, 0, 1 }));
+}
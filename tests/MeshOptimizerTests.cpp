@@ -0,0 +1,144 @@
+#include <MeshOptimizer.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+    struct Mesh {
+        std::vector<float> positions; // x, y, z per vertex
+        std::vector<uint32_t> indices;
+
+        size_t vertexCount() const { return positions.size() / 3; }
+    };
+
+    // a UV sphere, closed so the overdraw order has an outside to work with
+    Mesh makeSphere(uint32_t rings, uint32_t segments) {
+        Mesh mesh;
+        for (uint32_t ring = 0; ring <= rings; ring++) {
+            float theta = 3.14159265f * ring / rings;
+            for (uint32_t segment = 0; segment <= segments; segment++) {
+                float phi = 2.0f * 3.14159265f * segment / segments;
+                mesh.positions.insert(mesh.positions.end(),
+                    { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+            }
+        }
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            for (uint32_t segment = 0; segment < segments; segment++) {
+                uint32_t a = ring * (segments + 1) + segment;
+                uint32_t b = a + segments + 1;
+                mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    // the same triangles in a random order, about the worst case for the cache
+    void shuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed) {
+        std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+        for (size_t t = 0; t < triangles.size(); t++) {
+            triangles[t] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+        for (size_t t = 0; t < triangles.size(); t++) {
+            std::copy(triangles[t].begin(), triangles[t].end(), indices.begin() + t * 3);
+        }
+    }
+
+    // triangles with their winding, order independent
+    std::vector<std::array<uint32_t, 3>> sortedTriangles(const std::vector<uint32_t>& indices) {
+        std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+        for (size_t t = 0; t < triangles.size(); t++) {
+            triangles[t] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+}
+
+TEST(MeshOptimizer, AnalyzesSmallMeshes) {
+    Skip::VertexCacheStats single = Skip::analyzeVertexCache({ 0, 1, 2 }, 3);
+    EXPECT_FLOAT_EQ(single.acmr, 3.0f);
+    EXPECT_FLOAT_EQ(single.atvr, 1.0f);
+
+    Skip::VertexCacheStats quad = Skip::analyzeVertexCache({ 0, 1, 2, 2, 1, 3 }, 4);
+    EXPECT_FLOAT_EQ(quad.acmr, 2.0f);
+    EXPECT_FLOAT_EQ(quad.atvr, 1.0f);
+
+    Skip::VertexCacheStats empty = Skip::analyzeVertexCache({}, 0);
+    EXPECT_FLOAT_EQ(empty.acmr, 0.0f);
+}
+
+TEST(MeshOptimizer, TipsifyPermutesTriangles) {
+    Mesh mesh = makeSphere(32, 64);
+    shuffleTriangles(mesh.indices, 5);
+    std::vector<uint32_t> original = mesh.indices;
+
+    std::vector<uint32_t> clusters;
+    Skip::optimizeVertexCache(mesh.indices, mesh.vertexCount(), clusters);
+
+    // every triangle comes out exactly once with its winding intact
+    EXPECT_EQ(sortedTriangles(mesh.indices), sortedTriangles(original));
+
+    uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    ASSERT_FALSE(clusters.empty());
+    EXPECT_EQ(clusters.front(), 0u);
+    for (size_t i = 1; i < clusters.size(); i++) {
+        EXPECT_GT(clusters[i], clusters[i - 1]);
+        EXPECT_LT(clusters[i], triangleCount);
+    }
+}
+
+TEST(MeshOptimizer, TipsifyImprovesTheCache) {
+    Mesh mesh = makeSphere(32, 64);
+    shuffleTriangles(mesh.indices, 9);
+    Skip::VertexCacheStats before = Skip::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+    std::vector<uint32_t> clusters;
+    Skip::optimizeVertexCache(mesh.indices, mesh.vertexCount(), clusters);
+    Skip::VertexCacheStats after = Skip::analyzeVertexCache(mesh.indices, mesh.vertexCount());
+
+    EXPECT_GT(before.acmr, 2.0f);
+    EXPECT_LT(after.acmr, 1.0f);
+    EXPECT_LT(after.atvr, 1.5f);
+}
+
+TEST(MeshOptimizer, TipsifySkipsUnusedVertices) {
+    // vertex 0 and 5 have no triangles, so the first fan has to be found by the dead end search
+    std::vector<uint32_t> indices = { 1, 2, 3, 3, 2, 4, 6, 7, 8 };
+    std::vector<uint32_t> original = indices;
+    std::vector<uint32_t> clusters;
+    Skip::optimizeVertexCache(indices, 9, clusters);
+    EXPECT_EQ(sortedTriangles(indices), sortedTriangles(original));
+
+    std::vector<uint32_t> empty;
+    Skip::optimizeVertexCache(empty, 0, clusters);
+    EXPECT_TRUE(empty.empty());
+    EXPECT_TRUE(clusters.empty());
+}
+
+TEST(MeshOptimizer, OverdrawOrderStaysWithinThreshold) {
+    Mesh mesh = makeSphere(32, 64);
+    shuffleTriangles(mesh.indices, 13);
+    std::vector<uint32_t> clusters;
+    Skip::optimizeVertexCache(mesh.indices, mesh.vertexCount(), clusters);
+    std::vector<uint32_t> cacheOrder = mesh.indices;
+    float cacheAcmr = Skip::analyzeVertexCache(cacheOrder, mesh.vertexCount()).acmr;
+
+    Skip::optimizeOverdraw(mesh.indices, mesh.positions.data(), 3 * sizeof(float), mesh.vertexCount(), clusters);
+    EXPECT_EQ(sortedTriangles(mesh.indices), sortedTriangles(cacheOrder));
+    EXPECT_LE(Skip::analyzeVertexCache(mesh.indices, mesh.vertexCount()).acmr, cacheAcmr * Skip::DEFAULT_OVERDRAW_THRESHOLD);
+}
+
+TEST(MeshOptimizer, VertexFetchRenumbersInFirstUseOrder) {
+    std::vector<uint32_t> indices = { 4, 2, 0, 0, 2, 5 };
+    std::vector<uint32_t> remap = Skip::optimizeVertexFetch(indices, 6);
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 1, 2, 2, 1, 3 }));
+    EXPECT_EQ(remap, std::vector<uint32_t>({ 2, Skip::UNUSED_VERTEX, 1, Skip::UNUSED_VERTEX, 0, 3 }));
+}
@@ -0,0 +1,226 @@
+#include <TextureFile.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+    // Builds KTX2 files the way the tools lay them out: header, level index largest level first,
+    // then the level data smallest level first. Fields can be broken before writing
+    struct Ktx2Builder {
+        uint32_t vkFormat = VK_FORMAT_BC7_UNORM_BLOCK;
+        uint32_t width = 256;
+        uint32_t height = 128;
+        uint32_t depth = 0;
+        uint32_t layerCount = 0;
+        uint32_t faceCount = 1;
+        uint32_t levelCount = 9;
+        uint32_t supercompressionScheme = 0;
+        uint32_t blockBytes = 16;
+        uint32_t blockSize = 4;
+        // per level byteOffset and byteLength, filled by layout()
+        std::vector<std::pair<uint64_t, uint64_t>> levels;
+
+        size_t indexEnd() const {
+            return 12 + 13 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + std::max(levelCount, 1u) * 3 * sizeof(uint64_t);
+        }
+
+        void layout() {
+            levels.assign(std::max(levelCount, 1u), { 0, 0 });
+            uint64_t offset = indexEnd();
+            for (size_t i = levels.size(); i-- > 0;) {
+                uint64_t blocksX = (std::max(width >> i, 1u) + blockSize - 1) / blockSize;
+                uint64_t blocksY = (std::max(height >> i, 1u) + blockSize - 1) / blockSize;
+                levels[i] = { offset, blocksX * blocksY * blockBytes };
+                offset += levels[i].second;
+            }
+        }
+
+        std::vector<uint8_t> build() const {
+            std::vector<uint8_t> file(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+            auto append = [&file](const auto& value) {
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+                file.insert(file.end(), bytes, bytes + sizeof(value));
+            };
+            for (uint32_t value : { vkFormat, 1u, width, height, depth, layerCount, faceCount, levelCount,
+                supercompressionScheme, 0u, 0u, 0u, 0u }) {
+                append(value);
+            }
+            append(uint64_t(0));
+            append(uint64_t(0));
+            uint64_t end = file.size();
+            for (const auto& level : levels) {
+                append(level.first);
+                append(level.second);
+                append(level.second);
+                end = std::max(end, level.first + level.second);
+            }
+            // every level's bytes are its level number, so reads from the wrong level show up
+            file.resize(std::max<uint64_t>(end, file.size()));
+            for (size_t i = 0; i < levels.size(); i++) {
+                if (levels[i].first + levels[i].second <= file.size()) {
+                    std::fill_n(file.begin() + levels[i].first, levels[i].second, static_cast<uint8_t>(i + 1));
+                }
+            }
+            return file;
+        }
+    };
+
+    class TextureFileTest : public ::testing::Test {
+    protected:
+        std::filesystem::path directory;
+
+        void SetUp() override {
+            directory = std::filesystem::temp_directory_path() / ("skip_texture_tests_" +
+                std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+            std::filesystem::create_directories(directory);
+        }
+
+        void TearDown() override {
+            std::error_code error;
+            std::filesystem::remove_all(directory, error);
+        }
+
+        std::string write(const std::string& name, const std::vector<uint8_t>& bytes) const {
+            std::filesystem::path path = directory / name;
+            std::ofstream file(path, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            return path.string();
+        }
+
+        std::string write(const std::string& name, Ktx2Builder builder) const {
+            if (builder.levels.empty()) {
+                builder.layout();
+            }
+            return this->write(name, builder.build());
+        }
+    };
+
+}
+
+TEST(TextureFormat, BlockSizes) {
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_BC1_RGBA_SRGB_BLOCK).blockBytes, 8u);
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_BC7_UNORM_BLOCK).blockBytes, 16u);
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_BC7_UNORM_BLOCK).blockSize, 4u);
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_R8G8B8A8_SRGB).blockBytes, 4u);
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_R8G8B8A8_SRGB).blockSize, 1u);
+    EXPECT_EQ(Skip::getTextureFormatInfo(VK_FORMAT_R32G32B32A32_SFLOAT).blockBytes, 0u);
+    EXPECT_EQ(Skip::getTextureFormatName(VK_FORMAT_BC7_SRGB_BLOCK), "BC7 srgb");
+}
+
+TEST_F(TextureFileTest, LoadsEveryLevel) {
+    Ktx2Builder builder;
+    builder.layout();
+    std::string path = this->write("bc7.ktx2", builder);
+
+    Skip::CompressedTexture texture;
+    Skip::loadKtx2(path, texture);
+    EXPECT_EQ(texture.format, VK_FORMAT_BC7_UNORM_BLOCK);
+    EXPECT_EQ(texture.width, 256u);
+    EXPECT_EQ(texture.height, 128u);
+    ASSERT_EQ(texture.levels.size(), 9u);
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < texture.levels.size(); i++) {
+        const Skip::TextureLevel& level = texture.levels[i];
+        EXPECT_EQ(level.width, std::max(256u >> i, 1u));
+        EXPECT_EQ(level.height, std::max(128u >> i, 1u));
+        EXPECT_EQ(level.offset, builder.levels[i].first);
+        EXPECT_EQ(level.size, builder.levels[i].second);
+        // levels below the block size still take a whole block
+        EXPECT_GE(level.size, 16u);
+        EXPECT_EQ(texture.levelData(i)[0], i + 1);
+        EXPECT_EQ(texture.levelData(i)[level.size - 1], i + 1);
+        total += level.size;
+    }
+    EXPECT_EQ(texture.dataSize(), total);
+    EXPECT_EQ(texture.levels[0].size, 64u * 32u * 16u);
+}
+
+TEST_F(TextureFileTest, LevelCountZeroIsOneLevel) {
+    Ktx2Builder builder;
+    builder.vkFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    builder.blockBytes = 4;
+    builder.blockSize = 1;
+    builder.width = 3;
+    builder.height = 5;
+    builder.levelCount = 0;
+
+    Skip::CompressedTexture texture;
+    Skip::loadKtx2(this->write("rgba.ktx2", builder), texture);
+    ASSERT_EQ(texture.levels.size(), 1u);
+    EXPECT_EQ(texture.levels[0].size, 3u * 5u * 4u);
+}
+
+TEST_F(TextureFileTest, RejectsBrokenFiles) {
+    auto expectThrow = [this](const std::string& name, const Ktx2Builder& builder) {
+        Skip::CompressedTexture texture;
+        EXPECT_THROW(Skip::loadKtx2(this->write(name, builder), texture), std::runtime_error) << name;
+    };
+
+    Ktx2Builder unsupported;
+    unsupported.vkFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+    expectThrow("unsupported.ktx2", unsupported);
+
+    Ktx2Builder supercompressed;
+    supercompressed.supercompressionScheme = 2; // zstd
+    expectThrow("supercompressed.ktx2", supercompressed);
+
+    Ktx2Builder cube;
+    cube.faceCount = 6;
+    expectThrow("cube.ktx2", cube);
+
+    Ktx2Builder array;
+    array.layerCount = 4;
+    expectThrow("array.ktx2", array);
+
+    Ktx2Builder volume;
+    volume.depth = 4;
+    expectThrow("volume.ktx2", volume);
+
+    Ktx2Builder tooManyLevels;
+    tooManyLevels.levelCount = 10;
+    expectThrow("levels.ktx2", tooManyLevels);
+
+    Ktx2Builder wrongSize;
+    wrongSize.layout();
+    wrongSize.levels[3].second += 16;
+    expectThrow("size.ktx2", wrongSize);
+
+    Ktx2Builder pastTheEnd;
+    pastTheEnd.layout();
+    std::vector<uint8_t> truncated = pastTheEnd.build();
+    truncated.resize(truncated.size() - 1);
+    Skip::CompressedTexture texture;
+    EXPECT_THROW(Skip::loadKtx2(this->write("truncated.ktx2", truncated), texture), std::runtime_error);
+}
+
+TEST_F(TextureFileTest, RejectsOtherFiles) {
+    Skip::CompressedTexture texture;
+    EXPECT_THROW(Skip::loadKtx2((directory / "missing.ktx2").string(), texture), std::runtime_error);
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    png.resize(200, 0);
+    EXPECT_THROW(Skip::loadKtx2(this->write("image.ktx2", png), texture), std::runtime_error);
+
+    // the identifier alone, cut off before the level index
+    std::vector<uint8_t> identifierOnly(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+    EXPECT_THROW(Skip::loadKtx2(this->write("short.ktx2", identifierOnly), texture), std::runtime_error);
+}
+
+TEST_F(TextureFileTest, FindsCompressedSiblings) {
+    std::string png = (directory / "brick.png").string();
+    EXPECT_EQ(Skip::findCompressedTexture(png), "");
+
+    Ktx2Builder builder;
+    std::string ktx2 = this->write("brick.ktx2", builder);
+    EXPECT_EQ(Skip::findCompressedTexture(png), ktx2);
+    EXPECT_EQ(Skip::findCompressedTexture(ktx2), ktx2);
+}
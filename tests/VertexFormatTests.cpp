@@ -0,0 +1,168 @@
+#include <VertexFormat.h>
+#include <objects/SkipObject.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+    // the shader side of the compact formats, in C++
+    float halfToFloat(uint16_t half) {
+        uint32_t exponent = (half >> 10) & 0x1f;
+        float mantissa = static_cast<float>(half & 0x3ff);
+        float value = exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(mantissa + 1024.0f, static_cast<int>(exponent) - 25);
+        return half & 0x8000 ? -value : value;
+    }
+
+    glm::vec2 unpackSnorm16(uint32_t packed) {
+        auto unpack = [](uint16_t bits) {
+            return std::max(static_cast<float>(static_cast<int16_t>(bits)) / 32767.0f, -1.0f);
+        };
+        return glm::vec2(unpack(static_cast<uint16_t>(packed)), unpack(static_cast<uint16_t>(packed >> 16)));
+    }
+
+    // atan2 stays accurate for tiny angles, acos of the dot product does not
+    float angleBetween(const glm::vec3& a, const glm::vec3& b) {
+        return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+    }
+
+    glm::vec3 randomUnit(std::mt19937& random) {
+        std::normal_distribution<float> normal;
+        glm::vec3 vector(normal(random), normal(random), normal(random));
+        return vector / glm::length(vector);
+    }
+
+    std::vector<Skip::Vertex> makeVertices(size_t count, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Skip::Vertex> vertices(count);
+        for (Skip::Vertex& vertex : vertices) {
+            vertex.position = glm::vec3(position(random), position(random) * 0.1f, position(random) + 200.0f);
+            vertex.color = glm::vec3(unit(random), unit(random), unit(random));
+            vertex.texCoord = glm::vec2(unit(random) * 4.0f - 2.0f, unit(random));
+            vertex.normal = randomUnit(random);
+            vertex.tangent = randomUnit(random);
+        }
+        return vertices;
+    }
+
+    Skip::CompactVertex readCompact(const std::vector<uint8_t>& packed, Skip::VertexFormat format, size_t index) {
+        Skip::CompactVertex compact{};
+        uint32_t stride = Skip::getVertexStride(format);
+        memcpy(&compact, packed.data() + index * stride, stride);
+        return compact;
+    }
+
+}
+
+TEST(VertexFormat, Strides) {
+    EXPECT_EQ(Skip::getVertexStride(Skip::VertexFormat::Full), sizeof(Skip::Vertex));
+    EXPECT_EQ(Skip::getVertexStride(Skip::VertexFormat::Compact), 20u);
+    EXPECT_EQ(Skip::getVertexStride(Skip::VertexFormat::CompactColor), 24u);
+    EXPECT_EQ(Skip::getVertexBindingDescription(Skip::VertexFormat::Compact).stride, 20u);
+}
+
+TEST(VertexFormat, AttributesFitTheStride) {
+    for (Skip::VertexFormat format : { Skip::VertexFormat::Full, Skip::VertexFormat::Compact, Skip::VertexFormat::CompactColor }) {
+        std::vector<VkVertexInputAttributeDescription> attributes = Skip::getVertexAttributeDescriptions(format);
+        bool hasColor = false;
+        for (const VkVertexInputAttributeDescription& attribute : attributes) {
+            EXPECT_LT(attribute.offset, Skip::getVertexStride(format)) << Skip::getVertexFormatName(format);
+            hasColor |= attribute.location == 1;
+        }
+        // Compact leaves the color attribute out and the shader draws white
+        EXPECT_EQ(hasColor, format != Skip::VertexFormat::Compact) << Skip::getVertexFormatName(format);
+    }
+}
+
+TEST(VertexFormat, FullIsACopy) {
+    std::vector<Skip::Vertex> vertices = makeVertices(100, 1);
+    std::vector<uint8_t> packed;
+    Skip::VertexDecodePushConstants decode;
+    Skip::packVertices(Skip::VertexFormat::Full, vertices.data(), vertices.size(), packed, decode);
+    ASSERT_EQ(packed.size(), vertices.size() * sizeof(Skip::Vertex));
+    EXPECT_EQ(memcmp(packed.data(), vertices.data(), packed.size()), 0);
+}
+
+TEST(VertexFormat, CompactRoundTrip) {
+    std::vector<Skip::Vertex> vertices = makeVertices(2000, 2);
+    std::vector<uint8_t> packed;
+    Skip::VertexDecodePushConstants decode;
+    Skip::packVertices(Skip::VertexFormat::CompactColor, vertices.data(), vertices.size(), packed, decode);
+    ASSERT_EQ(packed.size(), vertices.size() * 24);
+
+    glm::vec3 offset = glm::vec3(decode.positionOffset);
+    glm::vec3 scale = glm::vec3(decode.positionScale);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Skip::Vertex& vertex = vertices[i];
+        Skip::CompactVertex compact = readCompact(packed, Skip::VertexFormat::CompactColor, i);
+
+        for (int axis = 0; axis < 3; axis++) {
+            // within a unorm16 step of the bounds
+            float position = offset[axis] + compact.position[axis] / 65535.0f * scale[axis];
+            ASSERT_NEAR(position, vertex.position[axis], scale[axis] / 65535.0f) << "vertex " << i;
+        }
+        // snorm16 octahedral is good to well under a tenth of a degree
+        ASSERT_LT(angleBetween(Skip::decodeOctahedral(unpackSnorm16(compact.normal)), vertex.normal), 1e-3f) << "vertex " << i;
+        ASSERT_LT(angleBetween(Skip::decodeOctahedral(unpackSnorm16(compact.tangent)), vertex.tangent), 1e-3f) << "vertex " << i;
+        ASSERT_NEAR(halfToFloat(static_cast<uint16_t>(compact.texCoord)), vertex.texCoord.x, 1e-3f) << "vertex " << i;
+        ASSERT_NEAR(halfToFloat(static_cast<uint16_t>(compact.texCoord >> 16)), vertex.texCoord.y, 1e-3f) << "vertex " << i;
+        ASSERT_NEAR((compact.color & 0xff) / 255.0f, vertex.color.x, 0.5f / 255.0f) << "vertex " << i;
+        ASSERT_NEAR((compact.color >> 16 & 0xff) / 255.0f, vertex.color.z, 0.5f / 255.0f) << "vertex " << i;
+        ASSERT_EQ(compact.color >> 24, 255u);
+    }
+}
+
+TEST(VertexFormat, CompactLeavesColorOut) {
+    std::vector<Skip::Vertex> vertices = makeVertices(10, 3);
+    std::vector<uint8_t> compact, compactColor;
+    Skip::VertexDecodePushConstants decode;
+    Skip::packVertices(Skip::VertexFormat::Compact, vertices.data(), vertices.size(), compact, decode);
+    Skip::packVertices(Skip::VertexFormat::CompactColor, vertices.data(), vertices.size(), compactColor, decode);
+    ASSERT_EQ(compact.size(), vertices.size() * 20);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        EXPECT_EQ(memcmp(compact.data() + i * 20, compactColor.data() + i * 24, 20), 0);
+    }
+}
+
+TEST(VertexFormat, FlatMeshes) {
+    // every vertex on the y = 3 plane, the bounds have no height
+    std::vector<Skip::Vertex> vertices = makeVertices(10, 4);
+    for (Skip::Vertex& vertex : vertices) {
+        vertex.position.y = 3.0f;
+    }
+    std::vector<uint8_t> packed;
+    Skip::VertexDecodePushConstants decode;
+    Skip::packVertices(Skip::VertexFormat::Compact, vertices.data(), vertices.size(), packed, decode);
+    EXPECT_EQ(decode.positionOffset.y, 3.0f);
+    EXPECT_EQ(decode.positionScale.y, 0.0f);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        EXPECT_EQ(readCompact(packed, Skip::VertexFormat::Compact, i).position[1], 0u);
+    }
+
+    Skip::packVertices(Skip::VertexFormat::Compact, nullptr, 0, packed, decode);
+    EXPECT_TRUE(packed.empty());
+}
+
+TEST(VertexFormat, OctahedralRoundTrip) {
+    std::vector<glm::vec3> vectors = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    std::mt19937 random(5);
+    for (int i = 0; i < 1000; i++) {
+        vectors.push_back(randomUnit(random));
+    }
+    for (const glm::vec3& vector : vectors) {
+        glm::vec2 encoded = Skip::encodeOctahedral(vector);
+        ASSERT_LE(std::fabs(encoded.x), 1.0f);
+        ASSERT_LE(std::fabs(encoded.y), 1.0f);
+        glm::vec3 decoded = Skip::decodeOctahedral(encoded);
+        ASSERT_LT(angleBetween(decoded, vector), 1e-5f);
+    }
+}
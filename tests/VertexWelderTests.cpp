@@ -0,0 +1,175 @@
+#include <VertexWelder.h>
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+    Skip::Vertex makeVertex(const glm::vec3& position, const glm::vec2& texCoord = glm::vec2(0.0f)) {
+        Skip::Vertex vertex{};
+        vertex.position = position;
+        vertex.color = glm::vec3(1.0f);
+        vertex.texCoord = texCoord;
+        vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        vertex.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+        return vertex;
+    }
+
+    bool sameBits(const Skip::Vertex& a, const Skip::Vertex& b) {
+        return Skip::VertexWelder::makeKey(a) == Skip::VertexWelder::makeKey(b);
+    }
+
+    // a grid of quads as an unindexed triangle stream, every inner corner is shared by six triangles
+    std::vector<Skip::Vertex> makeGrid(uint32_t size) {
+        std::vector<Skip::Vertex> stream;
+        for (uint32_t y = 0; y < size; y++) {
+            for (uint32_t x = 0; x < size; x++) {
+                auto corner = [](uint32_t cx, uint32_t cy) {
+                    return makeVertex(glm::vec3(float(cx), 0.0f, float(cy)), glm::vec2(float(cx), float(cy)) * 0.125f);
+                };
+                stream.insert(stream.end(), { corner(x, y), corner(x + 1, y), corner(x + 1, y + 1) });
+                stream.insert(stream.end(), { corner(x, y), corner(x + 1, y + 1), corner(x, y + 1) });
+            }
+        }
+        return stream;
+    }
+
+    // the welded mesh has to reproduce the stream exactly, and each unique vertex keeps the
+    // position in the order it first appeared at
+    void expectWeldOf(const std::vector<Skip::Vertex>& stream, const std::vector<Skip::Vertex>& vertices,
+        const std::vector<uint32_t>& indices) {
+        ASSERT_EQ(indices.size(), stream.size());
+        uint32_t nextNew = 0;
+        for (size_t i = 0; i < stream.size(); i++) {
+            ASSERT_LT(indices[i], vertices.size());
+            ASSERT_LE(indices[i], nextNew) << "vertices out of first appearance order";
+            if (indices[i] == nextNew) {
+                nextNew++;
+            }
+        }
+        EXPECT_EQ(nextNew, vertices.size());
+    }
+
+}
+
+TEST(VertexWelder, MergesExactDuplicates) {
+    std::vector<Skip::Vertex> stream = makeGrid(16);
+    std::vector<Skip::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    Skip::weldVertices(stream, vertices, indices);
+
+    EXPECT_EQ(vertices.size(), 17u * 17u);
+    expectWeldOf(stream, vertices, indices);
+    for (size_t i = 0; i < stream.size(); i++) {
+        ASSERT_TRUE(sameBits(vertices[indices[i]], stream[i]));
+    }
+}
+
+TEST(VertexWelder, KeepsVerticesThatDifferInAnyAttribute) {
+    Skip::Vertex base = makeVertex(glm::vec3(1.0f, 2.0f, 3.0f));
+    Skip::Vertex otherTangent = base;
+    otherTangent.tangent = glm::vec3(0.0f, 0.0f, 1.0f);
+    Skip::Vertex otherColor = base;
+    otherColor.color.y = 0.5f;
+    Skip::Vertex negativeZero = base;
+    negativeZero.normal.x = -0.0f;
+
+    std::vector<Skip::Vertex> stream = { base, otherTangent, otherColor, negativeZero, base };
+    std::vector<Skip::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    Skip::weldVerticesHashed(stream, vertices, indices);
+    // -0 compares equal to 0, so only the tangent and color make new vertices
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 1, 2, 0, 0 }));
+}
+
+TEST(VertexWelder, SortedWeldMatchesHashed) {
+    std::mt19937 random(3);
+    std::uniform_int_distribution<uint32_t> pick(0, 999);
+    std::vector<Skip::Vertex> unique;
+    for (uint32_t i = 0; i < 1000; i++) {
+        unique.push_back(makeVertex(glm::vec3(float(i % 10), float(i / 10 % 10), float(i / 100)), glm::vec2(float(i))));
+    }
+    std::vector<Skip::Vertex> stream;
+    for (uint32_t i = 0; i < 100000; i++) {
+        stream.push_back(unique[pick(random)]);
+    }
+
+    std::vector<Skip::Vertex> hashedVertices, sortedVertices, threadedVertices;
+    std::vector<uint32_t> hashedIndices, sortedIndices, threadedIndices;
+    Skip::weldVerticesHashed(stream, hashedVertices, hashedIndices);
+    Skip::weldVerticesSorted(stream, sortedVertices, sortedIndices);
+    Skip::ThreadPool threads(3);
+    Skip::weldVerticesSorted(stream, threadedVertices, threadedIndices, &threads);
+
+    expectWeldOf(stream, hashedVertices, hashedIndices);
+    EXPECT_EQ(sortedIndices, hashedIndices);
+    EXPECT_EQ(threadedIndices, hashedIndices);
+    ASSERT_EQ(sortedVertices.size(), hashedVertices.size());
+    ASSERT_EQ(threadedVertices.size(), hashedVertices.size());
+    for (size_t i = 0; i < hashedVertices.size(); i++) {
+        EXPECT_TRUE(sameBits(sortedVertices[i], hashedVertices[i]));
+        EXPECT_TRUE(sameBits(threadedVertices[i], hashedVertices[i]));
+    }
+
+    Skip::weldVerticesSorted({}, sortedVertices, sortedIndices, &threads);
+    EXPECT_TRUE(sortedVertices.empty());
+    EXPECT_TRUE(sortedIndices.empty());
+}
+
+TEST(VertexWelder, ToleranceMergesAcrossCellBorders) {
+    // 0.0999 and 0.1001 fall into different 0.01 sized cells but are well within the tolerance
+    const float tolerance = 0.01f;
+    std::vector<Skip::Vertex> stream = {
+        makeVertex(glm::vec3(0.0999f, 0.0f, 0.0f)),
+        makeVertex(glm::vec3(0.1001f, 0.0f, 0.0f)),
+        makeVertex(glm::vec3(0.0999f, -0.0001f, 0.0001f)),
+        makeVertex(glm::vec3(0.2f, 0.0f, 0.0f)),
+        makeVertex(glm::vec3(0.0999f, 0.0f, 0.0f), glm::vec2(0.5f)), // same place, different uv
+    };
+    std::vector<Skip::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    Skip::weldVertices(stream, vertices, indices, tolerance);
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 0, 0, 1, 2 }));
+    // merged vertices keep the first one's attributes
+    EXPECT_TRUE(sameBits(vertices[0], stream[0]));
+}
+
+TEST(VertexWelder, ToleranceMatchesBruteForce) {
+    const float tolerance = 0.05f;
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> jitter(-0.04f, 0.04f);
+    std::vector<Skip::Vertex> stream;
+    for (uint32_t i = 0; i < 3000; i++) {
+        glm::vec3 p(position(random), position(random), position(random));
+        stream.push_back(makeVertex(p));
+        if (i % 2 == 0) {
+            stream.push_back(makeVertex(p + glm::vec3(jitter(random), jitter(random), jitter(random))));
+        }
+    }
+
+    std::vector<Skip::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    Skip::weldVertices(stream, vertices, indices, tolerance);
+    expectWeldOf(stream, vertices, indices);
+
+    // every vertex goes to the earliest kept vertex within the tolerance, or is kept itself
+    std::vector<Skip::Vertex> expected;
+    for (size_t i = 0; i < stream.size(); i++) {
+        uint32_t match = static_cast<uint32_t>(expected.size());
+        for (uint32_t j = 0; j < expected.size(); j++) {
+            glm::vec3 d = expected[j].position - stream[i].position;
+            if (std::fabs(d.x) <= tolerance && std::fabs(d.y) <= tolerance && std::fabs(d.z) <= tolerance) {
+                match = j;
+                break;
+            }
+        }
+        if (match == expected.size()) {
+            expected.push_back(stream[i]);
+        }
+        ASSERT_EQ(indices[i], match) << "vertex " << i;
+    }
+    EXPECT_EQ(vertices.size(), expected.size());
+}